@@ -0,0 +1,53 @@
+// Replacement operator new counting heap allocations (see
+// allocation_stats.h); not part of tools nor the environment library, where
+// it would replace the allocator of the host process too
+// NOTE: Nothrow forms forward to these by default, and default deletes
+// free() what they allocate
+
+#include <cstdlib>
+#include <new>
+
+#include "allocation_stats.h"
+
+namespace {
+
+void* Allocate(std::size_t size, std::size_t alignment) {
+    tetris3d::CountAllocation(size);
+    if (size == 0) {
+        size = 1;
+    }
+    while (true) {
+        // NOTE: aligned_alloc wants size to be a multiple of alignment
+        auto pointer =
+            alignment <= alignof(std::max_align_t)
+                ? std::malloc(size)
+                : std::aligned_alloc(alignment, (size + alignment - 1) /
+                                                    alignment * alignment);
+        if (pointer) {
+            return pointer;
+        }
+        auto handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    return Allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return Allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size) {
+    return Allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return Allocate(size, static_cast<std::size_t>(alignment));
+}
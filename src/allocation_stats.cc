@@ -0,0 +1,239 @@
+#include "allocation_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <string>
+#include <vector>
+
+namespace tetris3d {
+namespace {
+
+// NOTE: Constant initialized, so allocations of static constructors running
+// before this file's are counted too
+std::atomic<uint64_t> allocation_count{0};
+std::atomic<uint64_t> allocation_bytes{0};
+
+// Innermost AllocationScope of the thread; -1 outside of scopes
+thread_local int current_scope = -1;
+// Set while the tracker itself runs on the thread, so its own allocations
+// (backtrace symbols, report) are not recorded, nor deadlock on its lock
+thread_local bool inside_tracker = false;
+
+// Frames printed per call site, after the allocator's own
+constexpr unsigned kPrintedFrames = 6;
+
+// Demangled function name of a backtrace_symbols line ("binary(name+0x1f)
+// [0x...]"); the whole line if it has no name (static functions)
+std::string GetFrameName(const char* symbol) {
+    auto begin = std::strchr(symbol, '(');
+    auto end = begin ? std::strpbrk(begin, "+)") : nullptr;
+    if (!begin || !end || end == begin + 1) {
+        return symbol;
+    }
+    std::string mangled(begin + 1, end);
+    int status = 0;
+    auto demangled =
+        abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    if (status != 0 || !demangled) {
+        return mangled;
+    }
+    std::string name = demangled;
+    std::free(demangled);
+    return name;
+}
+
+} // namespace
+
+AllocationStats GetAllocationStats() {
+    AllocationStats stats;
+    stats.count = allocation_count.load(std::memory_order_relaxed);
+    stats.bytes = allocation_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void CountAllocation(size_t bytes) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    auto& tracker = AllocationTracker::Get();
+    if (tracker.IsEnabled()) {
+        tracker.Record(bytes);
+    }
+}
+
+AllocationTracker& AllocationTracker::Get() {
+    static AllocationTracker tracker;
+    return tracker;
+}
+
+void AllocationTracker::SetEnabled(bool value) {
+    enabled_.store(value, std::memory_order_relaxed);
+}
+
+int AllocationTracker::GetScopeIndex(const char* name) {
+    for (unsigned i = 0; i < kMaxScopes; ++i) {
+        auto scope_name = scopes_[i].name.load(std::memory_order_acquire);
+        if (!scope_name) {
+            // NOTE: Another thread may register a name in the slot first
+            if (scopes_[i].name.compare_exchange_strong(
+                    scope_name, name, std::memory_order_acq_rel) ||
+                std::strcmp(scope_name, name) == 0) {
+                return i;
+            }
+            continue;
+        }
+        if (std::strcmp(scope_name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+AllocationStats AllocationTracker::GetScopeStats(const char* name) const {
+    AllocationStats stats;
+    for (const auto& scope : scopes_) {
+        auto scope_name = scope.name.load(std::memory_order_acquire);
+        if (scope_name && std::strcmp(scope_name, name) == 0) {
+            stats.count = scope.count.load(std::memory_order_relaxed);
+            stats.bytes = scope.bytes.load(std::memory_order_relaxed);
+        }
+    }
+    return stats;
+}
+
+void AllocationTracker::Reset() {
+    // NOTE: Names stay registered; scopes alive keep their slots
+    for (auto& scope : scopes_) {
+        scope.count.store(0, std::memory_order_relaxed);
+        scope.bytes.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard lock(call_sites_mutex_);
+    std::fill(std::begin(call_sites_), std::end(call_sites_), CallSite{});
+    call_site_count_ = 0;
+    dropped_call_sites_ = 0;
+}
+
+void AllocationTracker::Record(size_t bytes) {
+    if (current_scope < 0 || inside_tracker) {
+        return;
+    }
+    auto& scope = scopes_[current_scope];
+    scope.count.fetch_add(1, std::memory_order_relaxed);
+    scope.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    inside_tracker = true;
+    RecordCallSite(scope.name.load(std::memory_order_relaxed), bytes);
+    inside_tracker = false;
+}
+
+void AllocationTracker::RecordCallSite(const char* scope, size_t bytes) {
+    void* frames[kCallSiteDepth];
+    auto depth = static_cast<unsigned>(backtrace(frames, kCallSiteDepth));
+    // FNV-1a of the return addresses
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned i = 0; i < depth; ++i) {
+        hash = (hash ^ reinterpret_cast<uintptr_t>(frames[i])) *
+               1099511628211ull;
+    }
+
+    std::lock_guard lock(call_sites_mutex_);
+    for (unsigned probe = 0; probe < kMaxCallSites; ++probe) {
+        auto& site = call_sites_[(hash + probe) % kMaxCallSites];
+        if (!site.depth) {
+            // NOTE: Table is kept at most 3/4 full, so probes stay short
+            if (4 * call_site_count_ >= 3 * kMaxCallSites) {
+                break;
+            }
+            std::copy(frames, frames + depth, site.frames);
+            site.depth = depth;
+            site.scope = scope;
+            ++call_site_count_;
+        }
+        if (site.depth == depth && site.scope == scope &&
+            std::equal(frames, frames + depth, site.frames)) {
+            ++site.count;
+            site.bytes += bytes;
+            return;
+        }
+    }
+    ++dropped_call_sites_;
+}
+
+void AllocationTracker::PrintReport(unsigned top_call_sites,
+                                    const char* scope) const {
+    inside_tracker = true;
+    printf("Allocations by scope:\n");
+    for (const auto& slot : scopes_) {
+        auto name = slot.name.load(std::memory_order_acquire);
+        if (name) {
+            printf("  %-24s %10llu allocations, %12llu bytes\n", name,
+                   static_cast<unsigned long long>(slot.count.load()),
+                   static_cast<unsigned long long>(slot.bytes.load()));
+        }
+    }
+
+    std::vector<CallSite> sites;
+    uint64_t dropped = 0;
+    {
+        std::lock_guard lock(call_sites_mutex_);
+        for (const auto& site : call_sites_) {
+            if (site.depth &&
+                (!scope || std::strcmp(site.scope, scope) == 0)) {
+                sites.push_back(site);
+            }
+        }
+        dropped = dropped_call_sites_;
+    }
+    std::sort(sites.begin(), sites.end(),
+              [](const CallSite& a, const CallSite& b) {
+                  return a.count > b.count;
+              });
+    sites.resize(std::min<size_t>(sites.size(), top_call_sites));
+
+    printf("Top %zu call sites:\n", sites.size());
+    for (const auto& site : sites) {
+        printf("  %llu allocations, %llu bytes in %s\n",
+               static_cast<unsigned long long>(site.count),
+               static_cast<unsigned long long>(site.bytes), site.scope);
+        auto symbols = backtrace_symbols(site.frames, site.depth);
+        if (!symbols) {
+            continue;
+        }
+        std::vector<std::string> names(symbols, symbols + site.depth);
+        std::free(symbols);
+        for (auto& name : names) {
+            name = GetFrameName(name.c_str());
+        }
+        // NOTE: Frames up to the last operator new are the tracker and the
+        // allocator itself
+        unsigned first = 0;
+        for (unsigned i = 0; i < names.size(); ++i) {
+            if (names[i].starts_with("operator new")) {
+                first = i + 1;
+            }
+        }
+        auto last = std::min<unsigned>(names.size(), first + kPrintedFrames);
+        for (auto i = first; i < last; ++i) {
+            printf("      %.120s\n", names[i].c_str());
+        }
+    }
+    if (dropped) {
+        printf("  %llu allocations of call sites not recorded (table full)\n",
+               static_cast<unsigned long long>(dropped));
+    }
+    inside_tracker = false;
+}
+
+AllocationScope::AllocationScope(const char* name)
+    : previous_scope_(current_scope) {
+    auto& tracker = AllocationTracker::Get();
+    if (tracker.IsEnabled()) {
+        current_scope = tracker.GetScopeIndex(name);
+    }
+}
+
+AllocationScope::~AllocationScope() { current_scope = previous_scope_; }
+
+} // namespace tetris3d
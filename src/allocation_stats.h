@@ -0,0 +1,112 @@
+#ifndef TETRIS3D_ALLOCATION_STATS_H_
+#define TETRIS3D_ALLOCATION_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace tetris3d {
+
+// Heap allocations through operator new (any thread) since process start
+// NOTE: Counted by the replacement operators of allocation_hook.cc, linked
+// into the game and tetris3d-alloc-check only; elsewhere (other tools,
+// environment library) counters stay zero
+struct AllocationStats {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+AllocationStats GetAllocationStats();
+
+// Called by the replacement operator new
+void CountAllocation(size_t bytes);
+
+// Opt-in detail on top of the counters: allocations per named scope and
+// the call sites (backtraces) of allocations made within scopes, to find
+// out what allocates during a frame
+// NOTE: Every allocation in a scope takes a backtrace and a lock while
+// enabled, so it is meant for debugging and allocation checks
+class AllocationTracker {
+public:
+    static inline constexpr unsigned kMaxScopes = 32;
+    static inline constexpr unsigned kMaxCallSites = 4096;
+    // Frames captured per call site, including the allocator's own
+    static inline constexpr unsigned kCallSiteDepth = 12;
+
+    // The process-wide tracker the replacement operator new records into
+    static AllocationTracker& Get();
+
+    void SetEnabled(bool value);
+    bool IsEnabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Allocations made in scopes of the name (any thread) while enabled
+    AllocationStats GetScopeStats(const char* name) const;
+    // Forgets scope counts and call sites
+    void Reset();
+    // Prints allocations per scope and the call sites allocating most
+    // often, symbolized where possible
+    // @scope only call sites of this scope are printed, if not null
+    void PrintReport(unsigned top_call_sites,
+                     const char* scope = nullptr) const;
+
+    // Called by the replacement operator new; no-op outside of scopes
+    void Record(size_t bytes);
+
+private:
+    friend class AllocationScope;
+
+    struct Scope {
+        // Registered once, never changed; nullptr for a free slot
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    struct CallSite {
+        void* frames[kCallSiteDepth] = {};
+        unsigned depth = 0;
+        const char* scope = nullptr;
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+    };
+
+    AllocationTracker() = default;
+    AllocationTracker(const AllocationTracker&) = delete;
+    AllocationTracker& operator=(const AllocationTracker&) = delete;
+
+    // Slot of the scope name, registered on first use; -1 if all slots
+    // are taken
+    int GetScopeIndex(const char* name);
+    void RecordCallSite(const char* scope, size_t bytes);
+
+    std::atomic<bool> enabled_{false};
+    Scope scopes_[kMaxScopes];
+    // Open addressing table keyed by the backtrace
+    mutable std::mutex call_sites_mutex_;
+    CallSite call_sites_[kMaxCallSites];
+    unsigned call_site_count_ = 0;
+    // Allocations whose call site did not fit into the table
+    uint64_t dropped_call_sites_ = 0;
+};
+
+// Attributes allocations of the calling thread to the named scope while
+// alive; nested scopes take over from the enclosing one
+// @name must outlive the tracker (string literal)
+class AllocationScope {
+public:
+    explicit AllocationScope(const char* name);
+    ~AllocationScope();
+
+private:
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+    int previous_scope_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_ALLOCATION_STATS_H_
@@ -65,12 +65,21 @@ App::App(const Config& config) : config_(config), game_(config_) {}
 void App::Run() {
     using namespace std::literals::chrono_literals;
 
+    // NOTE: Cold start is measured up to the first presented frame; assets
+    // still loading in background (skybox) do not delay it
+    auto start_time = std::chrono::steady_clock::now();
+    auto first_frame = true;
+
     if (!StartUp()) {
         return;
     }
     if (!game_.StartUp()) {
         return;
     }
+    auto& profiler = Profiler::Get();
+    profiler.SetEnabled(!config_.profile_trace_path.empty());
+    auto& allocation_tracker = AllocationTracker::Get();
+    allocation_tracker.SetEnabled(config_.allocation_tracking);
 
     // NOTE(panmar): Even if we set glfwSetFramebufferSizeCallback callback
     // during Tetris3DApp::StartUp(), it is not triggered
@@ -85,20 +94,53 @@ void App::Run() {
 
     timer_.Update();
     while (!glfwWindowShouldClose(window_.get())) {
-        input_.Update();
-        glfwPollEvents();
+        profiler.BeginFrame();
+        ProfileScope frame_scope("Frame");
+        {
+            ProfileScope scope("Input::Update");
+            input_.Update();
+            glfwPollEvents();
+        }
         timer_.Update();
-        game_.Update(input_, timer_.GetElapsedSeconds());
+        {
+            ProfileScope scope("Game::Update");
+            AllocationScope allocation_scope("Game::Update");
+            game_.Update(input_, timer_.GetElapsedSeconds());
+        }
 
         if (input_.IsKeyPressed(config_.key_quit)) {
             glfwSetWindowShouldClose(window_.get(), GLFW_TRUE);
         }
+        if (profiler.IsEnabled() &&
+            input_.IsKeyPressed(config_.key_profile_dump)) {
+            profiler.WriteTrace(config_.profile_trace_path);
+        }
 
-        game_.Draw();
-        glfwSwapBuffers(window_.get());
+        {
+            ProfileScope scope("Game::Draw");
+            AllocationScope allocation_scope("Game::Draw");
+            game_.Draw();
+        }
+        {
+            ProfileScope scope("glfwSwapBuffers");
+            glfwSwapBuffers(window_.get());
+        }
+        if (first_frame) {
+            first_frame = false;
+            auto elapsed = std::chrono::steady_clock::now() - start_time;
+            printf("First frame after %.0f ms\n",
+                   std::chrono::duration<double, std::milli>(elapsed).count());
+        }
 
         std::this_thread::sleep_for(16ms);
     }
+
+    if (profiler.IsEnabled()) {
+        profiler.WriteTrace(config_.profile_trace_path);
+    }
+    if (allocation_tracker.IsEnabled()) {
+        allocation_tracker.PrintReport(10);
+    }
 }
 
 void App::OnKeyChanged(int key, int scancode, int action, int mods) {
@@ -110,7 +152,6 @@ void App::OnFramebufferResize(int width, int height) {
 }
 
 bool App::StartUp() {
-    srand(config_.rand_seed);
     glfwInit();
 
     window_ = std::unique_ptr<GLFWwindow, void (*)(GLFWwindow*)>(
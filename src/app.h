@@ -11,9 +11,11 @@
 #define GLFW_INCLUDE_GLU
 #include "GLFW/glfw3.h"
 
+#include "allocation_stats.h"
 #include "config.h"
 #include "game/game.h"
 #include "input.h"
+#include "profiler.h"
 #include "timer.h"
 
 namespace tetris3d {
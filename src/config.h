@@ -27,6 +27,11 @@ struct Config {
     bool graphics_borderless = true;
     bool graphics_multisampling = true;
     bool graphics_multisampling_samples = 4;
+    // Cube reflections sample a small prefiltered copy of the skybox (Low,
+    // Medium) or the mipmapped skybox itself (High)
+    enum class EnvironmentQuality { Low, Medium, High };
+    EnvironmentQuality graphics_environment_quality =
+        EnvironmentQuality::Medium;
 
     float camera_zoom_min_fov = glm::pi<float>() / 8.f;
     float camera_zoom_max_fov = 4.f * glm::pi<float>() / 5.f;
@@ -45,8 +50,15 @@ struct Config {
     int key_block_move_away = GLFW_KEY_Q;
     int key_block_move_towards = GLFW_KEY_E;
     int key_block_accelerate = GLFW_KEY_SPACE;
+    int key_block_drop = GLFW_KEY_ENTER;
     int key_quit = GLFW_KEY_ESCAPE;
     int key_pause = GLFW_KEY_P;
+    int key_replay_seek_backward = GLFW_KEY_LEFT_BRACKET;
+    int key_replay_seek_forward = GLFW_KEY_RIGHT_BRACKET;
+    int key_quicksave = GLFW_KEY_F5;
+    int key_quickload = GLFW_KEY_F9;
+    int key_profile_dump = GLFW_KEY_F11;
+    int key_toggle_hud = GLFW_KEY_F3;
 
     int map_width = 7;
     int map_depth = 7;
@@ -57,6 +69,58 @@ struct Config {
     float block_speed_inc_multiplier = 0.02f;
     float block_speed_inc_period_seconds = 10.f;
 
+    // Replay is recorded if path is not empty; playback takes precedence
+    std::string replay_record_path = "";
+    std::string replay_play_path = "";
+    // Seeking re-simulates at most this many ticks from the nearest keyframe
+    int replay_keyframe_interval_ticks = 300;
+    int replay_seek_step_ticks = 60;
+
+    // Every tick is published to this POSIX shared memory object (e.g.
+    // "/tetris3d") for out-of-process readers, if not empty
+    std::string observation_shm_name = "";
+    int observation_ring_slots = 64;
+
+    // Session is saved here periodically from a background thread and
+    // restored on startup (crash recovery), if not empty
+    std::string session_save_path = "";
+    float session_save_interval_seconds = 2.f;
+    // Quicksave is kept in memory and also written here, if not empty, so
+    // quickload works after restart
+    std::string quicksave_path = "";
+
+    // Frame profiler records CPU and GPU timings if not empty; the Chrome
+    // trace (chrome://tracing, Perfetto) is written here on key_profile_dump
+    // and at exit
+    std::string profile_trace_path = "";
+    // Performance overlay (frame times, draw calls, uploads, allocations,
+    // GPU memory) is shown from the start; key_toggle_hud toggles it
+    bool hud_visible = false;
+    // Allocation tracker records allocations of Game::Update and Game::Draw
+    // with their call sites (slow); the report is printed at exit
+    bool allocation_tracking = false;
+
+    // Built-in bot plays instead of the player (e.g. attract mode)
+    bool autoplay = false;
+    enum class BotType { Heuristic, BeamSearch };
+    BotType autoplay_bot = BotType::BeamSearch;
+    // Zero issues the whole block placement within a single frame
+    float autoplay_commands_per_second = 15.f;
+    float autoplay_restart_delay_seconds = 3.f;
+    // Zero uses one thread per hardware thread
+    int autoplay_threads = 0;
+    float bot_weight_aggregate_height = -0.51f;
+    float bot_weight_holes = -0.36f;
+    float bot_weight_bumpiness = -0.18f;
+    float bot_weight_cleared_layers = 0.76f;
+    // Weights tuned by tetris3d-tune; overrides bot_weight_* if not empty
+    std::string bot_weights_path = "";
+    // Beam search bot; budget should stay below block fall step
+    int bot_search_beam_width = 8;
+    int bot_search_depth = 2;
+    float bot_search_time_budget_seconds = 0.03f;
+    unsigned bot_search_table_size_log2 = 16;
+
     static inline constexpr int kMaximumWindowTitleLength = 50;
 };
 
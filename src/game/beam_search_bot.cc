@@ -0,0 +1,288 @@
+#include "game/beam_search_bot.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// NOTE: Placing an unplaceable piece means losing; way below any board score
+constexpr float kLossValue = -1e6f;
+
+// Value marking types of unknown pieces in transposition table keys
+constexpr uint64_t kUnknownPieceCode = 7;
+
+uint64_t Mix(uint64_t value) {
+    // NOTE: splitmix64 finalizer
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ull;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebull;
+    value ^= value >> 31;
+    return value;
+}
+
+} // namespace
+
+namespace tetris3d {
+
+BeamSearchSettings BeamSearchSettings::FromConfig(const Config& config) {
+    BeamSearchSettings settings;
+    settings.beam_width = config.bot_search_beam_width;
+    settings.depth = config.bot_search_depth;
+    settings.time_budget_seconds = config.bot_search_time_budget_seconds;
+    settings.table_size_log2 = config.bot_search_table_size_log2;
+    return settings;
+}
+
+uint64_t HashOccupancy(const Board& board) {
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+    uint64_t word = 0;
+    auto bits = 0;
+    for (auto cell : board.GetCells()) {
+        word = (word << 1) | (cell != 0);
+        if (++bits == 64) {
+            hash = Mix(hash ^ word);
+            word = 0;
+            bits = 0;
+        }
+    }
+    return Mix(hash ^ word ^ bits);
+}
+
+BeamSearchBot::BeamSearchBot(const BotWeights& weights,
+                             const BeamSearchSettings& settings,
+                             ThreadPool* pool)
+    : weights_(weights), settings_(settings), pool_(pool),
+      table_(settings.table_size_log2),
+      scratch_(pool ? pool->GetThreadCount() + 1 : 1,
+               std::vector<Level>(std::max(settings.depth, 1) + 1)) {}
+
+void BeamSearchBot::SetPreview(const std::vector<BlockType>& preview) {
+    preview_ = preview;
+}
+
+bool BeamSearchBot::FindBestPlacement(const GameState& state,
+                                      Placement& best) {
+    auto budget = std::chrono::duration<float>(settings_.time_budget_seconds);
+    deadline_ =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(budget);
+
+    EnumeratePlacements(state.board, state.falling_block, root_placements_);
+    if (root_placements_.empty()) {
+        return false;
+    }
+
+    root_hashes_.resize(root_placements_.size());
+    auto score_root = [&](size_t index, unsigned worker) {
+        auto& level = scratch_[worker][0];
+        auto& placement = root_placements_[index];
+        level.board = state.board;
+        auto cleared_layers = ApplyPlacement(level.board, placement, 1);
+        auto features = ComputeBoardFeatures(level.board, level.heights);
+        placement.score = ScoreBoard(features, cleared_layers, weights_);
+        root_hashes_[index] = HashOccupancy(level.board);
+    };
+    if (pool_) {
+        pool_->ParallelFor(root_placements_.size(), score_root);
+    } else {
+        for (size_t i = 0; i < root_placements_.size(); ++i) {
+            score_root(i, 0);
+        }
+    }
+
+    // NOTE: Beam keeps the best distinct boards; different placements
+    // leading to the same board are searched only once
+    root_candidates_.resize(root_placements_.size());
+    std::iota(root_candidates_.begin(), root_candidates_.end(), 0);
+    std::stable_sort(root_candidates_.begin(), root_candidates_.end(),
+                     [&](size_t a, size_t b) {
+                         return root_placements_[a].score >
+                                root_placements_[b].score;
+                     });
+    size_t beam_size = 0;
+    for (size_t i = 0; i < root_candidates_.size() &&
+                       beam_size < static_cast<size_t>(settings_.beam_width);
+         ++i) {
+        auto hash = root_hashes_[root_candidates_[i]];
+        auto is_duplicate = std::any_of(
+            root_candidates_.begin(), root_candidates_.begin() + beam_size,
+            [&](size_t candidate) { return root_hashes_[candidate] == hash; });
+        if (!is_duplicate) {
+            root_candidates_[beam_size++] = root_candidates_[i];
+        }
+    }
+    root_candidates_.resize(std::max<size_t>(beam_size, 1));
+
+    best = root_placements_[root_candidates_[0]];
+    if (settings_.depth <= 1) {
+        return true;
+    }
+
+    // NOTE: Candidates are searched one next piece type at a time, so when
+    // the time budget runs out they are all compared over the same types
+    root_values_.assign(root_candidates_.size(), 0.f);
+    root_type_values_.resize(root_candidates_.size());
+    int first_type = 0, last_type = 0;
+    GetPieceTypes(1, first_type, last_type);
+    // NOTE: First searched type rotates, so a short budget does not keep
+    // ignoring the same types
+    auto type_count = last_type - first_type;
+    auto searched_types = 0;
+    ++search_count_;
+    for (auto i = 0; i < type_count; ++i) {
+        auto type = first_type + (i + search_count_) % type_count;
+        root_completed_.assign(root_candidates_.size(), false);
+        auto search_root = [&](size_t index, unsigned worker) {
+            if (Clock::now() > deadline_) {
+                return;
+            }
+            auto& level = scratch_[worker][0];
+            const auto& placement = root_placements_[root_candidates_[index]];
+            level.board = state.board;
+            auto cleared_layers = ApplyPlacement(level.board, placement, 1);
+            auto aborted = false;
+            auto value = weights_.cleared_layers * cleared_layers +
+                         EvaluatePiece(level.board, 1,
+                                       static_cast<BlockType>(type), worker,
+                                       aborted);
+            if (!aborted) {
+                root_type_values_[index] = value;
+                root_completed_[index] = true;
+            }
+        };
+        if (pool_) {
+            pool_->ParallelFor(root_candidates_.size(), search_root);
+        } else {
+            for (size_t i = 0; i < root_candidates_.size(); ++i) {
+                search_root(i, 0);
+            }
+        }
+        if (std::count(root_completed_.begin(), root_completed_.end(), 0)) {
+            break;
+        }
+        for (size_t i = 0; i < root_candidates_.size(); ++i) {
+            root_values_[i] += root_type_values_[i];
+        }
+        ++searched_types;
+    }
+    if (searched_types == 0) {
+        return true;
+    }
+
+    auto best_index = std::max_element(root_values_.begin(),
+                                       root_values_.end()) -
+                      root_values_.begin();
+    best = root_placements_[root_candidates_[best_index]];
+    return true;
+}
+
+float BeamSearchBot::Evaluate(const Board& board, int piece, unsigned worker,
+                              bool& aborted) {
+    auto& level = scratch_[worker][piece];
+    if (piece >= settings_.depth) {
+        auto features = ComputeBoardFeatures(board, level.heights);
+        return ScoreBoard(features, 0, weights_);
+    }
+
+    auto key = GetTableKey(board, piece);
+    float value = 0.f;
+    if (table_.Probe(key, value)) {
+        return value;
+    }
+
+    int first_type = 0, last_type = 0;
+    GetPieceTypes(piece, first_type, last_type);
+    auto total = 0.f;
+    for (auto type = first_type; type < last_type; ++type) {
+        total += EvaluatePiece(board, piece, static_cast<BlockType>(type),
+                               worker, aborted);
+        if (aborted) {
+            return 0.f;
+        }
+    }
+
+    value = total / (last_type - first_type);
+    table_.Store(key, value);
+    return value;
+}
+
+float BeamSearchBot::EvaluatePiece(const Board& board, int piece,
+                                   BlockType type, unsigned worker,
+                                   bool& aborted) {
+    if (Clock::now() > deadline_) {
+        aborted = true;
+        return 0.f;
+    }
+
+    auto& level = scratch_[worker][piece];
+    auto block = Block::Create(type, ColorR8G8B8{255, 255, 255}, board);
+    EnumeratePlacements(board, block, level.placements);
+    if (level.placements.empty()) {
+        return kLossValue;
+    }
+    ScorePlacements(board, level);
+
+    // NOTE: Static score of the last piece placement is its exact value
+    auto best = kLossValue;
+    if (piece + 1 >= settings_.depth) {
+        for (const auto& placement : level.placements) {
+            best = std::max(best, placement.score);
+        }
+        return best;
+    }
+
+    auto beam_size =
+        std::min<size_t>(settings_.beam_width, level.placements.size());
+    std::partial_sort(level.placements.begin(),
+                      level.placements.begin() + beam_size,
+                      level.placements.end(),
+                      [](const Placement& a, const Placement& b) {
+                          return a.score > b.score;
+                      });
+    for (size_t i = 0; i < beam_size; ++i) {
+        level.board = board;
+        auto cleared_layers =
+            ApplyPlacement(level.board, level.placements[i], 1);
+        auto value = weights_.cleared_layers * cleared_layers +
+                     Evaluate(level.board, piece + 1, worker, aborted);
+        if (aborted) {
+            return 0.f;
+        }
+        best = std::max(best, value);
+    }
+    return best;
+}
+
+void BeamSearchBot::GetPieceTypes(int piece, int& first_type,
+                                  int& last_type) const {
+    if (piece - 1 < static_cast<int>(preview_.size())) {
+        first_type = static_cast<int>(preview_[piece - 1]);
+        last_type = first_type + 1;
+    } else {
+        first_type = 0;
+        last_type = static_cast<int>(BlockType::Undefined);
+    }
+}
+
+void BeamSearchBot::ScorePlacements(const Board& board, Level& level) {
+    for (auto& placement : level.placements) {
+        level.board = board;
+        auto cleared_layers = ApplyPlacement(level.board, placement, 1);
+        auto features = ComputeBoardFeatures(level.board, level.heights);
+        placement.score = ScoreBoard(features, cleared_layers, weights_);
+    }
+}
+
+uint64_t BeamSearchBot::GetTableKey(const Board& board, int piece) const {
+    // NOTE: Value depends on the board and on the pieces left to place
+    auto key = HashOccupancy(board);
+    for (auto i = piece; i < settings_.depth; ++i) {
+        auto code = i - 1 < static_cast<int>(preview_.size())
+                        ? static_cast<uint64_t>(preview_[i - 1])
+                        : kUnknownPieceCode;
+        key = Mix(key ^ (code + 1));
+    }
+    return key;
+}
+
+} // namespace tetris3d
@@ -0,0 +1,88 @@
+#ifndef TETRIS3D_GAME_BEAM_SEARCH_BOT_H_
+#define TETRIS3D_GAME_BEAM_SEARCH_BOT_H_
+
+#include <chrono>
+#include <vector>
+
+#include "config.h"
+#include "game/bot.h"
+#include "game/transposition_table.h"
+#include "thread_pool.h"
+
+namespace tetris3d {
+
+struct BeamSearchSettings {
+    // Placements expanded further per searched piece
+    int beam_width = 8;
+    // Number of pieces searched, including the falling one
+    int depth = 2;
+    float time_budget_seconds = 0.03f;
+    unsigned table_size_log2 = 16;
+
+    static BeamSearchSettings FromConfig(const Config& config);
+};
+
+// 64-bit hash of the board occupancy (colors are ignored)
+uint64_t HashOccupancy(const Board& board);
+
+// Look-ahead bot: keeps the best beam_width placements of each piece and
+// searches upcoming pieces below them; a piece from the preview is searched
+// directly, an unknown one as expectation over all block types
+// NOTE: Values of searched boards are memoized in a transposition table,
+// which persists between moves (the next move searches mostly known boards)
+class BeamSearchBot : public Bot {
+public:
+    // @pool optional; root placements are searched in parallel on it
+    BeamSearchBot(const BotWeights& weights,
+                  const BeamSearchSettings& settings, ThreadPool* pool);
+
+    // Upcoming block types, following the falling one
+    void SetPreview(const std::vector<BlockType>& preview);
+
+    // NOTE: Search stops at the time budget; placements are then compared
+    // over the fully searched piece types only (greedy choice if none)
+    bool FindBestPlacement(const GameState& state, Placement& best) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Per-worker, per-piece scratch data; no allocations once warmed up
+    struct Level {
+        Board board{0, 0, 0};
+        std::vector<Placement> placements;
+        std::vector<int> heights;
+    };
+
+    // Value of the board with pieces [piece, depth) still to be placed
+    // @aborted set if the time budget ran out (value is meaningless then)
+    float Evaluate(const Board& board, int piece, unsigned worker,
+                   bool& aborted);
+    // Value of the board when the piece is of the given type
+    float EvaluatePiece(const Board& board, int piece, BlockType type,
+                        unsigned worker, bool& aborted);
+    // Types the piece can be of: the previewed one or all of them
+    void GetPieceTypes(int piece, int& first_type, int& last_type) const;
+    // Static score of placements on the board, stored in Placement::score
+    void ScorePlacements(const Board& board, Level& level);
+    uint64_t GetTableKey(const Board& board, int piece) const;
+
+    BotWeights weights_;
+    BeamSearchSettings settings_;
+    ThreadPool* pool_ = nullptr;
+    TranspositionTable table_;
+    std::vector<BlockType> preview_;
+    Clock::time_point deadline_;
+    int search_count_ = 0;
+
+    std::vector<std::vector<Level>> scratch_;
+    std::vector<Placement> root_placements_;
+    std::vector<uint64_t> root_hashes_;
+    std::vector<size_t> root_candidates_;
+    std::vector<float> root_values_;
+    std::vector<float> root_type_values_;
+    std::vector<char> root_completed_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_BEAM_SEARCH_BOT_H_
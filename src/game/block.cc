@@ -92,9 +92,9 @@ Block Block::Create(BlockType type, const ColorR8G8B8& color,
     return block;
 }
 
-Block Block::CreateRandom(const Board& board) {
+Block Block::CreateRandom(const Board& board, Random& random) {
     unsigned block_type_idx =
-        rand() % static_cast<unsigned>(BlockType::Undefined);
+        random.NextBelow(static_cast<unsigned>(BlockType::Undefined));
     BlockType type = static_cast<BlockType>(block_type_idx);
 
     // NOTE(panmar): pure black color is excluded;
@@ -105,9 +105,10 @@ Block Block::CreateRandom(const Board& board) {
     // way; Like having a shuffled vector of predefined colors
     ColorR8G8B8 color{0, 0, 0};
     while (!color.r && !color.b && !color.g) {
-        color = ColorR8G8B8{static_cast<uint8_t>(10 + rand() % 246),
-                            static_cast<uint8_t>(10 + rand() % 246),
-                            static_cast<uint8_t>(10 + rand() % 246)};
+        color =
+            ColorR8G8B8{static_cast<uint8_t>(10 + random.NextBelow(246)),
+                        static_cast<uint8_t>(10 + random.NextBelow(246)),
+                        static_cast<uint8_t>(10 + random.NextBelow(246))};
     }
     return Block::Create(type, color, board);
 }
@@ -332,31 +333,32 @@ bool Block::TryFix(const Board& board, const Block& prev_block) {
     glm::ivec3 min_bounds, max_bounds, prev_min_bounds, prev_max_bounds;
     this->GetWorldBounds(min_bounds, max_bounds);
     prev_block.GetWorldBounds(prev_min_bounds, prev_max_bounds);
-    // TODO(panmar): Use static container here
-    std::vector<glm::ivec3> translations;
+    // NOTE: At most one translation per horizontal direction
+    glm::ivec3 translations[4];
+    size_t translation_count = 0;
 
     // TODO(panmar): No sure about this implementations; it seems to be working
     // but more strict testing is needed here
     if (min_bounds.x < prev_min_bounds.x || max_bounds.x < prev_max_bounds.x) {
-        translations.push_back(glm::ivec3(1, 0, 0));
+        translations[translation_count++] = glm::ivec3(1, 0, 0);
     }
     if (min_bounds.x > prev_min_bounds.x || max_bounds.x > prev_max_bounds.x) {
-        translations.push_back(glm::ivec3(-1, 0, 0));
+        translations[translation_count++] = glm::ivec3(-1, 0, 0);
     }
 
     if (min_bounds.z < prev_min_bounds.z || max_bounds.z < prev_max_bounds.z) {
-        translations.push_back(glm::ivec3(0, 0, 1));
+        translations[translation_count++] = glm::ivec3(0, 0, 1);
     }
     if (min_bounds.z > prev_min_bounds.z || max_bounds.z > prev_max_bounds.z) {
-        translations.push_back(glm::ivec3(0, 0, -1));
+        translations[translation_count++] = glm::ivec3(0, 0, -1);
     }
 
-    // TODO(panmar): Use static container here
-    std::vector<Block> candidates(translations.size(), *this);
+    Block candidates[4];
+    std::fill_n(candidates, translation_count, *this);
 
     auto tries = 3;
     while (tries--) {
-        for (size_t i = 0; i < translations.size(); ++i) {
+        for (size_t i = 0; i < translation_count; ++i) {
             candidates[i].Translate(translations[i]);
             if (candidates[i].IsValid(board)) {
                 *this = candidates[i];
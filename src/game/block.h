@@ -1,11 +1,15 @@
 #ifndef TETRIS3D_GAME_BLOCK_H_
 #define TETRIS3D_GAME_BLOCK_H_
 
-#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 
 #include "glm/vec3.hpp"
 
 #include "game/color.h"
+#include "game/random.h"
 
 namespace tetris3d {
 
@@ -24,19 +28,63 @@ enum class BlockType {
 
 class Board;
 
+// Cube offsets of a block stored inline, so copying blocks (rotation and
+// translation attempts, ghost projection, state snapshots) never allocates
+// NOTE: Subset of std::vector interface used by blocks and serializers
+class CubeOffsets {
+public:
+    // NOTE: The largest block (OShape) consists of 8 cubes
+    static inline constexpr size_t kCapacity = 8;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear() { size_ = 0; }
+    // New offsets are zero
+    void resize(size_t size) {
+        assert(size <= kCapacity);
+        std::fill(offsets_ + size_, offsets_ + size, glm::ivec3(0));
+        size_ = static_cast<uint8_t>(size);
+    }
+    void push_back(const glm::ivec3& offset) {
+        assert(size_ < kCapacity);
+        offsets_[size_++] = offset;
+    }
+    void emplace_back(int x, int y, int z) { push_back(glm::ivec3(x, y, z)); }
+
+    glm::ivec3& operator[](size_t index) { return offsets_[index]; }
+    const glm::ivec3& operator[](size_t index) const {
+        return offsets_[index];
+    }
+    const glm::ivec3* data() const { return offsets_; }
+    glm::ivec3* begin() { return offsets_; }
+    glm::ivec3* end() { return offsets_ + size_; }
+    const glm::ivec3* begin() const { return offsets_; }
+    const glm::ivec3* end() const { return offsets_ + size_; }
+
+    bool operator==(const CubeOffsets& other) const {
+        return std::equal(begin(), end(), other.begin(), other.end());
+    }
+
+private:
+    glm::ivec3 offsets_[kCapacity];
+    uint8_t size_ = 0;
+};
+
 class Block {
 public:
+    static inline constexpr int kMaxCubes = CubeOffsets::kCapacity;
+
     static Block Create(BlockType type, const ColorR8G8B8& color,
                         const Board& board);
-    static Block CreateRandom(const Board& board);
+    static Block CreateRandom(const Board& board, Random& random);
 
+    BlockType GetType() const { return type_; }
     const glm::ivec3& GetPosition() const { return position_; }
     glm::ivec3& GetPosition() { return position_; }
     ColorR8G8B8 GetColor() const { return color_; }
 
-    const std::vector<glm::ivec3>& GetCubeOffsets() const {
-        return cube_offsets_;
-    }
+    const CubeOffsets& GetCubeOffsets() const { return cube_offsets_; }
+    CubeOffsets& GetCubeOffsets() { return cube_offsets_; }
 
     // Gets <min, max> corners of bounding box containing block in world space
     void GetWorldBounds(glm::ivec3& min, glm::ivec3& max) const;
@@ -92,7 +140,7 @@ private:
     glm::ivec3 position_;
 
     // NOTE(panmar): cubes positions in object space
-    std::vector<glm::ivec3> cube_offsets_;
+    CubeOffsets cube_offsets_;
     ColorR8G8B8 color_;
 };
 
@@ -1,14 +1,19 @@
 #include "game/board.h"
 
+#include <atomic>
+
 namespace tetris3d {
 
 Board::Board(int width, int depth, int height)
     : width_(width), depth_(depth), height_(height),
-      cells_(width_ * depth_ * height_, 0) {}
+      cells_(width_ * depth_ * height_, 0), layer_revisions_(height_) {
+    MarkAllLayersDirty();
+}
 
 void Board::Fill(const glm::ivec3& position, unsigned value) {
     auto index = PositionToIndex(position);
     cells_[index] = value;
+    MarkLayerDirty(position.y);
 }
 
 bool Board::IsEmpty(const glm::ivec3& position) const {
@@ -26,9 +31,13 @@ bool Board::Contains(const glm::ivec3& position) const {
     return true;
 }
 
+// NOTE: Computed in integers; float products lose precision past 2^24
+// cells (e.g. 256x256x512 boards)
 size_t Board::PositionToIndex(const glm::vec3& world_pos) const {
-    return (world_pos.x * width_ + world_pos.z) +
-           (world_pos.y * width_ * depth_);
+    auto x = static_cast<size_t>(world_pos.x);
+    auto y = static_cast<size_t>(world_pos.y);
+    auto z = static_cast<size_t>(world_pos.z);
+    return (x * width_ + z) + (y * width_ * depth_);
 }
 
 // Return number of filled layers erased; if there are no filled layers
@@ -47,6 +56,12 @@ unsigned Board::EraseFilledLayers() {
 }
 
 void Board::EraseLayer(unsigned layer) {
+    // NOTE: Layers above shift down, so all of them change
+    for (auto dirty_layer = layer;
+         dirty_layer < static_cast<unsigned>(height_); ++dirty_layer) {
+        MarkLayerDirty(dirty_layer);
+    }
+
     for (size_t i = 0; i < width_; ++i) {
         for (size_t j = 0; j < depth_; ++j) {
             auto index = (i * width_ + j) + (layer * width_ * depth_);
@@ -82,4 +97,27 @@ bool Board::IsLayerFilled(unsigned layer) const {
     return true;
 }
 
+uint64_t Board::NextRevision() {
+    constexpr uint64_t kCountMask = (uint64_t{1} << kRevisionCountBits) - 1;
+    auto& next = revision_counter_.next;
+    // NOTE: Base zero is never taken, so revisions are never zero (which
+    // renderers use for missing layers)
+    if (!next || (next & kCountMask) == kCountMask) {
+        static std::atomic<uint64_t> base{0};
+        next = (base.fetch_add(1, std::memory_order_relaxed) + 1)
+               << kRevisionCountBits;
+    }
+    return ++next;
+}
+
+void Board::MarkLayerDirty(unsigned layer) {
+    layer_revisions_[layer] = NextRevision();
+}
+
+void Board::MarkAllLayersDirty() {
+    for (auto& revision : layer_revisions_) {
+        revision = NextRevision();
+    }
+}
+
 } // namespace tetris3d
\ No newline at end of file
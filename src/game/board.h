@@ -1,6 +1,7 @@
 #ifndef TETRIS3D_GAME_BOARD_H_
 #define TETRIS3D_GAME_BOARD_H_
 
+#include <cstdint>
 #include <vector>
 
 #include "glm/vec3.hpp"
@@ -15,6 +16,9 @@ public:
     int GetDepth() const { return depth_; }
     int GetHeight() const { return height_; }
     const std::vector<unsigned>& GetCells() const { return cells_; }
+    // NOTE: Writes through it bypass change tracking; boards that are drawn
+    // must be marked dirty afterwards (see MarkLayerDirty)
+    std::vector<unsigned>& GetCells() { return cells_; }
     unsigned GetCell(size_t index) const { return cells_[index]; }
 
     void Fill(const glm::ivec3& position, unsigned value);
@@ -31,10 +35,41 @@ public:
     // 'layer' is height index of the board (counting from ground (0-based))
     bool IsLayerFilled(unsigned layer) const;
 
+    // Revision changes whenever cells of the layer change, so renderers can
+    // rebuild only what changed
+    // NOTE: Revisions are unique across all boards, so equal revisions mean
+    // equal layers even after a board is copied or assigned; a revision is
+    // a base unique to the board (taken from a process-wide counter on the
+    // first change after the board is built or copied) plus a plain count
+    // of its changes, so changing boards on many threads shares no atomic
+    uint64_t GetLayerRevision(unsigned layer) const {
+        return layer_revisions_[layer];
+    }
+    void MarkLayerDirty(unsigned layer);
+    void MarkAllLayersDirty();
+
 private:
-    const int width_ = 0;
-    const int depth_ = 0;
-    const int height_ = 0;
+    static inline constexpr int kRevisionCountBits = 20;
+
+    // Next revision of the board; copies start without a base, so they do
+    // not continue the revisions of their source
+    struct RevisionCounter {
+        RevisionCounter() = default;
+        RevisionCounter(const RevisionCounter&) {}
+        RevisionCounter& operator=(const RevisionCounter&) {
+            next = 0;
+            return *this;
+        }
+
+        uint64_t next = 0;
+    };
+
+    uint64_t NextRevision();
+
+    // NOTE: Not const, so boards (and whole game states) stay copy-assignable
+    int width_ = 0;
+    int depth_ = 0;
+    int height_ = 0;
 
     // NOTE(panmar): If zero cell is empty, otherwise is taken
     // If it is taken value store indicates a color for this particular cell
@@ -48,6 +83,8 @@ private:
     // black color could be taken if needed and game colorscheme could be
     // changed easily
     std::vector<unsigned> cells_;
+    std::vector<uint64_t> layer_revisions_;
+    RevisionCounter revision_counter_;
 };
 
 } // namespace tetris3d
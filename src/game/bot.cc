@@ -0,0 +1,327 @@
+#include "game/bot.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+namespace {
+
+const tetris3d::GameCommand kRotations[] = {
+    tetris3d::GameCommand::RotateXClockwise,
+    tetris3d::GameCommand::RotateXCounterClockwise,
+    tetris3d::GameCommand::RotateYClockwise,
+    tetris3d::GameCommand::RotateYCounterClockwise,
+    tetris3d::GameCommand::RotateZClockwise,
+    tetris3d::GameCommand::RotateZCounterClockwise,
+};
+
+struct Orientation {
+    tetris3d::Block block;
+    uint8_t rotation_count = 0;
+    tetris3d::GameCommand rotations[tetris3d::Placement::kMaxRotations];
+};
+
+bool HasSameShape(const tetris3d::Block& a, const tetris3d::Block& b) {
+    const auto& a_offsets = a.GetCubeOffsets();
+    const auto& b_offsets = b.GetCubeOffsets();
+    return a_offsets.size() == b_offsets.size() &&
+           std::is_permutation(a_offsets.begin(), a_offsets.end(),
+                               b_offsets.begin());
+}
+
+// NOTE: Same as Board::PositionToIndex, without float conversions
+size_t CellIndex(const tetris3d::Board& board, int x, int y, int z) {
+    return (x * board.GetWidth() + z) +
+           (y * board.GetWidth() * board.GetDepth());
+}
+
+// Moves block step by step; fails if any intermediate position is invalid
+bool TryMoveSteps(tetris3d::Block& block, const tetris3d::Board& board,
+                  const glm::ivec3& step, int count) {
+    for (int i = 0; i < count; ++i) {
+        block.Translate(step);
+        if (!block.IsValid(board)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+namespace tetris3d {
+
+BotWeights BotWeights::FromConfig(const Config& config) {
+    BotWeights weights;
+    weights.aggregate_height = config.bot_weight_aggregate_height;
+    weights.holes = config.bot_weight_holes;
+    weights.bumpiness = config.bot_weight_bumpiness;
+    weights.cleared_layers = config.bot_weight_cleared_layers;
+    if (!config.bot_weights_path.empty()) {
+        weights.Load(config.bot_weights_path);
+    }
+    return weights;
+}
+
+void BotWeights::Load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw Error("Cannot open bot weights file: " + path);
+    }
+
+    std::string name;
+    float value = 0.f;
+    while (file >> name >> value) {
+        if (name == "aggregate_height") {
+            aggregate_height = value;
+        } else if (name == "holes") {
+            holes = value;
+        } else if (name == "bumpiness") {
+            bumpiness = value;
+        } else if (name == "cleared_layers") {
+            cleared_layers = value;
+        } else {
+            throw Error("Unknown bot weight in " + path + ": " + name);
+        }
+    }
+    if (!file.eof()) {
+        throw Error("Bot weights file is malformed: " + path);
+    }
+}
+
+void BotWeights::Save(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        throw Error("Cannot open bot weights file for writing: " + path);
+    }
+    file << "aggregate_height " << aggregate_height << "\n"
+         << "holes " << holes << "\n"
+         << "bumpiness " << bumpiness << "\n"
+         << "cleared_layers " << cleared_layers << "\n";
+}
+
+void Placement::ToCommands(std::vector<GameCommand>& commands) const {
+    for (int i = 0; i < rotation_count; ++i) {
+        commands.push_back(rotations[i]);
+    }
+    for (int i = 0; i < std::abs(move_x); ++i) {
+        commands.push_back(move_x > 0 ? GameCommand::MoveXPositive
+                                      : GameCommand::MoveXNegative);
+    }
+    for (int i = 0; i < std::abs(move_z); ++i) {
+        commands.push_back(move_z > 0 ? GameCommand::MoveZPositive
+                                      : GameCommand::MoveZNegative);
+    }
+    commands.push_back(GameCommand::HardDrop);
+}
+
+void EnumeratePlacements(const Board& board, const Block& block,
+                         std::vector<Placement>& placements) {
+    placements.clear();
+    if (!block.IsValid(board)) {
+        return;
+    }
+
+    // NOTE: Breadth-first search, so each orientation is reached with the
+    // shortest rotation sequence; rotations use the same fix logic as the
+    // game, so the orientation ends up exactly where the game would put it
+    std::vector<Orientation> orientations(1);
+    orientations[0].block = block;
+    for (size_t i = 0; i < orientations.size(); ++i) {
+        if (orientations[i].rotation_count == Placement::kMaxRotations) {
+            continue;
+        }
+        for (auto rotation : kRotations) {
+            auto rotated = orientations[i].block;
+            if (!ApplyBlockCommand(rotated, board, rotation)) {
+                continue;
+            }
+            auto is_known = std::any_of(
+                orientations.begin(), orientations.end(),
+                [&](const Orientation& orientation) {
+                    return HasSameShape(orientation.block, rotated);
+                });
+            if (is_known) {
+                continue;
+            }
+            Orientation orientation = orientations[i];
+            orientation.block = rotated;
+            orientation.rotations[orientation.rotation_count++] = rotation;
+            orientations.push_back(orientation);
+        }
+    }
+
+    Block moved;
+    for (const auto& orientation : orientations) {
+        for (int move_x = -board.GetWidth(); move_x <= board.GetWidth();
+             ++move_x) {
+            for (int move_z = -board.GetDepth(); move_z <= board.GetDepth();
+                 ++move_z) {
+                moved = orientation.block;
+                if (!TryMoveSteps(moved, board,
+                                  glm::ivec3(move_x > 0 ? 1 : -1, 0, 0),
+                                  std::abs(move_x)) ||
+                    !TryMoveSteps(moved, board,
+                                  glm::ivec3(0, 0, move_z > 0 ? 1 : -1),
+                                  std::abs(move_z))) {
+                    continue;
+                }
+                while (moved.IsValid(board)) {
+                    moved.Translate(glm::ivec3(0, -1, 0));
+                }
+                moved.Translate(glm::ivec3(0, 1, 0));
+
+                Placement placement;
+                placement.rotation_count = orientation.rotation_count;
+                std::copy_n(orientation.rotations, orientation.rotation_count,
+                            placement.rotations);
+                placement.move_x = move_x;
+                placement.move_z = move_z;
+                for (auto& offset : moved.GetCubeOffsets()) {
+                    placement.cells[placement.cell_count++] =
+                        moved.GetPosition() + offset;
+                }
+                placements.push_back(placement);
+            }
+        }
+    }
+}
+
+unsigned ApplyPlacement(Board& board, const Placement& placement,
+                        unsigned value) {
+    for (int i = 0; i < placement.cell_count; ++i) {
+        const auto& cell = placement.cells[i];
+        board.GetCells()[CellIndex(board, cell.x, cell.y, cell.z)] = value;
+    }
+    return board.EraseFilledLayers();
+}
+
+BoardFeatures ComputeBoardFeatures(const Board& board,
+                                   std::vector<int>& heights) {
+    auto width = board.GetWidth();
+    auto depth = board.GetDepth();
+    const auto& cells = board.GetCells();
+    heights.resize(width * depth);
+
+    BoardFeatures features;
+    for (int x = 0; x < width; ++x) {
+        for (int z = 0; z < depth; ++z) {
+            auto height = 0;
+            for (int y = board.GetHeight() - 1; y >= 0; --y) {
+                if (cells[CellIndex(board, x, y, z)]) {
+                    if (!height) {
+                        height = y + 1;
+                    }
+                } else if (height) {
+                    ++features.holes;
+                }
+            }
+            heights[x * depth + z] = height;
+            features.aggregate_height += height;
+            features.max_height = std::max(features.max_height, height);
+        }
+    }
+
+    for (int x = 0; x < width; ++x) {
+        for (int z = 0; z < depth; ++z) {
+            auto height = heights[x * depth + z];
+            if (x + 1 < width) {
+                auto neighbour_height = heights[(x + 1) * depth + z];
+                features.bumpiness += std::abs(height - neighbour_height);
+            }
+            if (z + 1 < depth) {
+                auto neighbour_height = heights[x * depth + z + 1];
+                features.bumpiness += std::abs(height - neighbour_height);
+            }
+        }
+    }
+    return features;
+}
+
+float ScoreBoard(const BoardFeatures& features, unsigned cleared_layers,
+                 const BotWeights& weights) {
+    return weights.aggregate_height * features.aggregate_height +
+           weights.holes * features.holes +
+           weights.bumpiness * features.bumpiness +
+           weights.cleared_layers * cleared_layers;
+}
+
+HeuristicBot::HeuristicBot(const BotWeights& weights, ThreadPool* pool)
+    : weights_(weights), pool_(pool),
+      scratch_(pool ? pool->GetThreadCount() + 1 : 1) {}
+
+bool HeuristicBot::FindBestPlacement(const GameState& state, Placement& best) {
+    EnumeratePlacements(state.board, state.falling_block, placements_);
+    if (placements_.empty()) {
+        return false;
+    }
+
+    auto evaluate = [&](size_t index, unsigned worker) {
+        auto& scratch = scratch_[worker];
+        // NOTE: Copy-assignment reuses scratch board storage
+        scratch.board = state.board;
+        auto& placement = placements_[index];
+        auto cleared_layers = ApplyPlacement(scratch.board, placement, 1);
+        auto features = ComputeBoardFeatures(scratch.board, scratch.heights);
+        placement.score = ScoreBoard(features, cleared_layers, weights_);
+    };
+
+    if (pool_) {
+        pool_->ParallelFor(placements_.size(), evaluate);
+    } else {
+        for (size_t i = 0; i < placements_.size(); ++i) {
+            evaluate(i, 0);
+        }
+    }
+
+    // NOTE: Ties are resolved by enumeration order, so the choice does not
+    // depend on the number of threads
+    best = *std::max_element(placements_.begin(), placements_.end(),
+                             [](const Placement& a, const Placement& b) {
+                                 return a.score < b.score;
+                             });
+    return true;
+}
+
+void Bot::Update(const GameState& state, float elapsed_seconds,
+                 float commands_per_second, CommandBatch& commands) {
+    if (state.paused) {
+        return;
+    }
+
+    if (state.phase != GameState::Phase::NewBlockCreation &&
+        state.phase != GameState::Phase::BlockFalling) {
+        has_plan_ = false;
+        return;
+    }
+
+    if (!has_plan_) {
+        plan_.clear();
+        plan_position_ = 0;
+        Placement best;
+        if (FindBestPlacement(state, best)) {
+            best.ToCommands(plan_);
+        } else {
+            plan_.push_back(GameCommand::HardDrop);
+        }
+        has_plan_ = true;
+    }
+
+    if (commands_per_second <= 0.f) {
+        while (plan_position_ < plan_.size() &&
+               commands.Push(plan_[plan_position_])) {
+            ++plan_position_;
+        }
+        return;
+    }
+
+    seconds_to_next_command_ -= elapsed_seconds;
+    while (seconds_to_next_command_ <= 0.f && plan_position_ < plan_.size() &&
+           commands.Push(plan_[plan_position_])) {
+        ++plan_position_;
+        seconds_to_next_command_ += 1.f / commands_per_second;
+    }
+    seconds_to_next_command_ = std::max(seconds_to_next_command_, 0.f);
+}
+
+} // namespace tetris3d
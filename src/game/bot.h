@@ -0,0 +1,127 @@
+#ifndef TETRIS3D_GAME_BOT_H_
+#define TETRIS3D_GAME_BOT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "glm/vec3.hpp"
+
+#include "config.h"
+#include "game/block.h"
+#include "game/board.h"
+#include "game/command.h"
+#include "game/state.h"
+#include "thread_pool.h"
+
+namespace tetris3d {
+
+// Linear weights of board features scored by the heuristic bot
+struct BotWeights {
+    float aggregate_height = -0.51f;
+    float holes = -0.36f;
+    float bumpiness = -0.18f;
+    float cleared_layers = 0.76f;
+
+    // NOTE: Weights file (if configured) overrides bot_weight_* values
+    static BotWeights FromConfig(const Config& config);
+
+    // Text file with "name value" lines, as written by tetris3d-tune;
+    // weights missing in the file are left unchanged
+    void Load(const std::string& path);
+    void Save(const std::string& path) const;
+};
+
+struct BoardFeatures {
+    // Sum of column heights
+    int aggregate_height = 0;
+    // Empty cells with a filled cell above in the same column
+    int holes = 0;
+    // Sum of height differences between neighbouring columns
+    int bumpiness = 0;
+    int max_height = 0;
+};
+
+// Resting place of a dropped block along with the way to reach it
+struct Placement {
+    static inline constexpr int kMaxRotations = 4;
+
+    uint8_t rotation_count = 0;
+    GameCommand rotations[kMaxRotations];
+    // Signed number of steps; first along X, then along Z
+    int move_x = 0;
+    int move_z = 0;
+
+    uint8_t cell_count = 0;
+    glm::ivec3 cells[Block::kMaxCubes];
+
+    float score = 0.f;
+
+    // Appends commands reaching placement, ending with a hard drop
+    void ToCommands(std::vector<GameCommand>& commands) const;
+};
+
+// Enumerates placements reachable by rotating the block where it is,
+// moving it horizontally and dropping it down
+void EnumeratePlacements(const Board& board, const Block& block,
+                         std::vector<Placement>& placements);
+
+// Fills placement cells and erases filled layers; returns erased layers count
+unsigned ApplyPlacement(Board& board, const Placement& placement,
+                        unsigned value);
+
+// @heights scratch storage for column heights (no allocation once sized)
+BoardFeatures ComputeBoardFeatures(const Board& board,
+                                   std::vector<int>& heights);
+
+float ScoreBoard(const BoardFeatures& features, unsigned cleared_layers,
+                 const BotWeights& weights);
+
+// Common part of bots: plans a placement once per new falling block and
+// feeds it to the game as commands
+class Bot {
+public:
+    virtual ~Bot() = default;
+
+    // Returns false if the falling block cannot be placed anywhere
+    virtual bool FindBestPlacement(const GameState& state,
+                                   Placement& best) = 0;
+
+    // Appends commands for this frame
+    // @commands_per_second pace of issued commands; zero issues the whole
+    // placement in a single frame
+    void Update(const GameState& state, float elapsed_seconds,
+                float commands_per_second, CommandBatch& commands);
+
+private:
+    std::vector<GameCommand> plan_;
+    size_t plan_position_ = 0;
+    bool has_plan_ = false;
+    float seconds_to_next_command_ = 0.f;
+};
+
+// Greedy bot: scores every reachable placement of the falling block and
+// plays the best one
+class HeuristicBot : public Bot {
+public:
+    // @pool optional; candidates are scored on the calling thread if null
+    HeuristicBot(const BotWeights& weights, ThreadPool* pool);
+
+    bool FindBestPlacement(const GameState& state, Placement& best) override;
+
+private:
+    // Per-worker copies, so candidates are scored without allocations
+    struct Scratch {
+        Board board{0, 0, 0};
+        std::vector<int> heights;
+    };
+
+    BotWeights weights_;
+    ThreadPool* pool_ = nullptr;
+    std::vector<Placement> placements_;
+    std::vector<Scratch> scratch_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_BOT_H_
@@ -0,0 +1,125 @@
+#include "game/command.h"
+
+#include "glm/geometric.hpp"
+#include "glm/gtc/constants.hpp"
+
+#include "game/block.h"
+#include "game/board.h"
+
+namespace tetris3d {
+
+bool ApplyBlockCommand(Block& block, const Board& board, GameCommand command) {
+    switch (command) {
+    case GameCommand::MoveXPositive:
+        return block.TryTranslate(board, glm::ivec3(1, 0, 0));
+    case GameCommand::MoveXNegative:
+        return block.TryTranslate(board, glm::ivec3(-1, 0, 0));
+    case GameCommand::MoveZPositive:
+        return block.TryTranslate(board, glm::ivec3(0, 0, 1));
+    case GameCommand::MoveZNegative:
+        return block.TryTranslate(board, glm::ivec3(0, 0, -1));
+    case GameCommand::RotateXClockwise:
+        return block.TryRotateXClockwiseWithFix(board);
+    case GameCommand::RotateXCounterClockwise:
+        return block.TryRotateXCounterClockwiseWithFix(board);
+    case GameCommand::RotateYClockwise:
+        return block.TryRotateYClockwiseWithFix(board);
+    case GameCommand::RotateYCounterClockwise:
+        return block.TryRotateYCounterClockwiseWithFix(board);
+    case GameCommand::RotateZClockwise:
+        return block.TryRotateZClockwiseWithFix(board);
+    case GameCommand::RotateZCounterClockwise:
+        return block.TryRotateZCounterClockwiseWithFix(board);
+    case GameCommand::TogglePause:
+    case GameCommand::SoftDrop:
+    case GameCommand::HardDrop:
+    case GameCommand::Count:
+        break;
+    }
+    return false;
+}
+
+InputCommandMapper::InputCommandMapper(Config& config) : config_(config) {}
+
+void InputCommandMapper::Map(const Input& input, const glm::vec3& view_dir,
+                             CommandBatch& commands) {
+    commands.Clear();
+
+    if (input.IsKeyPressed(config_.key_pause)) {
+        commands.Push(GameCommand::TogglePause);
+    }
+
+    if (!is_mapping_valid_ || view_dir != view_dir_) {
+        UpdateAxisMapping(view_dir);
+    }
+
+    if (input.IsKeyPressed(config_.key_block_horiz_rot_clock)) {
+        commands.Push(horiz_rot_clock_);
+    }
+    if (input.IsKeyPressed(config_.key_block_horiz_rot_counterclock)) {
+        commands.Push(horiz_rot_counterclock_);
+    }
+    if (input.IsKeyPressed(config_.key_block_vert_rot_away)) {
+        commands.Push(vert_rot_away_);
+    }
+    if (input.IsKeyPressed(config_.key_block_vert_rot_towards)) {
+        commands.Push(vert_rot_towards_);
+    }
+    if (input.IsKeyPressed(config_.key_block_move_away)) {
+        commands.Push(move_away_);
+    }
+    if (input.IsKeyPressed(config_.key_block_move_towards)) {
+        commands.Push(move_towards_);
+    }
+    if (input.IsKeyPressed(config_.key_block_drop)) {
+        commands.Push(GameCommand::HardDrop);
+    }
+    if (input.IsKeyDown(config_.key_block_accelerate)) {
+        commands.Push(GameCommand::SoftDrop);
+    }
+}
+
+void InputCommandMapper::UpdateAxisMapping(const glm::vec3& view_dir) {
+    view_dir_ = view_dir;
+    is_mapping_valid_ = true;
+
+    if (view_dir.y < 0.f) {
+        horiz_rot_clock_ = GameCommand::RotateYClockwise;
+        horiz_rot_counterclock_ = GameCommand::RotateYCounterClockwise;
+    } else {
+        horiz_rot_clock_ = GameCommand::RotateYCounterClockwise;
+        horiz_rot_counterclock_ = GameCommand::RotateYClockwise;
+    }
+
+    // NOTE: Camera-relative directions snap to the board axis which is
+    // closest to the horizontal view direction
+    auto view_dir_xz = view_dir;
+    view_dir_xz.y = 0.f;
+    view_dir_xz = glm::normalize(view_dir_xz);
+    auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
+    if (glm::abs(dot) < glm::cos(glm::pi<float>() / 4.f)) {
+        vert_rot_away_ = view_dir.z < 0.f
+                             ? GameCommand::RotateXClockwise
+                             : GameCommand::RotateXCounterClockwise;
+        vert_rot_towards_ = view_dir.z > 0.f
+                                ? GameCommand::RotateXClockwise
+                                : GameCommand::RotateXCounterClockwise;
+        move_away_ = view_dir.z < 0.f ? GameCommand::MoveZNegative
+                                      : GameCommand::MoveZPositive;
+        move_towards_ = view_dir.z > 0.f ? GameCommand::MoveZNegative
+                                         : GameCommand::MoveZPositive;
+    } else {
+        vert_rot_away_ = view_dir.x < 0.f
+                             ? GameCommand::RotateZCounterClockwise
+                             : GameCommand::RotateZClockwise;
+        vert_rot_towards_ = view_dir.x > 0.f
+                                ? GameCommand::RotateZCounterClockwise
+                                : GameCommand::RotateZClockwise;
+        move_away_ = view_dir.x < 0.f ? GameCommand::MoveXNegative
+                                      : GameCommand::MoveXPositive;
+        move_towards_ = view_dir.x > 0.f ? GameCommand::MoveXNegative
+                                         : GameCommand::MoveXPositive;
+    }
+}
+
+} // namespace tetris3d
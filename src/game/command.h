@@ -0,0 +1,88 @@
+#ifndef TETRIS3D_GAME_COMMAND_H_
+#define TETRIS3D_GAME_COMMAND_H_
+
+#include <cstdint>
+
+#include "glm/vec3.hpp"
+
+#include "config.h"
+#include "input.h"
+
+namespace tetris3d {
+
+// Abstract game commands expressed in board space; live input, replays and
+// bots all drive the simulation through them
+enum class GameCommand : uint8_t {
+    TogglePause,
+    MoveXPositive,
+    MoveXNegative,
+    MoveZPositive,
+    MoveZNegative,
+    RotateXClockwise,
+    RotateXCounterClockwise,
+    RotateYClockwise,
+    RotateYCounterClockwise,
+    RotateZClockwise,
+    RotateZCounterClockwise,
+    // Accelerated fall; active for the frame it is issued in
+    SoftDrop,
+    // Moves block to its lowest valid position, so it is merged next step
+    HardDrop,
+
+    // NOTE: This should be the last element
+    Count
+};
+
+// Commands issued during a single frame, applied in order
+struct CommandBatch {
+    static inline constexpr int kMaxCommands = 15;
+
+    uint8_t count = 0;
+    GameCommand commands[kMaxCommands];
+
+    bool Push(GameCommand command) {
+        if (count == kMaxCommands) {
+            return false;
+        }
+        commands[count++] = command;
+        return true;
+    }
+    void Clear() { count = 0; }
+    const GameCommand* begin() const { return commands; }
+    const GameCommand* end() const { return commands + count; }
+};
+
+class Block;
+class Board;
+
+// Moves or rotates block according to command; returns true if succeeded
+// NOTE: Commands other than moves and rotations are ignored (return false)
+bool ApplyBlockCommand(Block& block, const Board& board, GameCommand command);
+
+// Translates pressed keys into commands; camera-relative keys (move/rotate
+// away, towards, etc.) are resolved to board axes once per view direction
+class InputCommandMapper {
+public:
+    InputCommandMapper(Config& config);
+
+    void Map(const Input& input, const glm::vec3& view_dir,
+             CommandBatch& commands);
+
+private:
+    void UpdateAxisMapping(const glm::vec3& view_dir);
+
+    Config& config_;
+
+    glm::vec3 view_dir_ = glm::vec3(0.f);
+    bool is_mapping_valid_ = false;
+    GameCommand horiz_rot_clock_ = GameCommand::RotateYClockwise;
+    GameCommand horiz_rot_counterclock_ = GameCommand::RotateYCounterClockwise;
+    GameCommand vert_rot_away_ = GameCommand::RotateXClockwise;
+    GameCommand vert_rot_towards_ = GameCommand::RotateXClockwise;
+    GameCommand move_away_ = GameCommand::MoveZNegative;
+    GameCommand move_towards_ = GameCommand::MoveZPositive;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_COMMAND_H_
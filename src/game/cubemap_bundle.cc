@@ -0,0 +1,300 @@
+#include "game/cubemap_bundle.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.h"
+
+namespace tetris3d {
+namespace {
+
+constexpr unsigned kFaceCount = 6;
+constexpr uint64_t kImageAlignment = 16;
+
+bool IsPowerOfTwo(int value) { return value > 0 && !(value & (value - 1)); }
+
+uint64_t GetImageSize(CubemapBundleFormat format, uint64_t size) {
+    if (format == CubemapBundleFormat::Bc1) {
+        auto blocks = (size + 3) / 4;
+        return blocks * blocks * 8;
+    }
+    return size * size * 3;
+}
+
+RgbImage Downsample(const RgbImage& image) {
+    RgbImage result;
+    result.width = std::max(1, image.width / 2);
+    result.height = std::max(1, image.height / 2);
+    result.pixels.resize(static_cast<size_t>(result.width) * result.height *
+                         3);
+    auto texel = [&image](int x, int y, int channel) {
+        x = std::min(x, image.width - 1);
+        y = std::min(y, image.height - 1);
+        return image.pixels[(static_cast<size_t>(y) * image.width + x) * 3 +
+                            channel];
+    };
+    for (int y = 0; y < result.height; ++y) {
+        for (int x = 0; x < result.width; ++x) {
+            for (int channel = 0; channel < 3; ++channel) {
+                auto sum = texel(2 * x, 2 * y, channel) +
+                           texel(2 * x + 1, 2 * y, channel) +
+                           texel(2 * x, 2 * y + 1, channel) +
+                           texel(2 * x + 1, 2 * y + 1, channel);
+                result.pixels[(static_cast<size_t>(y) * result.width + x) * 3 +
+                              channel] = (sum + 2) / 4;
+            }
+        }
+    }
+    return result;
+}
+
+uint16_t PackRgb565(int r, int g, int b) {
+    return ((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 |
+           ((b * 31 + 127) / 255);
+}
+
+void UnpackRgb565(uint16_t color, int rgb[3]) {
+    auto r = color >> 11;
+    auto g = (color >> 5) & 0x3f;
+    auto b = color & 0x1f;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Endpoints are corners of the (slightly inset) color bounding box; every
+// texel takes the closest of the four palette colors
+void EncodeBc1Block(const uint8_t texels[16][3], uint8_t* output) {
+    int min[3] = {255, 255, 255};
+    int max[3] = {0, 0, 0};
+    for (int i = 0; i < 16; ++i) {
+        for (int channel = 0; channel < 3; ++channel) {
+            min[channel] = std::min<int>(min[channel], texels[i][channel]);
+            max[channel] = std::max<int>(max[channel], texels[i][channel]);
+        }
+    }
+    for (int channel = 0; channel < 3; ++channel) {
+        auto inset = (max[channel] - min[channel]) / 16;
+        min[channel] += inset;
+        max[channel] -= inset;
+    }
+    auto color0 = PackRgb565(max[0], max[1], max[2]);
+    auto color1 = PackRgb565(min[0], min[1], min[2]);
+    // NOTE: color0 > color1 selects the four color mode (no transparency)
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        UnpackRgb565(color0, palette[0]);
+        UnpackRgb565(color1, palette[1]);
+        for (int channel = 0; channel < 3; ++channel) {
+            palette[2][channel] =
+                (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] =
+                (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+        for (int i = 0; i < 16; ++i) {
+            auto best_index = 0;
+            auto best_distance = INT32_MAX;
+            for (int index = 0; index < 4; ++index) {
+                auto distance = 0;
+                for (int channel = 0; channel < 3; ++channel) {
+                    auto delta = texels[i][channel] - palette[index][channel];
+                    distance += delta * delta;
+                }
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best_index = index;
+                }
+            }
+            indices |= static_cast<uint32_t>(best_index) << (2 * i);
+        }
+    }
+
+    const uint8_t block[8] = {
+        static_cast<uint8_t>(color0),
+        static_cast<uint8_t>(color0 >> 8),
+        static_cast<uint8_t>(color1),
+        static_cast<uint8_t>(color1 >> 8),
+        static_cast<uint8_t>(indices),
+        static_cast<uint8_t>(indices >> 8),
+        static_cast<uint8_t>(indices >> 16),
+        static_cast<uint8_t>(indices >> 24),
+    };
+    std::memcpy(output, block, sizeof(block));
+}
+
+std::vector<uint8_t> EncodeBc1(const RgbImage& image) {
+    auto blocks_x = (image.width + 3) / 4;
+    auto blocks_y = (image.height + 3) / 4;
+    std::vector<uint8_t> output(static_cast<size_t>(blocks_x) * blocks_y * 8);
+    uint8_t texels[16][3];
+    for (int block_y = 0; block_y < blocks_y; ++block_y) {
+        for (int block_x = 0; block_x < blocks_x; ++block_x) {
+            // NOTE: Levels smaller than a block repeat their edge texels
+            for (int i = 0; i < 16; ++i) {
+                auto x = std::min(block_x * 4 + i % 4, image.width - 1);
+                auto y = std::min(block_y * 4 + i / 4, image.height - 1);
+                std::memcpy(
+                    texels[i],
+                    &image.pixels[(static_cast<size_t>(y) * image.width + x) *
+                                  3],
+                    3);
+            }
+            EncodeBc1Block(texels,
+                           &output[(static_cast<size_t>(block_y) * blocks_x +
+                                    block_x) *
+                                   8]);
+        }
+    }
+    return output;
+}
+
+} // namespace
+
+void WriteCubemapBundle(const std::string& path,
+                        const std::vector<RgbImage>& faces,
+                        CubemapBundleFormat format) {
+    if (faces.size() != kFaceCount) {
+        throw Error("Cubemap needs 6 faces");
+    }
+    auto face_size = faces.front().width;
+    for (const auto& face : faces) {
+        if (face.width != face_size || face.height != face_size ||
+            !IsPowerOfTwo(face_size)) {
+            throw Error("Cubemap faces must be square, power of two sized "
+                        "and equal");
+        }
+    }
+
+    // Images in file order: level by level, faces in cubemap order
+    std::vector<std::vector<uint8_t>> images;
+    auto levels = faces;
+    while (true) {
+        for (const auto& level : levels) {
+            images.push_back(format == CubemapBundleFormat::Bc1
+                                 ? EncodeBc1(level)
+                                 : level.pixels);
+        }
+        if (levels.front().width == 1) {
+            break;
+        }
+        for (auto& level : levels) {
+            level = Downsample(level);
+        }
+    }
+
+    CubemapBundleHeader header;
+    header.format = format;
+    header.face_size = face_size;
+    header.level_count = images.size() / kFaceCount;
+    std::vector<CubemapBundleImage> entries(images.size());
+    uint64_t offset =
+        sizeof(header) + entries.size() * sizeof(CubemapBundleImage);
+    for (size_t i = 0; i < images.size(); ++i) {
+        offset = (offset + kImageAlignment - 1) / kImageAlignment *
+                 kImageAlignment;
+        entries[i].offset = offset;
+        entries[i].size = images[i].size();
+        offset += images[i].size();
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw Error("Cannot create cubemap bundle: " + path);
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               entries.size() * sizeof(CubemapBundleImage));
+    for (size_t i = 0; i < images.size(); ++i) {
+        const char padding[kImageAlignment] = {};
+        file.write(padding,
+                   entries[i].offset - static_cast<uint64_t>(file.tellp()));
+        file.write(reinterpret_cast<const char*>(images[i].data()),
+                   images[i].size());
+    }
+    if (!file) {
+        throw Error("Failed to write cubemap bundle: " + path);
+    }
+}
+
+CubemapBundleReader::~CubemapBundleReader() { Close(); }
+
+void CubemapBundleReader::Open(const std::string& path) {
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw Error("Cannot open cubemap bundle: " + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<size_t>(file_stat.st_size) < sizeof(CubemapBundleHeader)) {
+        close(fd);
+        throw Error("Cubemap bundle is truncated: " + path);
+    }
+    size_ = file_stat.st_size;
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw Error("Cannot map cubemap bundle: " + path);
+    }
+    data_ = static_cast<const uint8_t*>(data);
+
+    std::memcpy(&header_, data_, sizeof(header_));
+    auto valid = std::memcmp(header_.magic, CubemapBundleHeader().magic, 4) ==
+                     0 &&
+                 header_.version == CubemapBundleHeader().version &&
+                 (header_.format == CubemapBundleFormat::Rgb8 ||
+                  header_.format == CubemapBundleFormat::Bc1) &&
+                 header_.face_size > 0 && header_.face_size <= (1u << 16) &&
+                 IsPowerOfTwo(header_.face_size) &&
+                 header_.level_count > 0 && header_.level_count <= 17 &&
+                 (1u << (header_.level_count - 1)) == header_.face_size &&
+                 sizeof(header_) + header_.level_count * kFaceCount *
+                                       sizeof(CubemapBundleImage) <=
+                     size_;
+    if (valid) {
+        images_.resize(header_.level_count * kFaceCount);
+        std::memcpy(images_.data(), data_ + sizeof(header_),
+                    images_.size() * sizeof(CubemapBundleImage));
+        // NOTE: Sizes are checked, so uploads never read past the mapping
+        for (size_t i = 0; i < images_.size(); ++i) {
+            const auto& image = images_[i];
+            auto level_size = header_.face_size >> (i / kFaceCount);
+            valid = valid && image.offset <= size_ &&
+                    image.size <= size_ - image.offset &&
+                    image.size == GetImageSize(header_.format, level_size);
+        }
+    }
+    if (!valid) {
+        Close();
+        throw Error("Cubemap bundle is corrupted: " + path);
+    }
+}
+
+void CubemapBundleReader::Close() {
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    images_.clear();
+}
+
+const uint8_t* CubemapBundleReader::GetImage(unsigned level, unsigned face,
+                                             size_t& size) const {
+    const auto& image = images_[level * kFaceCount + face];
+    size = image.size;
+    return data_ + image.offset;
+}
+
+} // namespace tetris3d
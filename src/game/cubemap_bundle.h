@@ -0,0 +1,78 @@
+#ifndef TETRIS3D_GAME_CUBEMAP_BUNDLE_H_
+#define TETRIS3D_GAME_CUBEMAP_BUNDLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "png.h"
+
+namespace tetris3d {
+
+enum class CubemapBundleFormat : uint32_t {
+    Rgb8 = 0,
+    // S3TC DXT1: 4x4 texel blocks of 8 bytes, 6:1 smaller than Rgb8
+    Bc1 = 1,
+};
+
+// Cubemap bundle file layout:
+// ----
+// CubemapBundleHeader
+// CubemapBundleImage[level_count * 6], faces of level 0, then level 1...
+// image data, every image 16-byte aligned
+// ----
+// Faces go in cubemap order (X, -X, Y, -Y, Z, -Z); levels are the whole
+// mipmap chain, from face_size down to 1x1, ready for glTexImage2D (Rgb8,
+// tightly packed rows) or glCompressedTexImage2D (Bc1); rows keep the order
+// of the source images, as the JPEG loading path uploads them
+struct CubemapBundleHeader {
+    char magic[4] = {'T', '3', 'D', 'C'};
+    uint32_t version = 1;
+    CubemapBundleFormat format = CubemapBundleFormat::Rgb8;
+    uint32_t face_size = 0;
+    uint32_t level_count = 0;
+    uint32_t reserved = 0;
+};
+
+struct CubemapBundleImage {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+// Builds the mipmap chain of faces (square, power of two, same size) and
+// writes the bundle; throws Error on failure
+// NOTE: Meant for build time (see tetris3d-pack-skybox); Bc1 encoding is
+// a simple bounding box fit, slow-ish but done once
+void WriteCubemapBundle(const std::string& path,
+                        const std::vector<RgbImage>& faces,
+                        CubemapBundleFormat format);
+
+// Memory mapped bundle; images point straight into the mapping, so there is
+// no decode or copy before the upload
+class CubemapBundleReader {
+public:
+    CubemapBundleReader() = default;
+    ~CubemapBundleReader();
+
+    // Throws Error if the file is missing or is not a valid bundle
+    void Open(const std::string& path);
+    bool IsOpen() const { return data_ != nullptr; }
+    void Close();
+
+    const CubemapBundleHeader& GetHeader() const { return header_; }
+    const uint8_t* GetImage(unsigned level, unsigned face,
+                            size_t& size) const;
+
+private:
+    CubemapBundleReader(const CubemapBundleReader&) = delete;
+    CubemapBundleReader& operator=(const CubemapBundleReader&) = delete;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    CubemapBundleHeader header_;
+    std::vector<CubemapBundleImage> images_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_CUBEMAP_BUNDLE_H_
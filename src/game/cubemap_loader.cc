@@ -0,0 +1,126 @@
+#include "game/cubemap_loader.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "glad/glad.h"
+#include "stb_image.h"
+
+#include "game/gl_counters.h"
+
+namespace tetris3d {
+
+CubemapLoader::CubemapLoader(const std::vector<std::string>& paths,
+                             unsigned environment_size)
+    : environment_size_(environment_size), pool_(paths.size()) {
+    for (const auto& path : paths) {
+        faces_.push_back(std::make_unique<Face>());
+        faces_.back()->path = path;
+    }
+    // NOTE: One worker per face; stb_image keeps no shared state while
+    // decoding, so faces decode fully in parallel
+    for (auto& face : faces_) {
+        pool_.Submit([this, face = face.get()] {
+            if (!cancelled_) {
+                Decode(*face);
+            }
+            face->decoded = true;
+        });
+    }
+}
+
+CubemapLoader::~CubemapLoader() {
+    cancelled_ = true;
+    pool_.Wait();
+    for (auto& face : faces_) {
+        stbi_image_free(face->pixels);
+    }
+}
+
+bool CubemapLoader::UploadNextFace(unsigned texture,
+                                   unsigned environment_texture) {
+    for (size_t i = 0; i < faces_.size(); ++i) {
+        if (!faces_[i]->uploaded && faces_[i]->decoded) {
+            Upload(i, texture, environment_texture);
+            break;
+        }
+    }
+    return IsDone();
+}
+
+void CubemapLoader::UploadAll(unsigned texture, unsigned environment_texture) {
+    pool_.Wait();
+    for (size_t i = 0; i < faces_.size(); ++i) {
+        if (!faces_[i]->uploaded) {
+            Upload(i, texture, environment_texture);
+        }
+    }
+}
+
+void CubemapLoader::Decode(Face& face) const {
+    face.pixels = stbi_load(face.path.c_str(), &face.width, &face.height,
+                            &face.channels, 0);
+    if (!face.pixels || !environment_size_) {
+        return;
+    }
+    // NOTE: Every environment texel is the average of the face texels it
+    // covers, so the small map is prefiltered rather than point sampled
+    auto size = environment_size_;
+    face.environment.resize(size * size * 3);
+    for (unsigned y = 0; y < size; ++y) {
+        auto begin_y = y * face.height / size;
+        auto end_y = std::max(begin_y + 1, (y + 1) * face.height / size);
+        for (unsigned x = 0; x < size; ++x) {
+            auto begin_x = x * face.width / size;
+            auto end_x = std::max(begin_x + 1, (x + 1) * face.width / size);
+            unsigned sums[3] = {0, 0, 0};
+            for (auto source_y = begin_y; source_y < end_y; ++source_y) {
+                auto row = face.pixels +
+                           static_cast<size_t>(source_y) * face.width *
+                               face.channels;
+                for (auto source_x = begin_x; source_x < end_x; ++source_x) {
+                    for (int channel = 0; channel < 3; ++channel) {
+                        sums[channel] +=
+                            row[source_x * face.channels +
+                                std::min(channel, face.channels - 1)];
+                    }
+                }
+            }
+            auto count = (end_x - begin_x) * (end_y - begin_y);
+            for (int channel = 0; channel < 3; ++channel) {
+                face.environment[(y * size + x) * 3 + channel] =
+                    (sums[channel] + count / 2) / count;
+            }
+        }
+    }
+}
+
+void CubemapLoader::Upload(size_t index, unsigned texture,
+                           unsigned environment_texture) {
+    auto& face = *faces_[index];
+    auto& counters = GLCounters::Get();
+    if (face.pixels) {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + index, 0, GL_RGB,
+                     face.width, face.height, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                     face.pixels);
+        counters.AddTextureSize(texture, face.width * face.height * 4);
+        stbi_image_free(face.pixels);
+        face.pixels = nullptr;
+        if (environment_size_) {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, environment_texture);
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + index, 0, GL_RGB,
+                         environment_size_, environment_size_, 0, GL_RGB,
+                         GL_UNSIGNED_BYTE, face.environment.data());
+            counters.AddTextureSize(environment_texture,
+                                    environment_size_ * environment_size_ * 4);
+            face.environment = {};
+        }
+    } else {
+        printf("Texuture load failure: %s\n", face.path.c_str());
+    }
+    face.uploaded = true;
+    ++uploaded_count_;
+}
+
+} // namespace tetris3d
@@ -0,0 +1,65 @@
+#ifndef TETRIS3D_GAME_CUBEMAP_LOADER_H_
+#define TETRIS3D_GAME_CUBEMAP_LOADER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace tetris3d {
+
+// Decodes cubemap face images on worker threads, so the GL thread only
+// uploads finished faces and never waits for image decoding
+class CubemapLoader {
+public:
+    // Starts decoding at once; face order: X, -X, Y, -Y, Z, -Z
+    // @environment_size faces of the environment cubemap are box filtered
+    // down to this size by the workers too; zero skips them
+    CubemapLoader(const std::vector<std::string>& paths,
+                  unsigned environment_size);
+    // NOTE: Faces not being decoded yet are skipped, so quitting during
+    // startup does not wait for the whole cubemap
+    ~CubemapLoader();
+
+    // Uploads at most one decoded face into the cubemap textures (level 0
+    // only), so upload cost is spread over frames; GL thread only
+    // @return true when all faces are uploaded
+    bool UploadNextFace(unsigned texture, unsigned environment_texture);
+    // Blocks until all faces are decoded and uploads the rest of them
+    void UploadAll(unsigned texture, unsigned environment_texture);
+
+    bool IsDone() const { return uploaded_count_ == faces_.size(); }
+
+private:
+    CubemapLoader(const CubemapLoader&) = delete;
+    CubemapLoader& operator=(const CubemapLoader&) = delete;
+
+    struct Face {
+        std::string path;
+        // Decoded by stb_image, null if decoding failed
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        // RGB, environment_size_ squared
+        std::vector<uint8_t> environment;
+        std::atomic<bool> decoded{false};
+        bool uploaded = false;
+    };
+
+    void Decode(Face& face) const;
+    void Upload(size_t index, unsigned texture, unsigned environment_texture);
+
+    unsigned environment_size_ = 0;
+    std::vector<std::unique_ptr<Face>> faces_;
+    size_t uploaded_count_ = 0;
+    std::atomic<bool> cancelled_{false};
+    // NOTE: Declared last, so workers are joined before faces are destroyed
+    ThreadPool pool_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_CUBEMAP_LOADER_H_
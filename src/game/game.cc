@@ -1,9 +1,14 @@
 #include "game/game.h"
 
+#include <cstdio>
+
+#include "game/performance_hud.h"
+
 namespace tetris3d {
 
 Game::Game(Config& config)
-    : config_(config), state_(config_), camera_controller_(config_) {}
+    : config_(config), state_(config_), camera_controller_(config_),
+      command_mapper_(config_) {}
 
 bool Game::StartUp() {
     if (config_.graphics_renderer_type == Config::RendererType::Basic) {
@@ -13,7 +18,51 @@ bool Game::StartUp() {
     }
     renderer_->StartUp(state_);
 
+    if (!config_.replay_play_path.empty()) {
+        replay_reader_.Open(config_.replay_play_path);
+        const auto& header = replay_reader_.GetHeader();
+        if (header.map_width != state_.board.GetWidth() ||
+            header.map_depth != state_.board.GetDepth() ||
+            header.map_height != state_.board.GetHeight()) {
+            throw Error("Replay board dimensions do not match config");
+        }
+        replay_tick_ = replay_reader_.LoadKeyframe(0, state_);
+    } else if (!config_.replay_record_path.empty()) {
+        replay_writer_.Open(config_.replay_record_path, config_);
+    }
+
+    if (!replay_reader_.IsOpen()) {
+        if (!config_.session_save_path.empty()) {
+            session_saver_.Open(config_.session_save_path);
+        }
+        if (!config_.quicksave_path.empty()) {
+            quicksave_saver_.Open(config_.quicksave_path);
+        }
+    }
+
+    if (!config_.observation_shm_name.empty()) {
+        observation_writer_.Open(config_.observation_shm_name, state_.board,
+                                 config_.observation_ring_slots);
+    }
+
+    if (config_.autoplay) {
+        bot_thread_pool_ =
+            std::make_unique<ThreadPool>(config_.autoplay_threads);
+        auto weights = BotWeights::FromConfig(config_);
+        if (config_.autoplay_bot == Config::BotType::BeamSearch) {
+            bot_ = std::make_unique<BeamSearchBot>(
+                weights, BeamSearchSettings::FromConfig(config_),
+                bot_thread_pool_.get());
+        } else {
+            bot_ = std::make_unique<HeuristicBot>(weights,
+                                                  bot_thread_pool_.get());
+        }
+    }
+
     CenterCamera(state_.camera);
+    if (!replay_reader_.IsOpen()) {
+        RestoreSession();
+    }
     state_.camera.SetAspectRatio(
         config_.graphics_resolution_width /
         static_cast<float>(config_.graphics_resolution_height));
@@ -27,245 +76,174 @@ void Game::OnFramebufferResize(int width, int height) {
 }
 
 void Game::Update(const Input& input, float elapsed_seconds) {
+    auto hud = renderer_->GetHud();
+    if (hud && input.IsKeyPressed(config_.key_toggle_hud)) {
+        hud->SetVisible(!hud->IsVisible());
+    }
+    auto start = std::chrono::steady_clock::now();
+    UpdateFrame(input, elapsed_seconds);
+    if (hud) {
+        hud->AddSimulationTime(std::chrono::duration<float>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count());
+    }
+}
+
+void Game::UpdateFrame(const Input& input, float elapsed_seconds) {
     if (input.IsKeyPressed(config_.key_camera_center)) {
         CenterCamera(state_.camera);
     }
 
     camera_controller_.Update(&state_.camera, input);
-    Update(state_, elapsed_seconds, input, state_.camera.GetForward());
-}
 
-void Game::CenterCamera(Camera& camera) {
-    camera.SetPosition(glm::vec3(2.5f * state_.board.GetWidth(),
-                                 state_.board.GetHeight() / 2.f,
-                                 2.5f * state_.board.GetDepth()));
-    camera.SetTarget(glm::vec3(state_.board.GetWidth() / 2.f,
-                               state_.board.GetHeight() / 2.f,
-                               state_.board.GetDepth() / 2.f));
-    camera.SetUp(glm::vec3(0.f, 1.f, 0.f));
-}
-
-bool Game::IsFinished() const { return state_.phase == GameState::Phase::Lost; }
-
-void Game::Draw() { renderer_->Render(state_, state_.camera); }
-
-void Game::Update(GameState& state, float elapsed_seconds, const Input& input,
-                  const glm::vec3& view_dir) {
-
-    if (input.IsKeyPressed(config_.key_pause)) {
-        state.paused = !state.paused;
-    }
-
-    if (state.phase == GameState::Phase::Lost || state.paused) {
+    if (replay_reader_.IsOpen()) {
+        UpdateReplay(input);
+        if (observation_writer_.IsOpen()) {
+            observation_writer_.Publish(state_);
+        }
         return;
     }
 
-    if (input.IsKeyPressed(config_.key_block_horiz_rot_clock)) {
-        if (view_dir.y < 0.f) {
-            state.falling_block.TryRotateYClockwiseWithFix(state.board);
-        } else {
-            state.falling_block.TryRotateYCounterClockwiseWithFix(state.board);
-        }
-    }
-    if (input.IsKeyPressed(config_.key_block_horiz_rot_counterclock)) {
-        if (view_dir.y < 0.f) {
-            state.falling_block.TryRotateYCounterClockwiseWithFix(state.board);
-        } else {
-            state.falling_block.TryRotateYClockwiseWithFix(state.board);
+    UpdateSessionSaves(input, elapsed_seconds);
+
+    if (bot_) {
+        commands_.Clear();
+        if (input.IsKeyPressed(config_.key_pause)) {
+            commands_.Push(GameCommand::TogglePause);
         }
+        bot_->Update(state_, elapsed_seconds,
+                     config_.autoplay_commands_per_second, commands_);
+    } else {
+        command_mapper_.Map(input, state_.camera.GetForward(), commands_);
     }
 
-    if (input.IsKeyPressed(config_.key_block_vert_rot_away)) {
-        auto view_dir_xz = view_dir;
-        view_dir_xz.y = 0.f;
-        view_dir_xz = glm::normalize(view_dir_xz);
-        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
-        if (glm::abs(dot) < glm::cos(glm::pi<float>() / 4.f)) {
-            if (view_dir.z < 0.f) {
-                state.falling_block.TryRotateXClockwiseWithFix(state.board);
-            } else {
-                state.falling_block.TryRotateXCounterClockwiseWithFix(
-                    state.board);
-            }
-        } else {
-            if (view_dir.x < 0.f) {
-                state.falling_block.TryRotateZCounterClockwiseWithFix(
-                    state.board);
-            } else {
-                state.falling_block.TryRotateZClockwiseWithFix(state.board);
-            }
-        }
+    if (replay_writer_.IsOpen()) {
+        ReplayFrame frame;
+        frame.elapsed_seconds = elapsed_seconds;
+        frame.commands = commands_;
+        replay_writer_.Record(state_, frame);
     }
 
-    if (input.IsKeyPressed(config_.key_block_vert_rot_towards)) {
-        auto view_dir_xz = view_dir;
-        view_dir_xz.y = 0.f;
-        view_dir_xz = glm::normalize(view_dir_xz);
-        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
-        if (glm::abs(dot) < glm::cos(glm::pi<float>() / 4.f)) {
-            if (view_dir.z > 0.f) {
-                state.falling_block.TryRotateXClockwiseWithFix(state.board);
-            } else {
-                state.falling_block.TryRotateXCounterClockwiseWithFix(
-                    state.board);
-            }
-        } else {
-            if (view_dir.x > 0.f) {
-                state.falling_block.TryRotateZCounterClockwiseWithFix(
-                    state.board);
-            } else {
-                state.falling_block.TryRotateZClockwiseWithFix(state.board);
-            }
-        }
+    Update(state_, elapsed_seconds, commands_);
+    if (observation_writer_.IsOpen()) {
+        observation_writer_.Publish(state_);
     }
 
-    if (input.IsKeyPressed(config_.key_block_move_away)) {
-        auto view_dir_xz = view_dir;
-        view_dir_xz.y = 0.f;
-        view_dir_xz = glm::normalize(view_dir_xz);
-        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
-        if (glm::abs(dot) < glm::cos(glm::pi<float>() / 4.f)) {
-            if (view_dir.z < 0.f) {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(0, 0, -1));
-            } else {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(0, 0, 1));
-            }
-        } else {
-            if (view_dir.x < 0.f) {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(-1, 0, 0));
-            } else {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(1, 0, 0));
-            }
+    // NOTE: Restart would break re-simulation of a recorded replay
+    if (bot_ && IsFinished() && !replay_writer_.IsOpen()) {
+        seconds_since_lost_ += elapsed_seconds;
+        if (seconds_since_lost_ > config_.autoplay_restart_delay_seconds) {
+            Restart();
         }
     }
+}
 
-    if (input.IsKeyPressed(config_.key_block_move_towards)) {
-        auto view_dir_xz = view_dir;
-        view_dir_xz.y = 0.f;
-        view_dir_xz = glm::normalize(view_dir_xz);
-        auto dot = glm::dot(glm::vec3(1.f, 0.f, 0.f), view_dir_xz);
-        if (glm::abs(dot) < glm::cos(glm::pi<float>() / 4.f)) {
-            if (view_dir.z > 0.f) {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(0, 0, -1));
-            } else {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(0, 0, 1));
-            }
-        } else {
-            if (view_dir.x > 0.f) {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(-1, 0, 0));
-            } else {
-                state.falling_block.TryTranslate(state.board,
-                                                 glm::ivec3(1, 0, 0));
-            }
-        }
+void Game::RestoreSession() {
+    // NOTE: Lost game is not worth resuming; new one starts instead
+    if (config_.session_save_path.empty()) {
+        return;
+    }
+    auto restored = state_;
+    if (LoadSession(config_.session_save_path, restored) &&
+        restored.phase != GameState::Phase::Lost) {
+        state_ = restored;
+        printf("Session restored from %s\n",
+               config_.session_save_path.c_str());
     }
+}
 
-    if (input.IsKeyDown(config_.key_block_accelerate)) {
-        state.block_current_speed = state.block_max_fall_step_seconds;
-        // NOTE(panmar): Let the fall pace change be immidiate
-        state.seconds_to_next_block_fall = std::min(
-            state.seconds_to_next_block_fall, state.block_current_speed);
-    } else {
-        state.block_current_speed = state.block_current_normal_speed;
+void Game::UpdateSessionSaves(const Input& input, float elapsed_seconds) {
+    if (input.IsKeyPressed(config_.key_quicksave)) {
+        quicksave_state_ = state_;
+        quicksave_pending_ = quicksave_saver_.IsOpen();
+    }
+    if (quicksave_pending_ && quicksave_saver_.Save(*quicksave_state_)) {
+        quicksave_pending_ = false;
     }
 
-    state.seconds_to_next_block_fall -= elapsed_seconds;
-    state.seconds_from_last_speed_inc -= elapsed_seconds;
-
-    // Game logic tick
-    if (state.seconds_to_next_block_fall < 0.f) {
-        SingleStep(state);
-        // NOTE(panmar): Reset next fall counter if we have been falling
-        // during this step; it is possible other action ocurred (block merging,
-        // layer disapper, etc.)
-        if (state.phase == GameState::Phase::BlockFalling) {
-            state.seconds_to_next_block_fall = state.block_current_speed;
+    // NOTE: Quickload would break re-simulation of a recorded replay
+    if (input.IsKeyPressed(config_.key_quickload) &&
+        !replay_writer_.IsOpen()) {
+        // NOTE: Saved camera may come from a window of other proportions
+        auto aspect_ratio = state_.camera.GetAspectRatio();
+        if (quicksave_state_) {
+            state_ = *quicksave_state_;
+        } else if (!config_.quicksave_path.empty()) {
+            LoadSession(config_.quicksave_path, state_);
         }
+        state_.camera.SetAspectRatio(aspect_ratio);
+        seconds_since_lost_ = 0.f;
     }
 
-    // Speed increase logic
-    if (state.seconds_from_last_speed_inc < 0.f) {
-        state.block_current_normal_speed += (state.block_speed_inc_multiplier *
-                                             state.block_current_normal_speed);
-        state.seconds_from_last_speed_inc =
-            state.block_speed_inc_period_seconds;
+    // NOTE: Skipped save (writer still busy) is retried next frame
+    seconds_since_session_save_ += elapsed_seconds;
+    if (session_saver_.IsOpen() &&
+        seconds_since_session_save_ >= config_.session_save_interval_seconds &&
+        session_saver_.Save(state_)) {
+        seconds_since_session_save_ = 0.f;
     }
+}
 
-    state.total_time += elapsed_seconds;
+void Game::Restart() {
+    auto camera = state_.camera;
+    auto random = state_.random;
+    state_ = GameState(config_);
+    state_.camera = camera;
+    state_.random = random;
+    seconds_since_lost_ = 0.f;
 }
 
-void Game::SingleStep(GameState& state) {
-    if (state.phase == GameState::Phase::Lost) {
-        return;
-    }
+void Game::CenterCamera(Camera& camera) {
+    camera.SetPosition(glm::vec3(2.5f * state_.board.GetWidth(),
+                                 state_.board.GetHeight() / 2.f,
+                                 2.5f * state_.board.GetDepth()));
+    camera.SetTarget(glm::vec3(state_.board.GetWidth() / 2.f,
+                               state_.board.GetHeight() / 2.f,
+                               state_.board.GetDepth() / 2.f));
+    camera.SetUp(glm::vec3(0.f, 1.f, 0.f));
+}
 
-    if (state.phase == GameState::Phase::Uninitialized) {
-        state.falling_block = Block::CreateRandom(state.board);
-        state.phase = GameState::Phase::NewBlockCreation;
-        return;
-    }
+bool Game::IsFinished() const { return state_.phase == GameState::Phase::Lost; }
 
-    if (state.phase == GameState::Phase::BlockMerge) {
-        if (state.board.EraseFilledLayers()) {
-            state.phase = GameState::Phase::LayersErase;
-            return;
-        }
-    }
+void Game::Draw() { renderer_->Render(state_, state_.camera); }
 
-    if (state.phase == GameState::Phase::BlockMerge ||
-        state.phase == GameState::Phase::LayersErase) {
-        state.falling_block = Block::CreateRandom(state.board);
-        state.phase = GameState::Phase::NewBlockCreation;
-        return;
+void Game::UpdateReplay(const Input& input) {
+    // NOTE: In playback live pause key pauses the replay itself; recorded
+    // pauses are part of the replayed simulation
+    if (input.IsKeyPressed(config_.key_pause)) {
+        replay_paused_ = !replay_paused_;
     }
 
-    if (!CanFallingBlockFall(state)) {
-        if (!state.falling_block.IsValid(state.board)) {
-            state.phase = GameState::Phase::Lost;
-            return;
-        }
-        MergeFallingBlock(state);
-        state.phase = GameState::Phase::BlockMerge;
-        return;
-    } else {
-        state.falling_block.Translate(glm::ivec3(0, -1, 0));
-        state.phase = GameState::Phase::BlockFalling;
-        return;
+    auto target_tick = replay_tick_;
+    auto seek_step = static_cast<uint64_t>(config_.replay_seek_step_ticks);
+    if (input.IsKeyDown(config_.key_replay_seek_backward)) {
+        target_tick = target_tick > seek_step ? target_tick - seek_step : 0;
+    } else if (input.IsKeyDown(config_.key_replay_seek_forward)) {
+        target_tick += seek_step;
+    } else if (!replay_paused_) {
+        ++target_tick;
     }
+
+    SeekReplay(std::min(target_tick, replay_reader_.GetTickCount()));
 }
 
-bool Game::CanFallingBlockFall(const GameState& state) {
-    for (auto& cube_offset : state.falling_block.GetCubeOffsets()) {
-        auto absolute_pos = state.falling_block.GetPosition() + cube_offset;
-        auto final_pos = absolute_pos - glm::ivec3(0, 1, 0);
-        // TODO(panmar): For now, do not consider starting position
-        if (final_pos.y >= 50)
-            continue;
-        if (final_pos.y < 0 || !state.board.IsEmpty(final_pos)) {
-            return false;
-        }
-    }
-    for (auto& cube_offset : state.falling_block.GetCubeOffsets()) {
-        auto absolute_pos = state.falling_block.GetPosition() + cube_offset;
-        auto final_pos = absolute_pos - glm::ivec3(0, -1, 0);
-        assert(final_pos.y >= 0);
+void Game::SeekReplay(uint64_t tick) {
+    if (tick == replay_tick_) {
+        return;
     }
 
-    return true;
-}
+    auto keyframe_interval = replay_reader_.GetHeader().keyframe_interval;
+    if (tick < replay_tick_ || tick - replay_tick_ > keyframe_interval) {
+        // NOTE: Keep the viewer camera; keyframe stores the recorded one
+        PerspectiveCamera camera = state_.camera;
+        replay_tick_ = replay_reader_.LoadKeyframe(tick, state_);
+        state_.camera = camera;
+    }
 
-void Game::MergeFallingBlock(GameState& state) {
-    for (auto& cube_offset : state.falling_block.GetCubeOffsets()) {
-        auto absolute_pos = state.falling_block.GetPosition() + cube_offset;
-        state.board.Fill(absolute_pos,
-                         PackColor(state.falling_block.GetColor()));
+    while (replay_tick_ < tick) {
+        auto frame = replay_reader_.GetFrame(replay_tick_);
+        Update(state_, frame.elapsed_seconds, frame.commands);
+        ++replay_tick_;
     }
 }
 
@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <memory>
+#include <optional>
 
 #include "game/camera.h"
 #include "glm/mat4x4.hpp"
@@ -9,7 +10,13 @@
 #include "input.h"
 #include "renderer.h"
 #include "config.h"
+#include "game/beam_search_bot.h"
+#include "game/bot.h"
 #include "game/camera_controller.h"
+#include "game/command.h"
+#include "game/observation_ring.h"
+#include "game/replay.h"
+#include "game/session_save.h"
 
 namespace tetris3d {
 
@@ -24,20 +31,58 @@ public:
     bool IsFinished() const;
     void Draw();
 
-private:
-    // Time-aware update
-    void Update(GameState& state, float elapsed_seconds, const Input& input,
-                const glm::vec3& view_dir);
+    // NOTE: Simulation works on a bare GameState, so it can be driven
+    // without a window (bots, replays, servers); see game_simulation.cc
+
+    // Time-aware update; applies the whole command batch in one pass
+    static void Update(GameState& state, float elapsed_seconds,
+                       const CommandBatch& commands);
+    static void ApplyCommand(GameState& state, GameCommand command);
 
     // Time-agnostic update
-    void SingleStep(GameState& state);
-    bool CanFallingBlockFall(const GameState& state);
-    void MergeFallingBlock(GameState& state);
+    static void SingleStep(GameState& state);
+    static bool CanFallingBlockFall(const GameState& state);
+    static void MergeFallingBlock(GameState& state);
+
+private:
+    // Input, bot and simulation of a frame
+    void UpdateFrame(const Input& input, float elapsed_seconds);
+
+    // Starts a new game keeping the camera and the random sequence going
+    void Restart();
+
+    // Replay playback; scrubbing seeks from the nearest keyframe
+    void UpdateReplay(const Input& input);
+    void SeekReplay(uint64_t tick);
+
+    // Restores session saved before the game was closed or crashed
+    void RestoreSession();
+    void UpdateSessionSaves(const Input& input, float elapsed_seconds);
 
     Config& config_;
     GameState state_;
     OrbitCameraController camera_controller_;
+    InputCommandMapper command_mapper_;
+    CommandBatch commands_;
     std::unique_ptr<IRenderer> renderer_;
+
+    std::unique_ptr<ThreadPool> bot_thread_pool_;
+    std::unique_ptr<Bot> bot_;
+    float seconds_since_lost_ = 0.f;
+
+    ReplayWriter replay_writer_;
+    ReplayReader replay_reader_;
+    uint64_t replay_tick_ = 0;
+    bool replay_paused_ = false;
+
+    ObservationRingWriter observation_writer_;
+
+    SessionSaver session_saver_;
+    float seconds_since_session_save_ = 0.f;
+    SessionSaver quicksave_saver_;
+    std::optional<GameState> quicksave_state_;
+    // Quicksave waits for the writer busy with the previous one
+    bool quicksave_pending_ = false;
 };
 
 } // namespace tetris3d
@@ -0,0 +1,156 @@
+// Simulation part of Game (static functions on a bare GameState); kept
+// apart from the windowed game, so it links without renderer, window or GL
+// (environment library, see Makefile)
+
+#include "game/game.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "profiler.h"
+
+namespace tetris3d {
+
+void Game::Update(GameState& state, float elapsed_seconds,
+                  const CommandBatch& commands) {
+    for (auto command : commands) {
+        if (command == GameCommand::TogglePause) {
+            state.paused = !state.paused;
+        }
+    }
+
+    if (state.phase == GameState::Phase::Lost || state.paused) {
+        return;
+    }
+
+    auto soft_drop = false;
+    for (auto command : commands) {
+        if (command == GameCommand::SoftDrop) {
+            soft_drop = true;
+        } else {
+            ApplyCommand(state, command);
+        }
+    }
+
+    if (soft_drop) {
+        state.block_current_speed = state.block_max_fall_step_seconds;
+        // NOTE(panmar): Let the fall pace change be immidiate
+        state.seconds_to_next_block_fall = std::min(
+            state.seconds_to_next_block_fall, state.block_current_speed);
+    } else {
+        state.block_current_speed = state.block_current_normal_speed;
+    }
+
+    state.seconds_to_next_block_fall -= elapsed_seconds;
+    state.seconds_from_last_speed_inc -= elapsed_seconds;
+
+    // Game logic tick
+    if (state.seconds_to_next_block_fall < 0.f) {
+        SingleStep(state);
+        // NOTE(panmar): Reset next fall counter if we have been falling
+        // during this step; it is possible other action ocurred (block merging,
+        // layer disapper, etc.)
+        if (state.phase == GameState::Phase::BlockFalling) {
+            state.seconds_to_next_block_fall = state.block_current_speed;
+        }
+    }
+
+    // Speed increase logic
+    if (state.seconds_from_last_speed_inc < 0.f) {
+        state.block_current_normal_speed += (state.block_speed_inc_multiplier *
+                                             state.block_current_normal_speed);
+        state.seconds_from_last_speed_inc =
+            state.block_speed_inc_period_seconds;
+    }
+
+    state.total_time += elapsed_seconds;
+}
+
+void Game::ApplyCommand(GameState& state, GameCommand command) {
+    auto& block = state.falling_block;
+    if (command != GameCommand::HardDrop) {
+        ApplyBlockCommand(block, state.board, command);
+        return;
+    }
+
+    if (state.phase == GameState::Phase::NewBlockCreation ||
+        state.phase == GameState::Phase::BlockFalling) {
+        while (block.TryTranslate(state.board, glm::ivec3(0, -1, 0))) {
+        }
+        // NOTE: Let the merge happen during this frame logic tick
+        state.seconds_to_next_block_fall = 0.f;
+    }
+}
+
+void Game::SingleStep(GameState& state) {
+    ProfileScope scope("Game::SingleStep");
+    if (state.phase == GameState::Phase::Lost) {
+        return;
+    }
+
+    if (state.phase == GameState::Phase::Uninitialized) {
+        state.falling_block = Block::CreateRandom(state.board, state.random);
+        state.phase = GameState::Phase::NewBlockCreation;
+        return;
+    }
+
+    if (state.phase == GameState::Phase::BlockMerge) {
+        if (auto erased_layers = state.board.EraseFilledLayers()) {
+            state.erased_layers += erased_layers;
+            state.phase = GameState::Phase::LayersErase;
+            return;
+        }
+    }
+
+    if (state.phase == GameState::Phase::BlockMerge ||
+        state.phase == GameState::Phase::LayersErase) {
+        state.falling_block = Block::CreateRandom(state.board, state.random);
+        state.phase = GameState::Phase::NewBlockCreation;
+        return;
+    }
+
+    if (!CanFallingBlockFall(state)) {
+        if (!state.falling_block.IsValid(state.board)) {
+            state.phase = GameState::Phase::Lost;
+            return;
+        }
+        MergeFallingBlock(state);
+        state.phase = GameState::Phase::BlockMerge;
+        return;
+    } else {
+        state.falling_block.Translate(glm::ivec3(0, -1, 0));
+        state.phase = GameState::Phase::BlockFalling;
+        return;
+    }
+}
+
+bool Game::CanFallingBlockFall(const GameState& state) {
+    for (auto& cube_offset : state.falling_block.GetCubeOffsets()) {
+        auto absolute_pos = state.falling_block.GetPosition() + cube_offset;
+        auto final_pos = absolute_pos - glm::ivec3(0, 1, 0);
+        // NOTE: Cubes above the board (rotated out of its top) cannot hit
+        // anything
+        if (final_pos.y >= state.board.GetHeight())
+            continue;
+        if (final_pos.y < 0 || !state.board.IsEmpty(final_pos)) {
+            return false;
+        }
+    }
+    for (auto& cube_offset : state.falling_block.GetCubeOffsets()) {
+        auto absolute_pos = state.falling_block.GetPosition() + cube_offset;
+        auto final_pos = absolute_pos - glm::ivec3(0, -1, 0);
+        assert(final_pos.y >= 0);
+    }
+
+    return true;
+}
+
+void Game::MergeFallingBlock(GameState& state) {
+    for (auto& cube_offset : state.falling_block.GetCubeOffsets()) {
+        auto absolute_pos = state.falling_block.GetPosition() + cube_offset;
+        state.board.Fill(absolute_pos,
+                         PackColor(state.falling_block.GetColor()));
+    }
+}
+
+} // namespace tetris3d
@@ -0,0 +1,53 @@
+#include "game/gl_counters.h"
+
+namespace tetris3d {
+
+GLCounters& GLCounters::Get() {
+    static GLCounters counters;
+    return counters;
+}
+
+void GLCounters::BeginFrame() {
+    buffer_uploads_ = 0;
+    buffer_upload_bytes_ = 0;
+}
+
+void GLCounters::CountBufferUpload(size_t bytes) {
+    ++buffer_uploads_;
+    buffer_upload_bytes_ += bytes;
+}
+
+void GLCounters::SetBufferSize(unsigned buffer, size_t bytes) {
+    auto& size = buffer_sizes_[buffer];
+    buffer_memory_ += bytes;
+    buffer_memory_ -= size;
+    size = bytes;
+}
+
+void GLCounters::RemoveBuffer(unsigned buffer) {
+    auto it = buffer_sizes_.find(buffer);
+    if (it != buffer_sizes_.end()) {
+        buffer_memory_ -= it->second;
+        buffer_sizes_.erase(it);
+    }
+}
+
+void GLCounters::AddTextureSize(unsigned texture, size_t bytes) {
+    texture_sizes_[texture] += bytes;
+    texture_memory_ += bytes;
+}
+
+size_t GLCounters::GetTextureSize(unsigned texture) const {
+    auto it = texture_sizes_.find(texture);
+    return it != texture_sizes_.end() ? it->second : 0;
+}
+
+void GLCounters::RemoveTexture(unsigned texture) {
+    auto it = texture_sizes_.find(texture);
+    if (it != texture_sizes_.end()) {
+        texture_memory_ -= it->second;
+        texture_sizes_.erase(it);
+    }
+}
+
+} // namespace tetris3d
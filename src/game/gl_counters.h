@@ -0,0 +1,55 @@
+#ifndef TETRIS3D_GAME_GL_COUNTERS_H_
+#define TETRIS3D_GAME_GL_COUNTERS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+namespace tetris3d {
+
+// Buffer uploads of the current frame and GPU memory held by buffers and
+// textures, counted next to the GL calls that cause them (GL itself can
+// report memory use through vendor extensions only)
+// NOTE: Memory is an estimate of what was specified; RGB textures count as
+// RGBA, which is how drivers store them
+// NOTE: GL thread only
+class GLCounters {
+public:
+    // The process-wide counters; renderers and loaders count into them
+    static GLCounters& Get();
+
+    // Zeroes counters of the current frame
+    void BeginFrame();
+
+    // Data sent to a buffer (glBufferData with data, glBufferSubData)
+    void CountBufferUpload(size_t bytes);
+    // Store of the buffer was (re)specified by glBufferData
+    void SetBufferSize(unsigned buffer, size_t bytes);
+    void RemoveBuffer(unsigned buffer);
+
+    // Image (level, face) of the texture was specified
+    void AddTextureSize(unsigned texture, size_t bytes);
+    size_t GetTextureSize(unsigned texture) const;
+    void RemoveTexture(unsigned texture);
+
+    unsigned GetBufferUploads() const { return buffer_uploads_; }
+    uint64_t GetBufferUploadBytes() const { return buffer_upload_bytes_; }
+    uint64_t GetBufferMemory() const { return buffer_memory_; }
+    uint64_t GetTextureMemory() const { return texture_memory_; }
+
+private:
+    GLCounters() = default;
+    GLCounters(const GLCounters&) = delete;
+    GLCounters& operator=(const GLCounters&) = delete;
+
+    unsigned buffer_uploads_ = 0;
+    uint64_t buffer_upload_bytes_ = 0;
+    uint64_t buffer_memory_ = 0;
+    uint64_t texture_memory_ = 0;
+    std::unordered_map<unsigned, size_t> buffer_sizes_;
+    std::unordered_map<unsigned, size_t> texture_sizes_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_GL_COUNTERS_H_
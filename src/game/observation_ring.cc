@@ -0,0 +1,271 @@
+#include "game/observation_ring.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "game/board.h"
+
+namespace {
+
+// Distance the block would fall if dropped now
+int GetDropDistance(const tetris3d::Board& board,
+                    const tetris3d::Block& block) {
+    for (int distance = 0;; ++distance) {
+        for (const auto& offset : block.GetCubeOffsets()) {
+            auto cell = block.GetPosition() + offset;
+            cell.y -= distance + 1;
+            if (cell.y < 0 ||
+                (cell.y < board.GetHeight() && !board.IsEmpty(cell))) {
+                return distance;
+            }
+        }
+    }
+}
+
+// Maps packed colors to small palette ids; id 0 stands for empty cell
+// NOTE: Open addressing table, twice the palette size, cleared every frame
+class PaletteBuilder {
+public:
+    explicit PaletteBuilder(tetris3d::ObservationFrame& frame)
+        : frame_(frame) {
+        frame_.palette_size = 1;
+        frame_.palette[0] = 0;
+    }
+
+    uint8_t GetId(uint32_t color) {
+        auto slot = (color * 2654435761u) % kTableSize;
+        while (ids_[slot]) {
+            if (colors_[slot] == color) {
+                return ids_[slot];
+            }
+            slot = (slot + 1) % kTableSize;
+        }
+        // NOTE: Colors beyond the palette size share the last id
+        if (frame_.palette_size == kMaxId) {
+            return kMaxId;
+        }
+        auto id = frame_.palette_size++;
+        frame_.palette[id] = color;
+        colors_[slot] = color;
+        ids_[slot] = id;
+        return id;
+    }
+
+private:
+    static inline constexpr uint32_t kMaxId = 255;
+    static inline constexpr uint32_t kTableSize =
+        2 * tetris3d::ObservationFrame::kMaxPaletteSize;
+
+    tetris3d::ObservationFrame& frame_;
+    uint32_t colors_[kTableSize];
+    uint8_t ids_[kTableSize] = {};
+};
+
+} // namespace
+
+namespace tetris3d {
+
+ObservationRingWriter::~ObservationRingWriter() { Close(); }
+
+void ObservationRingWriter::Open(const std::string& name, const Board& board,
+                                 uint32_t slot_count) {
+    Close();
+
+    if (board.GetWidth() > ObservationFrame::kMaxWidth ||
+        board.GetDepth() > ObservationFrame::kMaxDepth ||
+        board.GetHeight() > ObservationFrame::kMaxHeight) {
+        throw Error("Board is too large for observation frames");
+    }
+    if (slot_count == 0) {
+        throw Error("Observation ring needs at least one slot");
+    }
+
+    // NOTE: Readers still mapping a previous object keep it alive; new
+    // readers always get a freshly initialized one
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        throw Error("Cannot create shared memory object: " + name);
+    }
+    size_ = sizeof(ObservationRingHeader) +
+            slot_count * sizeof(ObservationSlot);
+    void* data = MAP_FAILED;
+    if (ftruncate(fd, size_) == 0) {
+        data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw Error("Cannot map shared memory object: " + name);
+    }
+    name_ = name;
+
+    slots_ = reinterpret_cast<ObservationSlot*>(
+        static_cast<uint8_t*>(data) + sizeof(ObservationRingHeader));
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        new (&slots_[i]) ObservationSlot();
+    }
+    header_ = new (data) ObservationRingHeader();
+    header_->slot_count = slot_count;
+    header_->map_width = board.GetWidth();
+    header_->map_depth = board.GetDepth();
+    header_->map_height = board.GetHeight();
+}
+
+void ObservationRingWriter::Close() {
+    if (header_) {
+        munmap(header_, size_);
+        shm_unlink(name_.c_str());
+    }
+    header_ = nullptr;
+    slots_ = nullptr;
+    size_ = 0;
+}
+
+void ObservationRingWriter::Publish(const GameState& state) {
+    auto tick = header_->frame_count.load(std::memory_order_relaxed);
+
+    auto& frame = frame_;
+    frame.tick = tick;
+    frame.phase = static_cast<uint8_t>(state.phase);
+    frame.paused = state.paused;
+    frame.erased_layers = state.erased_layers;
+    frame.total_time = state.total_time;
+    frame.seconds_to_next_block_fall = state.seconds_to_next_block_fall;
+    frame.block_current_speed = state.block_current_speed;
+    frame.block_current_normal_speed = state.block_current_normal_speed;
+
+    const auto& board = state.board;
+    const auto& block = state.falling_block;
+    frame.block_type = static_cast<uint8_t>(block.GetType());
+    frame.block_cell_count = block.GetCubeOffsets().size();
+    frame.ghost_offset_y = 0;
+    std::memset(frame.block_cells, -1, sizeof(frame.block_cells));
+    std::memset(frame.ghost_cells, -1, sizeof(frame.ghost_cells));
+    if (frame.block_cell_count) {
+        frame.ghost_offset_y = -GetDropDistance(board, block);
+    }
+    for (int i = 0; i < frame.block_cell_count; ++i) {
+        auto cell = block.GetPosition() + block.GetCubeOffsets()[i];
+        frame.block_cells[i][0] = cell.x;
+        frame.block_cells[i][1] = cell.y;
+        frame.block_cells[i][2] = cell.z;
+        frame.ghost_cells[i][0] = cell.x;
+        frame.ghost_cells[i][1] = cell.y + frame.ghost_offset_y;
+        frame.ghost_cells[i][2] = cell.z;
+    }
+
+    std::memset(frame.occupancy, 0, sizeof(frame.occupancy));
+    std::memset(frame.palette_ids, 0, sizeof(frame.palette_ids));
+    PaletteBuilder palette(frame);
+    const auto& cells = board.GetCells();
+    for (int y = 0; y < board.GetHeight(); ++y) {
+        for (int x = 0; x < board.GetWidth(); ++x) {
+            for (int z = 0; z < board.GetDepth(); ++z) {
+                auto cell = cells[board.PositionToIndex(glm::vec3(x, y, z))];
+                if (!cell) {
+                    continue;
+                }
+                auto bit = x * ObservationFrame::kMaxDepth + z;
+                frame.occupancy[y][bit / 64] |= uint64_t(1) << (bit % 64);
+                frame.palette_ids[y][x][z] = palette.GetId(cell);
+            }
+        }
+    }
+
+    auto& slot = slots_[tick % header_->slot_count];
+    auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.frame, &frame, sizeof(frame));
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    header_->frame_count.store(tick + 1, std::memory_order_release);
+}
+
+ObservationRingReader::~ObservationRingReader() { Close(); }
+
+void ObservationRingReader::Open(const std::string& name) {
+    Close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw Error("Cannot open shared memory object: " + name);
+    }
+    struct stat object_stat;
+    if (fstat(fd, &object_stat) != 0 ||
+        static_cast<size_t>(object_stat.st_size) <
+            sizeof(ObservationRingHeader)) {
+        close(fd);
+        throw Error("Shared memory object is truncated: " + name);
+    }
+    size_ = object_stat.st_size;
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw Error("Cannot map shared memory object: " + name);
+    }
+    header_ = static_cast<const ObservationRingHeader*>(data);
+    slots_ = reinterpret_cast<const ObservationSlot*>(
+        static_cast<const uint8_t*>(data) + sizeof(ObservationRingHeader));
+
+    ObservationRingHeader expected;
+    if (std::memcmp(header_->magic, expected.magic, 4) != 0 ||
+        header_->version != expected.version ||
+        header_->slot_size != expected.slot_size ||
+        header_->slot_count == 0 ||
+        size_ < sizeof(ObservationRingHeader) +
+                    header_->slot_count * sizeof(ObservationSlot)) {
+        Close();
+        throw Error("Shared memory object is not an observation ring: " +
+                    name);
+    }
+}
+
+void ObservationRingReader::Close() {
+    if (header_) {
+        munmap(const_cast<ObservationRingHeader*>(header_), size_);
+    }
+    header_ = nullptr;
+    slots_ = nullptr;
+    size_ = 0;
+}
+
+bool ObservationRingReader::ReadLatest(ObservationFrame& frame) const {
+    // NOTE: Retry only if the writer lapped the whole ring during the copy
+    constexpr int kMaxAttempts = 8;
+    for (int i = 0; i < kMaxAttempts; ++i) {
+        auto frame_count = header_->frame_count.load(std::memory_order_acquire);
+        if (frame_count == 0) {
+            return false;
+        }
+        if (Read(frame_count - 1, frame)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ObservationRingReader::Read(uint64_t tick,
+                                 ObservationFrame& frame) const {
+    auto frame_count = header_->frame_count.load(std::memory_order_acquire);
+    if (tick >= frame_count || frame_count - tick > header_->slot_count) {
+        return false;
+    }
+
+    const auto& slot = slots_[tick % header_->slot_count];
+    auto sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+        return false;
+    }
+    std::memcpy(&frame, &slot.frame, sizeof(frame));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == sequence &&
+           frame.tick == tick;
+}
+
+} // namespace tetris3d
@@ -0,0 +1,134 @@
+#ifndef TETRIS3D_GAME_OBSERVATION_RING_H_
+#define TETRIS3D_GAME_OBSERVATION_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "game/block.h"
+#include "game/state.h"
+
+namespace tetris3d {
+
+// Shared memory layout (fixed, so any process can read it without linking
+// the game):
+// ----
+// ObservationRingHeader
+// ObservationSlot[slot_count]
+// ----
+// Frame of tick t lives in slot t % slot_count
+// NOTE: Every slot is guarded by a sequence number (seqlock): writer makes it
+// odd, writes the frame and makes it even again; reader copies the frame and
+// accepts it only if the sequence was the same even number before and after
+// the copy. Writer never waits for readers, readers only need read access.
+struct ObservationFrame {
+    static inline constexpr int kMaxWidth = 16;
+    static inline constexpr int kMaxDepth = 16;
+    static inline constexpr int kMaxHeight = 32;
+    static inline constexpr int kLayerWords = kMaxWidth * kMaxDepth / 64;
+    static inline constexpr int kMaxPaletteSize = 256;
+
+    uint64_t tick = 0;
+
+    uint8_t phase = 0; // GameState::Phase
+    uint8_t paused = 0;
+    uint8_t block_type = 0; // BlockType
+    uint8_t block_cell_count = 0;
+    uint32_t erased_layers = 0;
+
+    float total_time = 0.f;
+    float seconds_to_next_block_fall = 0.f;
+    float block_current_speed = 0.f;
+    float block_current_normal_speed = 0.f;
+
+    // World positions of falling block cubes (x, y, z)
+    int8_t block_cells[Block::kMaxCubes][3] = {};
+    // Where the falling block would land if dropped now
+    int8_t ghost_cells[Block::kMaxCubes][3] = {};
+    int8_t ghost_offset_y = 0;
+    uint8_t palette_size = 0;
+    uint8_t reserved[6] = {};
+
+    // Packed 0x00RRGGBB colors referenced by palette ids
+    uint32_t palette[kMaxPaletteSize] = {};
+    // Bit (x * kMaxDepth + z) of layer y is set if the cell is taken
+    uint64_t occupancy[kMaxHeight][kLayerWords] = {};
+    // Palette id of every taken cell (zero for empty ones)
+    uint8_t palette_ids[kMaxHeight][kMaxWidth][kMaxDepth] = {};
+};
+
+struct alignas(64) ObservationSlot {
+    std::atomic<uint64_t> sequence{0};
+    ObservationFrame frame;
+};
+
+struct alignas(64) ObservationRingHeader {
+    char magic[4] = {'T', '3', 'D', 'O'};
+    uint32_t version = 1;
+    uint32_t slot_count = 0;
+    uint32_t slot_size = sizeof(ObservationSlot);
+    int32_t map_width = 0;
+    int32_t map_depth = 0;
+    int32_t map_height = 0;
+    // Number of published frames; the latest one has tick frame_count - 1
+    alignas(64) std::atomic<uint64_t> frame_count{0};
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+// Publishes a frame of the game state every tick into a POSIX shared memory
+// object; the object is removed when the writer is closed
+class ObservationRingWriter {
+public:
+    ObservationRingWriter() = default;
+    ~ObservationRingWriter();
+
+    // @name shared memory object name, e.g. "/tetris3d"
+    void Open(const std::string& name, const Board& board,
+              uint32_t slot_count);
+    bool IsOpen() const { return header_ != nullptr; }
+    void Close();
+
+    void Publish(const GameState& state);
+
+private:
+    ObservationRingWriter(const ObservationRingWriter&) = delete;
+    ObservationRingWriter& operator=(const ObservationRingWriter&) = delete;
+
+    std::string name_;
+    ObservationRingHeader* header_ = nullptr;
+    ObservationSlot* slots_ = nullptr;
+    size_t size_ = 0;
+    // NOTE: Frame is built here first, so the seqlock is held only for a copy
+    ObservationFrame frame_;
+};
+
+// Maps the ring read-only; for consumers written in C++
+class ObservationRingReader {
+public:
+    ObservationRingReader() = default;
+    ~ObservationRingReader();
+
+    void Open(const std::string& name);
+    bool IsOpen() const { return header_ != nullptr; }
+    void Close();
+
+    const ObservationRingHeader& GetHeader() const { return *header_; }
+
+    // Copies the latest frame; returns false if there is none yet
+    bool ReadLatest(ObservationFrame& frame) const;
+    // Returns false if the frame was not published yet or was overwritten
+    bool Read(uint64_t tick, ObservationFrame& frame) const;
+
+private:
+    ObservationRingReader(const ObservationRingReader&) = delete;
+    ObservationRingReader& operator=(const ObservationRingReader&) = delete;
+
+    const ObservationRingHeader* header_ = nullptr;
+    const ObservationSlot* slots_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_OBSERVATION_RING_H_
@@ -0,0 +1,393 @@
+#include "game/performance_hud.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+#include "game/gl_counters.h"
+
+namespace tetris3d {
+namespace {
+
+const std::string hud_vs = R"~(
+#version 330 core
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 tex_coords;
+layout (location = 2) in vec4 color;
+
+uniform vec2 screen_size;
+
+out vec2 atlas_coords;
+out vec4 vertex_color;
+
+void main() {
+    gl_Position = vec4(position.x / screen_size.x * 2.0 - 1.0,
+                       1.0 - position.y / screen_size.y * 2.0, 0.0, 1.0);
+    atlas_coords = tex_coords;
+    vertex_color = color;
+}
+
+)~";
+
+const std::string hud_fs = R"~(
+#version 330 core
+in vec2 atlas_coords;
+in vec4 vertex_color;
+out vec4 final_color;
+
+uniform sampler2D atlas;
+
+void main() {
+    final_color = vec4(vertex_color.rgb,
+                       vertex_color.a * texture(atlas, atlas_coords).r);
+}
+
+)~";
+
+struct Glyph {
+    char character;
+    // Rows from the top; '1' is a lit pixel
+    const char* rows[5];
+};
+
+constexpr Glyph kFont[] = {
+    {'0', {"111", "101", "101", "101", "111"}},
+    {'1', {"010", "110", "010", "010", "111"}},
+    {'2', {"111", "001", "111", "100", "111"}},
+    {'3', {"111", "001", "111", "001", "111"}},
+    {'4', {"101", "101", "111", "001", "001"}},
+    {'5', {"111", "100", "111", "001", "111"}},
+    {'6', {"111", "100", "111", "101", "111"}},
+    {'7', {"111", "001", "001", "001", "001"}},
+    {'8', {"111", "101", "111", "101", "111"}},
+    {'9', {"111", "101", "111", "001", "111"}},
+    {'A', {"010", "101", "111", "101", "101"}},
+    {'B', {"110", "101", "110", "101", "110"}},
+    {'C', {"011", "100", "100", "100", "011"}},
+    {'D', {"110", "101", "101", "101", "110"}},
+    {'E', {"111", "100", "110", "100", "111"}},
+    {'F', {"111", "100", "110", "100", "100"}},
+    {'G', {"011", "100", "101", "101", "011"}},
+    {'H', {"101", "101", "111", "101", "101"}},
+    {'I', {"111", "010", "010", "010", "111"}},
+    {'J', {"001", "001", "001", "101", "010"}},
+    {'K', {"101", "101", "110", "101", "101"}},
+    {'L', {"100", "100", "100", "100", "111"}},
+    {'M', {"101", "111", "111", "101", "101"}},
+    {'N', {"110", "101", "101", "101", "101"}},
+    {'O', {"010", "101", "101", "101", "010"}},
+    {'P', {"110", "101", "110", "100", "100"}},
+    {'Q', {"010", "101", "101", "110", "011"}},
+    {'R', {"110", "101", "110", "101", "101"}},
+    {'S', {"011", "100", "010", "001", "110"}},
+    {'T', {"111", "010", "010", "010", "010"}},
+    {'U', {"101", "101", "101", "101", "111"}},
+    {'V', {"101", "101", "101", "101", "010"}},
+    {'W', {"101", "101", "111", "111", "101"}},
+    {'X', {"101", "101", "010", "101", "101"}},
+    {'Y', {"101", "101", "010", "010", "010"}},
+    {'Z', {"111", "001", "010", "100", "111"}},
+    {'.', {"000", "000", "000", "000", "010"}},
+    {',', {"000", "000", "000", "010", "100"}},
+    {':', {"000", "010", "000", "010", "000"}},
+    {'/', {"001", "001", "010", "100", "100"}},
+    {'%', {"101", "001", "010", "100", "101"}},
+    {'-', {"000", "000", "111", "000", "000"}},
+    {'(', {"010", "100", "100", "100", "010"}},
+    {')', {"010", "001", "001", "001", "010"}},
+};
+
+// Atlas is a single row of cells; glyph pixels are at the top left of a
+// cell, the rest is spacing
+constexpr unsigned kGlyphWidth = 3;
+constexpr unsigned kGlyphHeight = 5;
+constexpr unsigned kCellWidth = 4;
+constexpr unsigned kCellHeight = 6;
+// Cell 0 is blank (space, unknown characters); the last cell is solid, for
+// quads without text
+constexpr unsigned kCellCount = std::size(kFont) + 2;
+constexpr unsigned kSolidCell = kCellCount - 1;
+
+// Screen pixels per font pixel
+constexpr float kFontScale = 2.f;
+constexpr float kLineHeight = (kGlyphHeight + 2) * kFontScale;
+constexpr float kPadding = 8.f;
+
+// Graph spans two 60 Hz frames; bars above the budget line missed vsync
+constexpr float kGraphBarWidth = 2.f;
+constexpr float kGraphHeight = 64.f;
+constexpr float kGraphBudgetMs = 1000.f / 60.f;
+constexpr float kGraphMaxMs = 2.f * kGraphBudgetMs;
+
+const uint8_t kPanelColor[4] = {0, 0, 0, 170};
+const uint8_t kTextColor[4] = {235, 235, 235, 255};
+const uint8_t kFrameColor[4] = {90, 200, 90, 255};
+const uint8_t kSlowFrameColor[4] = {230, 80, 60, 255};
+const uint8_t kSimulationColor[4] = {70, 160, 240, 255};
+const uint8_t kBudgetColor[4] = {255, 255, 255, 110};
+
+template <typename Vertex>
+void AppendRect(std::vector<Vertex>& vertices, float x, float y, float width,
+                float height, float u0, float v0, float u1, float v1,
+                const uint8_t color[4]) {
+    Vertex vertex;
+    std::copy(color, color + 4, vertex.color);
+    const float corners[6][4] = {
+        {x, y, u0, v0},
+        {x, y + height, u0, v1},
+        {x + width, y + height, u1, v1},
+        {x, y, u0, v0},
+        {x + width, y + height, u1, v1},
+        {x + width, y, u1, v0},
+    };
+    for (const auto& corner : corners) {
+        vertex.position = glm::vec2(corner[0], corner[1]);
+        vertex.tex_coords = glm::vec2(corner[2], corner[3]);
+        vertices.push_back(vertex);
+    }
+}
+
+void FormatBytes(char* text, size_t size, uint64_t bytes) {
+    if (bytes < 1024) {
+        snprintf(text, size, "%u B", static_cast<unsigned>(bytes));
+    } else if (bytes < 1024 * 1024) {
+        snprintf(text, size, "%.1f KB", bytes / 1024.0);
+    } else {
+        snprintf(text, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+    }
+}
+
+float GetMilliseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+} // namespace
+
+PerformanceHud::~PerformanceHud() {
+    if (vbo_) {
+        glDeleteBuffers(1, &vbo_);
+        GLCounters::Get().RemoveBuffer(vbo_);
+    }
+    if (vao_) {
+        glDeleteVertexArrays(1, &vao_);
+    }
+    if (atlas_) {
+        glDeleteTextures(1, &atlas_);
+        GLCounters::Get().RemoveTexture(atlas_);
+    }
+}
+
+void PerformanceHud::Create() {
+    shader_.Create(hud_vs, hud_fs);
+    screen_size_uniform_ = shader_.GetUniform<glm::vec2>("screen_size");
+    shader_.Bind();
+    shader_.SetParam("atlas", 0);
+    CreateAtlas();
+
+    glGenVertexArrays(1, &vao_);
+    glBindVertexArray(vao_);
+    glGenBuffers(1, &vbo_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, false, sizeof(Vertex),
+                          (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, false, sizeof(Vertex),
+                          (void*)offsetof(Vertex, tex_coords));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, true, sizeof(Vertex),
+                          (void*)offsetof(Vertex, color));
+    glBindVertexArray(0);
+
+    frame_allocations_ = GetAllocationStats();
+}
+
+void PerformanceHud::CreateAtlas() {
+    atlas_width_ = kCellCount * kCellWidth;
+    std::vector<uint8_t> pixels(atlas_width_ * kCellHeight, 0);
+    for (unsigned i = 0; i < std::size(kFont); ++i) {
+        const auto& glyph = kFont[i];
+        auto cell = i + 1;
+        glyph_cells_[static_cast<uint8_t>(glyph.character)] = cell;
+        for (unsigned y = 0; y < kGlyphHeight; ++y) {
+            for (unsigned x = 0; x < kGlyphWidth; ++x) {
+                if (glyph.rows[y][x] == '1') {
+                    pixels[y * atlas_width_ + cell * kCellWidth + x] = 255;
+                }
+            }
+        }
+    }
+    for (unsigned y = 0; y < kCellHeight; ++y) {
+        std::fill_n(&pixels[y * atlas_width_ + kSolidCell * kCellWidth],
+                    kCellWidth, 255);
+    }
+
+    // NOTE: Rows are a multiple of 4 bytes wide, as default unpack
+    // alignment expects
+    glGenTextures(1, &atlas_);
+    glBindTexture(GL_TEXTURE_2D, atlas_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas_width_, kCellHeight, 0,
+                 GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GLCounters::Get().AddTextureSize(atlas_, pixels.size());
+}
+
+void PerformanceHud::AddSimulationTime(float seconds) {
+    simulation_seconds_ += seconds;
+}
+
+void PerformanceHud::BeginFrame() {
+    auto now = std::chrono::steady_clock::now();
+    auto allocations = GetAllocationStats();
+    if (has_frame_start_) {
+        frame_ms_ = GetMilliseconds(now - frame_start_);
+        simulation_ms_ = simulation_seconds_ * 1000.f;
+        allocation_count_ = allocations.count - frame_allocations_.count;
+        allocation_bytes_ = allocations.bytes - frame_allocations_.bytes;
+        frame_history_ms_[history_next_] = frame_ms_;
+        simulation_history_ms_[history_next_] = simulation_ms_;
+        history_next_ = (history_next_ + 1) % kHistorySize;
+        history_count_ = std::min(history_count_ + 1, kHistorySize);
+    }
+    frame_start_ = now;
+    has_frame_start_ = true;
+    frame_allocations_ = allocations;
+    simulation_seconds_ = 0.f;
+}
+
+void PerformanceHud::Draw(int width, int height, const RenderStats& stats) {
+    if (!visible_ || width <= 0 || height <= 0) {
+        return;
+    }
+    auto render_ms =
+        GetMilliseconds(std::chrono::steady_clock::now() - frame_start_);
+    const auto& counters = GLCounters::Get();
+
+    auto average_ms = 0.f;
+    auto max_ms = 0.f;
+    for (unsigned i = 0; i < history_count_; ++i) {
+        average_ms += frame_history_ms_[i];
+        max_ms = std::max(max_ms, frame_history_ms_[i]);
+    }
+    average_ms /= std::max(history_count_, 1u);
+
+    // NOTE: Text goes to fixed buffers and vertices_ keeps its capacity, so
+    // a visible HUD does not allocate per frame
+    char lines[6][64];
+    char bytes[2][16];
+    snprintf(lines[0], sizeof(lines[0]), "FRAME %5.1f MS AVG %5.1f MAX %5.1f",
+             frame_ms_, average_ms, max_ms);
+    snprintf(lines[1], sizeof(lines[1]), "SIM %5.2f MS RENDER %5.2f MS",
+             simulation_ms_, render_ms);
+    snprintf(lines[2], sizeof(lines[2]), "DRAWS %u UNIFORMS %u",
+             stats.draw_calls, stats.uniform_uploads);
+    FormatBytes(bytes[0], sizeof(bytes[0]), counters.GetBufferUploadBytes());
+    snprintf(lines[3], sizeof(lines[3]), "BUFFER UPLOADS %u (%s)",
+             counters.GetBufferUploads(), bytes[0]);
+    FormatBytes(bytes[0], sizeof(bytes[0]), allocation_bytes_);
+    snprintf(lines[4], sizeof(lines[4]), "ALLOCS %llu (%s)",
+             static_cast<unsigned long long>(allocation_count_), bytes[0]);
+    FormatBytes(bytes[0], sizeof(bytes[0]), counters.GetBufferMemory());
+    FormatBytes(bytes[1], sizeof(bytes[1]), counters.GetTextureMemory());
+    snprintf(lines[5], sizeof(lines[5]), "GPU BUFFERS %s TEXTURES %s",
+             bytes[0], bytes[1]);
+
+    size_t max_length = 0;
+    for (const auto& line : lines) {
+        max_length = std::max(max_length, std::strlen(line));
+    }
+    auto panel_width =
+        std::max(max_length * kCellWidth * kFontScale,
+                 kHistorySize * kGraphBarWidth) +
+        2 * kPadding;
+    auto panel_height =
+        std::size(lines) * kLineHeight + kGraphHeight + 3 * kPadding;
+
+    vertices_.clear();
+    AppendQuad(kPadding, kPadding, panel_width, panel_height, kPanelColor);
+    auto y = 2 * kPadding;
+    for (const auto& line : lines) {
+        AppendText(2 * kPadding, y, line, kTextColor);
+        y += kLineHeight;
+    }
+    AppendGraph(2 * kPadding, y + kPadding);
+
+    // NOTE: Respecified every frame, so the driver orphans the store
+    // instead of waiting for the previous draw
+    auto size = vertices_.size() * sizeof(Vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, size, vertices_.data(), GL_STREAM_DRAW);
+    GLCounters::Get().SetBufferSize(vbo_, size);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    shader_.Bind();
+    shader_.SetParam(screen_size_uniform_,
+                     glm::vec2(static_cast<float>(width),
+                               static_cast<float>(height)));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlas_);
+    glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, vertices_.size());
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void PerformanceHud::AppendQuad(float x, float y, float width, float height,
+                                const uint8_t color[4]) {
+    // NOTE: Samples the middle of the solid cell, so filtering never reaches
+    // its neighbours
+    auto u = (kSolidCell * kCellWidth + kCellWidth / 2.f) / atlas_width_;
+    auto v = 0.5f;
+    AppendRect(vertices_, x, y, width, height, u, v, u, v, color);
+}
+
+void PerformanceHud::AppendText(float x, float y, const char* text,
+                                const uint8_t color[4]) {
+    for (auto c = text; *c; ++c, x += kCellWidth * kFontScale) {
+        auto character = std::toupper(static_cast<unsigned char>(*c));
+        auto cell = character < 128 ? glyph_cells_[character] : 0;
+        if (!cell) {
+            continue;
+        }
+        auto u0 = static_cast<float>(cell * kCellWidth) / atlas_width_;
+        auto u1 = static_cast<float>(cell * kCellWidth + kGlyphWidth) /
+                  atlas_width_;
+        auto v1 = static_cast<float>(kGlyphHeight) / kCellHeight;
+        AppendRect(vertices_, x, y, kGlyphWidth * kFontScale,
+                   kGlyphHeight * kFontScale, u0, 0.f, u1, v1, color);
+    }
+}
+
+void PerformanceHud::AppendGraph(float x, float y) {
+    auto bottom = y + kGraphHeight;
+    auto scale = kGraphHeight / kGraphMaxMs;
+    // Oldest frame on the left
+    auto first = (history_next_ + kHistorySize - history_count_) % kHistorySize;
+    for (unsigned i = 0; i < history_count_; ++i) {
+        auto index = (first + i) % kHistorySize;
+        auto bar_x = x + (kHistorySize - history_count_ + i) * kGraphBarWidth;
+        auto frame_ms = std::min(frame_history_ms_[index], kGraphMaxMs);
+        auto simulation_ms =
+            std::min(simulation_history_ms_[index], frame_ms);
+        AppendQuad(bar_x, bottom - frame_ms * scale, kGraphBarWidth,
+                   frame_ms * scale,
+                   frame_history_ms_[index] > kGraphBudgetMs ? kSlowFrameColor
+                                                             : kFrameColor);
+        AppendQuad(bar_x, bottom - simulation_ms * scale, kGraphBarWidth,
+                   simulation_ms * scale, kSimulationColor);
+    }
+    AppendQuad(x, bottom - kGraphBudgetMs * scale,
+               kHistorySize * kGraphBarWidth, 1.f, kBudgetColor);
+}
+
+} // namespace tetris3d
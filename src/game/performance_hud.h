@@ -0,0 +1,88 @@
+#ifndef TETRIS3D_GAME_PERFORMANCE_HUD_H_
+#define TETRIS3D_GAME_PERFORMANCE_HUD_H_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "glm/vec2.hpp"
+
+#include "allocation_stats.h"
+#include "game/render_queue.h"
+#include "game/renderer.h"
+
+namespace tetris3d {
+
+// In-window overlay with a frame time graph, simulation and render CPU time,
+// and per frame work: draw calls, uniform and buffer uploads, heap
+// allocations; plus GPU memory held by buffers and textures
+// NOTE: Text (built-in 3x5 pixel font in a glyph atlas), panel and graph
+// bars are quads of a single vertex buffer, drawn with one draw call
+// NOTE: HUD's own work is left out of the numbers it shows
+class PerformanceHud {
+public:
+    // Frames in the graph
+    static inline constexpr unsigned kHistorySize = 120;
+
+    ~PerformanceHud();
+    void Create();
+
+    void SetVisible(bool value) { visible_ = value; }
+    bool IsVisible() const { return visible_; }
+
+    // Game update (simulation, bot, saves) time of the current frame
+    void AddSimulationTime(float seconds);
+    // Call when rendering of a frame starts; frame time is the interval
+    // between these calls
+    void BeginFrame();
+    // Draws over the rendered frame if visible
+    // @stats counters of the frame's render queue
+    void Draw(int width, int height, const RenderStats& stats);
+
+private:
+    struct Vertex {
+        glm::vec2 position;
+        glm::vec2 tex_coords;
+        uint8_t color[4];
+    };
+
+    void CreateAtlas();
+    // Solid color quad; positions are in pixels from the top left corner
+    void AppendQuad(float x, float y, float width, float height,
+                    const uint8_t color[4]);
+    void AppendText(float x, float y, const char* text,
+                    const uint8_t color[4]);
+    void AppendGraph(float x, float y);
+
+    bool visible_ = false;
+    Shader shader_;
+    ShaderUniform<glm::vec2> screen_size_uniform_;
+    unsigned atlas_ = 0;
+    unsigned vao_ = 0;
+    unsigned vbo_ = 0;
+    std::vector<Vertex> vertices_;
+    // Atlas cell of every ASCII character; unknown ones are blank
+    uint8_t glyph_cells_[128] = {};
+    unsigned atlas_width_ = 0;
+
+    std::chrono::steady_clock::time_point frame_start_;
+    bool has_frame_start_ = false;
+    AllocationStats frame_allocations_;
+    float simulation_seconds_ = 0.f;
+
+    // Latest complete frame
+    float frame_ms_ = 0.f;
+    float simulation_ms_ = 0.f;
+    uint64_t allocation_count_ = 0;
+    uint64_t allocation_bytes_ = 0;
+
+    // Ring of frame and simulation times, newest at history_next_ - 1
+    float frame_history_ms_[kHistorySize] = {};
+    float simulation_history_ms_[kHistorySize] = {};
+    unsigned history_next_ = 0;
+    unsigned history_count_ = 0;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_PERFORMANCE_HUD_H_
@@ -0,0 +1,37 @@
+#ifndef TETRIS3D_GAME_RANDOM_H_
+#define TETRIS3D_GAME_RANDOM_H_
+
+#include <cstdint>
+
+namespace tetris3d {
+
+// Small deterministic PRNG (xorshift32) owned by the game state
+// NOTE: The whole generator state is a single word, so it can be saved
+// along with the rest of the simulation and replays stay deterministic
+// (unlike global rand())
+class Random {
+public:
+    explicit Random(uint32_t seed = 42) { Seed(seed); }
+
+    void Seed(uint32_t seed) { state_ = seed ? seed : 0x9e3779b9u; }
+
+    uint32_t Next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    // Returns value in range [0, bound)
+    uint32_t NextBelow(uint32_t bound) { return Next() % bound; }
+
+    uint32_t GetState() const { return state_; }
+    void SetState(uint32_t state) { Seed(state); }
+
+private:
+    uint32_t state_ = 0;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_RANDOM_H_
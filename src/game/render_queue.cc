@@ -0,0 +1,193 @@
+#include "game/render_queue.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+namespace tetris3d {
+namespace {
+
+// NOTE: GL names are small consecutive integers, 20 bits each are plenty
+uint64_t MakeSortKey(const DrawItem& item) {
+    const uint64_t mask = (1u << 20) - 1;
+    return (static_cast<uint64_t>(item.pass) << 60) |
+           ((item.program & mask) << 40) | ((item.texture & mask) << 20) |
+           (item.vertex_array & mask);
+}
+
+// Names of profiler GPU ranges, after what AdvancedRenderer draws in them
+const char* GetPassName(RenderPass pass) {
+    switch (pass) {
+    case RenderPass::Opaque:
+        return "bounds, board, falling block";
+    case RenderPass::DepthPrepass:
+        return "ghost depth prepass";
+    case RenderPass::Transparent:
+        return "ghost";
+    case RenderPass::Background:
+        return "skybox";
+    }
+    return "";
+}
+
+} // namespace
+
+void GLStateCache::Invalidate() {
+    program_ = kUnknown;
+    vertex_array_ = kUnknown;
+    texture_ = kUnknown;
+    depth_func_ = kUnknown;
+    blend_ = kUnknown;
+    color_mask_ = kUnknown;
+}
+
+void GLStateCache::UseProgram(unsigned program) {
+    if (program_ == program) {
+        ++stats_.redundant_changes;
+        return;
+    }
+    program_ = program;
+    glUseProgram(program);
+    ++stats_.program_changes;
+}
+
+void GLStateCache::BindVertexArray(unsigned vertex_array) {
+    if (vertex_array_ == vertex_array) {
+        ++stats_.redundant_changes;
+        return;
+    }
+    vertex_array_ = vertex_array;
+    glBindVertexArray(vertex_array);
+    ++stats_.vertex_array_changes;
+}
+
+void GLStateCache::BindCubemap(unsigned texture) {
+    if (texture_ == texture) {
+        ++stats_.redundant_changes;
+        return;
+    }
+    texture_ = texture;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    ++stats_.texture_changes;
+}
+
+void GLStateCache::SetDepthFunc(unsigned func) {
+    if (depth_func_ == func) {
+        ++stats_.redundant_changes;
+        return;
+    }
+    depth_func_ = func;
+    glDepthFunc(func);
+    ++stats_.render_state_changes;
+}
+
+void GLStateCache::SetBlend(bool enabled) {
+    if (blend_ == static_cast<unsigned>(enabled)) {
+        ++stats_.redundant_changes;
+        return;
+    }
+    blend_ = enabled;
+    if (enabled) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    } else {
+        glDisable(GL_BLEND);
+    }
+    ++stats_.render_state_changes;
+}
+
+void GLStateCache::SetColorMask(bool enabled) {
+    if (color_mask_ == static_cast<unsigned>(enabled)) {
+        ++stats_.redundant_changes;
+        return;
+    }
+    color_mask_ = enabled;
+    glColorMask(enabled, enabled, enabled, enabled);
+    ++stats_.render_state_changes;
+}
+
+void RenderQueue::Add(const DrawItem& item) {
+    if (!item.count || (item.instanced && !item.instance_count)) {
+        return;
+    }
+    order_.emplace_back(MakeSortKey(item), items_.size());
+    items_.push_back(item);
+}
+
+void RenderQueue::Submit() {
+    stats_ = RenderStats{};
+    state_.Invalidate();
+    std::sort(order_.begin(), order_.end());
+
+    // NOTE: Items of a pass are sorted by state, not by what they draw, so
+    // GPU time is measured per pass
+    auto& profiler = Profiler::Get();
+    SetPassState(RenderPass::Opaque);
+    auto pass = RenderPass::Opaque;
+    profiler.BeginGpuRange(GetPassName(pass));
+    for (const auto& [key, index] : order_) {
+        const auto& item = items_[index];
+        if (item.pass != pass) {
+            pass = item.pass;
+            SetPassState(pass);
+            profiler.EndGpuRange();
+            profiler.BeginGpuRange(GetPassName(pass));
+        }
+        state_.UseProgram(item.program);
+        if (item.texture) {
+            state_.BindCubemap(item.texture);
+        }
+        state_.BindVertexArray(item.vertex_array);
+        if (item.color_uniform.location >= 0) {
+            const auto& color = item.color;
+            glUniform4f(item.color_uniform.location, color.r, color.g,
+                        color.b, color.a);
+            ++stats_.uniform_uploads;
+        }
+        if (item.world_uniform.location >= 0) {
+            glUniformMatrix4fv(item.world_uniform.location, 1, GL_FALSE,
+                               &item.world[0][0]);
+            ++stats_.uniform_uploads;
+        }
+        if (item.instanced) {
+            glDrawArraysInstanced(item.mode, item.first, item.count,
+                                  item.instance_count);
+        } else {
+            glDrawArrays(item.mode, item.first, item.count);
+        }
+        ++stats_.draw_calls;
+    }
+    profiler.EndGpuRange();
+    SetPassState(RenderPass::Opaque);
+
+    items_.clear();
+    order_.clear();
+}
+
+void RenderQueue::SetPassState(RenderPass pass) {
+    switch (pass) {
+    case RenderPass::Opaque:
+        state_.SetColorMask(true);
+        state_.SetDepthFunc(GL_LESS);
+        state_.SetBlend(false);
+        break;
+    case RenderPass::DepthPrepass:
+        state_.SetColorMask(false);
+        state_.SetDepthFunc(GL_LESS);
+        state_.SetBlend(false);
+        break;
+    case RenderPass::Transparent:
+        state_.SetColorMask(true);
+        state_.SetDepthFunc(GL_LEQUAL);
+        state_.SetBlend(true);
+        break;
+    case RenderPass::Background:
+        state_.SetColorMask(true);
+        state_.SetDepthFunc(GL_LEQUAL);
+        state_.SetBlend(false);
+        break;
+    }
+}
+
+} // namespace tetris3d
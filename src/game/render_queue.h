@@ -0,0 +1,127 @@
+#ifndef TETRIS3D_GAME_RENDER_QUEUE_H_
+#define TETRIS3D_GAME_RENDER_QUEUE_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+
+#include "game/color.h"
+
+namespace tetris3d {
+
+// Location of an active uniform of type T, reflected at link time; callers
+// keep handles, so setting a uniform needs no lookup by name
+template <typename T> struct ShaderUniform {
+    int location = -1;
+};
+
+// Passes are submitted in this order; each sets its own render state
+// ----
+// Opaque       - depth test less, no blending
+// DepthPrepass - depth only, color writes off
+// Transparent  - depth test less or equal, alpha blending
+// Background   - depth test less or equal (skybox at far plane)
+// ----
+enum class RenderPass : uint8_t {
+    Opaque,
+    DepthPrepass,
+    Transparent,
+    Background
+};
+
+// Single draw call with everything needed to issue it; texture (if any) is
+// bound as cubemap to unit 0
+struct DrawItem {
+    RenderPass pass = RenderPass::Opaque;
+    unsigned program = 0;
+    unsigned texture = 0;
+    unsigned vertex_array = 0;
+    unsigned mode = GL_TRIANGLES;
+    int first = 0;
+    int count = 0;
+    bool instanced = false;
+    int instance_count = 0;
+
+    // Per draw uniforms, set only if the handle is valid
+    ShaderUniform<Color> color_uniform;
+    Color color;
+    ShaderUniform<glm::mat4> world_uniform;
+    glm::mat4 world{1.f};
+};
+
+// Counters of a single submitted frame
+struct RenderStats {
+    unsigned draw_calls = 0;
+    // Per draw uniforms (color, world) set
+    unsigned uniform_uploads = 0;
+    unsigned program_changes = 0;
+    unsigned vertex_array_changes = 0;
+    unsigned texture_changes = 0;
+    // Depth function, blending and color mask
+    unsigned render_state_changes = 0;
+    // Calls filtered out by GLStateCache as they would not change anything
+    unsigned redundant_changes = 0;
+};
+
+// Shadows GL bindings and render state, so setting the current value again
+// does not reach the driver
+class GLStateCache {
+public:
+    explicit GLStateCache(RenderStats& stats) : stats_(stats) {}
+
+    // Forgets all shadowed values, so the next calls reach GL (state may
+    // have been changed by code not using the cache)
+    void Invalidate();
+
+    void UseProgram(unsigned program);
+    void BindVertexArray(unsigned vertex_array);
+    void BindCubemap(unsigned texture);
+    void SetDepthFunc(unsigned func);
+    void SetBlend(bool enabled);
+    void SetColorMask(bool enabled);
+
+private:
+    static inline constexpr unsigned kUnknown = ~0u;
+
+    RenderStats& stats_;
+    unsigned program_ = kUnknown;
+    unsigned vertex_array_ = kUnknown;
+    unsigned texture_ = kUnknown;
+    unsigned depth_func_ = kUnknown;
+    unsigned blend_ = kUnknown;
+    unsigned color_mask_ = kUnknown;
+};
+
+// Collects draws of a frame and submits them sorted by (pass, program,
+// texture, vertex array), so each binding changes as rarely as possible
+// NOTE: Sort is stable; draws with equal keys keep their order
+class RenderQueue {
+public:
+    RenderQueue() : state_(stats_) {}
+
+    // Draws with nothing to draw are dropped
+    void Add(const DrawItem& item);
+
+    // Issues all draws and clears the queue; render state is left at
+    // defaults of the Opaque pass
+    void Submit();
+
+    // Counters of the last submitted frame
+    const RenderStats& GetStats() const { return stats_; }
+
+private:
+    void SetPassState(RenderPass pass);
+
+    std::vector<DrawItem> items_;
+    // Sort key and index of the item
+    std::vector<std::pair<uint64_t, uint32_t>> order_;
+    RenderStats stats_;
+    GLStateCache state_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_RENDER_QUEUE_H_
@@ -1,21 +1,38 @@
 #include "game/renderer.h"
 
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "error.h"
+#include "game/cubemap_bundle.h"
+#include "game/gl_counters.h"
+#include "game/performance_hud.h"
+#include "profiler.h"
+
 namespace {
 
-const std::string solid_vs = R"~(
+// NOTE: Camera data is shared by all shaders through a uniform buffer
+// updated once per frame (see CameraUniformBuffer)
+const std::string camera_block = R"~(
 #version 330 core
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+};
+)~";
+
+const std::string solid_vs = camera_block + R"~(
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
-
-uniform mat4 world;
-uniform mat4 view;
-uniform mat4 projection;
+layout (location = 2) in vec3 instance_position;
 
 void main() {
-    gl_Position = projection * view * world * vec4(position, 1.0);
+    gl_Position = projection * view * vec4(position + instance_position, 1.0);
 }
 
 )~";
@@ -32,14 +49,10 @@ void main() {
 
 )~";
 
-const std::string solid_wire_vs = R"~(
-
-#version 330 core
+const std::string solid_wire_vs = camera_block + R"~(
 layout (location = 0) in vec3 position;
 
 uniform mat4 world;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
     gl_Position = projection * view * world * vec4(position, 1.0);
@@ -60,62 +73,54 @@ void main() {
 
 )~";
 
-const std::string refract_vs = R"~(
-
-#version 330 core
+const std::string refract_vs = camera_block + R"~(
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec3 instance_position;
+layout (location = 3) in vec4 instance_color;
 
 out vec3 Normal;
 out vec3 Position;
+flat out vec4 Color;
 
-uniform mat4 world;
-uniform mat4 view;
-uniform mat4 projection;
-
+// NOTE: Boxes are axis aligned and only translated, so normals need no
+// transformation
 void main() {
-    Normal = mat3(transpose(inverse(world))) * aNormal;
-    Position = vec3(world * vec4(aPos, 1.0));
-    gl_Position = projection * view * world * vec4(aPos, 1.0);
+    Normal = aNormal;
+    Position = aPos + instance_position;
+    Color = instance_color;
+    gl_Position = projection * view * vec4(Position, 1.0);
 }
 
 )~";
 
-const std::string refract_fs = R"~(
-
-#version 330 core
+const std::string refract_fs = camera_block + R"~(
 out vec4 final_color;
 
 in vec3 Normal;
 in vec3 Position;
+flat in vec4 Color;
 
-uniform vec3 camera_pos;
 uniform samplerCube skybox;
-uniform vec4 color;
 
 void main() {             
-    vec3 I = normalize(Position - camera_pos);
+    vec3 I = normalize(Position - camera_position.xyz);
     vec3 R = reflect(I, normalize(Normal));
-    vec4 texture_color = vec4(texture(skybox, R).rgb, color.a);
-    vec4 mixed_color = mix(color, texture_color, 0.4);
+    vec4 texture_color = vec4(texture(skybox, R).rgb, Color.a);
+    vec4 mixed_color = mix(Color, texture_color, 0.4);
     final_color = mixed_color;
 }
 
 )~";
 
-const std::string skybox_vs = R"~(
-
-#version 330 core
+const std::string skybox_vs = camera_block + R"~(
 layout (location = 0) in vec3 position;
 
 out vec3 tex_coords;
 
-uniform mat4 projection;
-uniform mat4 view;
-
 void main() {
     tex_coords = position;
-    vec4 pos = projection * view * vec4(position, 1.0);
+    vec4 pos = projection * mat4(mat3(view)) * vec4(position, 1.0);
     gl_Position = pos.xyww;
 }
 
@@ -137,12 +142,101 @@ void main() {
 
 )~";
 
+unsigned CreateCubemapTexture() {
+    unsigned id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return id;
+}
+
+// NOTE: Not in glad.h, which is generated without extensions
+constexpr GLenum kCompressedRgbS3tcDxt1 = 0x83F0;
+
+// Board vertex arrays are reserved for a full board up front, so a rising
+// stack does not allocate while playing; only up to this size, larger
+// boards grow them on demand
+constexpr size_t kMaxReservedVertexBytes = 32 << 20;
+
+bool HasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        auto extension =
+            reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && std::strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE: Cubemap must be complete (all faces of level 0 uploaded)
+void GenerateCubemapMipmaps(unsigned id) {
+    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    // NOTE: Whole chain adds a third of level 0
+    auto& counters = tetris3d::GLCounters::Get();
+    counters.AddTextureSize(id, counters.GetTextureSize(id) / 3);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+}
+
+unsigned GetEnvironmentSize(tetris3d::Config::EnvironmentQuality quality) {
+    switch (quality) {
+    case tetris3d::Config::EnvironmentQuality::Low:
+        return 32;
+    case tetris3d::Config::EnvironmentQuality::Medium:
+        return 128;
+    case tetris3d::Config::EnvironmentQuality::High:
+        return 0;
+    }
+    return 0;
+}
+
 } // namespace
 
 namespace tetris3d {
 
+CubeInstance MakeCubeInstance(const glm::vec3& position, unsigned color_pack) {
+    CubeInstance instance;
+    instance.position = position;
+    instance.color[0] = (color_pack >> 16) & 0xff;
+    instance.color[1] = (color_pack >> 8) & 0xff;
+    instance.color[2] = color_pack & 0xff;
+    instance.color[3] = 0xff;
+    return instance;
+}
+
 BasicRenderer::BasicRenderer(Config& config) : config_(config) {}
 
+BasicRenderer::~BasicRenderer() {
+    if (board_vbo_) {
+        glDeleteBuffers(1, &board_vbo_);
+    }
+    if (bounds_vbo_) {
+        glDeleteBuffers(1, &bounds_vbo_);
+    }
+}
+
+void BasicRenderer::StartUp(const GameState& state) {
+    glGenBuffers(1, &board_vbo_);
+    glGenBuffers(1, &bounds_vbo_);
+    // AppendTetrisCube: 4 cubes of 36 vertices per filled cell
+    const auto& board = state.board;
+    size_t full_board_vertices = static_cast<size_t>(board.GetWidth()) *
+                                 board.GetHeight() * board.GetDepth() * 4 *
+                                 36;
+    if (full_board_vertices * sizeof(ColoredVertex) <=
+        kMaxReservedVertexBytes) {
+        vertices_.reserve(full_board_vertices);
+    }
+}
+
 void BasicRenderer::Render(const GameState& state,
                            const PerspectiveCamera& camera) {
     glViewport(0, 0, framebuffer_width_, framebuffer_height_);
@@ -178,31 +272,71 @@ void BasicRenderer::Render(const GameState& state,
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    RenderBounds(state.board, camera.GetForward());
-
-    RenderBoard(state.board);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
 
-    RenderFallingBlock(state.falling_block);
+    {
+        GpuProfileScope scope("bounds");
+        RenderBounds(state.board, camera.GetForward());
+    }
+    {
+        GpuProfileScope scope("board");
+        RenderBoard(state.board);
+    }
+    {
+        GpuProfileScope scope("falling block");
+        RenderFallingBlock(state.falling_block);
+    }
     if (state.phase == GameState::Phase::BlockFalling) {
+        GpuProfileScope scope("ghost");
         RenderFallingBlockProjection(state);
     }
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void BasicRenderer::RenderBoard(const Board& board) {
-    for (size_t k = 0; k < board.GetHeight(); ++k) {
-        for (size_t i = 0; i < board.GetWidth(); ++i) {
-            for (size_t j = 0; j < board.GetDepth(); ++j) {
-                auto index = (i * board.GetWidth() + j) +
-                             (k * board.GetWidth() * board.GetDepth());
+    UpdateBoardBuffer(board);
+    SetVertexPointers(board_vbo_, nullptr);
+    glDrawArrays(GL_TRIANGLES, 0, board_vertex_count_);
+}
+
+void BasicRenderer::UpdateBoardBuffer(const Board& board) {
+    auto height = static_cast<size_t>(board.GetHeight());
+    auto changed = board_revisions_.size() != height;
+    board_revisions_.resize(height);
+    for (int k = 0; k < board.GetHeight(); ++k) {
+        if (board_revisions_[k] != board.GetLayerRevision(k)) {
+            board_revisions_[k] = board.GetLayerRevision(k);
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+
+    vertices_.clear();
+    for (int k = 0; k < board.GetHeight(); ++k) {
+        for (int i = 0; i < board.GetWidth(); ++i) {
+            for (int j = 0; j < board.GetDepth(); ++j) {
+                auto index = static_cast<size_t>(i * board.GetWidth() + j) +
+                             static_cast<size_t>(k) * board.GetWidth() *
+                                 board.GetDepth();
                 if (board.GetCell(index)) {
                     auto position = glm::vec3(i, k, j);
                     Color color = FromPackedColorToColor(board.GetCell(index));
-                    RenderTetrisCube(position + glm::vec3(0.5f, 0.5f, 0.5f),
-                                     color);
+                    AppendTetrisCube(position + glm::vec3(0.5f, 0.5f, 0.5f),
+                                     color, vertices_);
                 }
             }
         }
     }
+    glBindBuffer(GL_ARRAY_BUFFER, board_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ColoredVertex) * vertices_.size(),
+                 vertices_.data(), GL_STATIC_DRAW);
+    board_vertex_count_ = vertices_.size();
 }
 
 void BasicRenderer::RenderFallingBlock(const Block& block) {
@@ -211,11 +345,14 @@ void BasicRenderer::RenderFallingBlock(const Block& block) {
     color.g = block.GetColor().g / 255.f;
     color.b = block.GetColor().b / 255.f;
 
+    vertices_.clear();
     for (auto& offset : block.GetCubeOffsets()) {
-        RenderTetrisCube(glm::vec3(block.GetPosition() + offset) +
+        AppendTetrisCube(glm::vec3(block.GetPosition() + offset) +
                              glm::vec3(0.5f, 0.5f, 0.5f),
-                         color);
+                         color, vertices_);
     }
+    SetVertexPointers(0, vertices_.data());
+    glDrawArrays(GL_TRIANGLES, 0, vertices_.size());
 }
 
 void BasicRenderer::RenderFallingBlockProjection(const GameState& state) {
@@ -227,22 +364,22 @@ void BasicRenderer::RenderFallingBlockProjection(const GameState& state) {
 
     Color color{0.9, 0.9f, 0.9f, 0.6f};
 
-    glColorMask(false, false, false, false);
+    vertices_.clear();
     for (auto& offset : projected_block.GetCubeOffsets()) {
-        RenderCube(glm::vec3(projected_block.GetPosition() + offset) +
+        AppendCube(glm::vec3(projected_block.GetPosition() + offset) +
                        glm::vec3(0.5f, 0.5f, 0.5f),
-                   color, 1.f, 1.f, 1.f);
+                   color, 1.f, 1.f, 1.f, vertices_);
     }
+    SetVertexPointers(0, vertices_.data());
+
+    glColorMask(false, false, false, false);
+    glDrawArrays(GL_TRIANGLES, 0, vertices_.size());
 
     glColorMask(true, true, true, true);
     glDepthFunc(GL_LEQUAL);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for (auto& offset : projected_block.GetCubeOffsets()) {
-        RenderCube(glm::vec3(projected_block.GetPosition() + offset) +
-                       glm::vec3(0.5f, 0.5f, 0.5f),
-                   color, 1.f, 1.f, 1.f);
-    }
+    glDrawArrays(GL_TRIANGLES, 0, vertices_.size());
     glDisable(GL_BLEND);
     glDepthFunc(GL_LESS);
 }
@@ -269,94 +406,128 @@ void BasicRenderer::RenderGizmo(const glm::vec3& position) {
 
 void BasicRenderer::RenderBounds(const Board& board,
                                  const glm::vec3& view_dir) {
+    UpdateBoundsBuffer(board);
+
+    // NOTE: Ground is always drawn, walls only when they are behind the
+    // board from camera point of view
+    GLint firsts[5] = {0};
+    GLsizei counts[5] = {static_cast<GLsizei>(bounds_ranges_[0].count)};
+    GLsizei draw_count = 1;
+    const glm::vec3 wall_dirs[] = {{0, 0, 1}, {1, 0, 0}, {0, 0, -1},
+                                   {-1, 0, 0}};
+    for (int wall = 0; wall < 4; ++wall) {
+        if (glm::dot(view_dir, wall_dirs[wall]) < 0.f) {
+            firsts[draw_count] = bounds_ranges_[wall + 1].first;
+            counts[draw_count] = bounds_ranges_[wall + 1].count;
+            ++draw_count;
+        }
+    }
+    SetVertexPointers(bounds_vbo_, nullptr);
+    glMultiDrawArrays(GL_LINES, firsts, counts, draw_count);
+}
+
+void BasicRenderer::UpdateBoundsBuffer(const Board& board) {
     auto width = board.GetWidth();
     auto height = board.GetHeight();
     auto depth = board.GetDepth();
+    glm::ivec3 dimensions(width, height, depth);
+    if (dimensions == bounds_dimensions_) {
+        return;
+    }
+    bounds_dimensions_ = dimensions;
 
-    glBegin(GL_LINES);
-
-    glColor3f(0.25f, 0.25f, 0.25f);
+    Color color{0.25f, 0.25f, 0.25f};
+    vertices_.clear();
+    auto add_line = [&](const glm::vec3& from, const glm::vec3& to) {
+        AppendVertex(from, color, vertices_);
+        AppendVertex(to, color, vertices_);
+    };
+    auto end_range = [&](int range) {
+        bounds_ranges_[range].count =
+            vertices_.size() - bounds_ranges_[range].first;
+        if (range + 1 < 5) {
+            bounds_ranges_[range + 1].first = vertices_.size();
+        }
+    };
 
-    // floor rendering
+    // floor
+    bounds_ranges_[0].first = 0;
     for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
-        glVertex3f(i, 0.f, 0.f);
-        glVertex3f(i, 0.f, depth);
-        glVertex3f(0.f, 0.f, i);
-        glVertex3f(width, 0.f, i);
+        add_line({i, 0.f, 0.f}, {i, 0.f, depth});
+        add_line({0.f, 0.f, i}, {width, 0.f, i});
     }
+    end_range(0);
 
-    {
-        glm::vec3 wall_dir{0, 0, 1};
-        if (glm::dot(view_dir, wall_dir) < 0.f) {
-            for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
-                glVertex3f(i, 0.f, 0.f);
-                glVertex3f(i, height, 0.f);
-            }
-
-            for (auto i = 1.f; i < height + 0.1f; i += 1.f) {
-                glVertex3f(0.f, i, 0.f);
-                glVertex3f(width, i, 0.f);
-            }
-        }
+    // wall at z = 0
+    for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
+        add_line({i, 0.f, 0.f}, {i, height, 0.f});
     }
-
-    {
-        glm::vec3 wall_dir{1, 0, 0};
-        if (glm::dot(view_dir, wall_dir) < 0.f) {
-            for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
-                glVertex3f(0.f, 0.f, i);
-                glVertex3f(0.f, height, i);
-            }
-
-            for (auto i = 1.f; i < height + 0.1f; i += 1.f) {
-                glVertex3f(0.f, i, 0.f);
-                glVertex3f(0.f, i, depth);
-            }
-        }
+    for (auto i = 1.f; i < height + 0.1f; i += 1.f) {
+        add_line({0.f, i, 0.f}, {width, i, 0.f});
     }
+    end_range(1);
 
-    {
-        glm::vec3 wall_dir{0, 0, -1};
-        if (glm::dot(view_dir, wall_dir) < 0.f) {
-            for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
-                glVertex3f(i, 0.f, depth);
-                glVertex3f(i, height, depth);
-            }
-
-            for (auto i = 1.f; i < height + 0.1f; i += 1.f) {
-                glVertex3f(width, i, depth);
-                glVertex3f(0.f, i, depth);
-            }
-        }
+    // wall at x = 0
+    for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
+        add_line({0.f, 0.f, i}, {0.f, height, i});
+    }
+    for (auto i = 1.f; i < height + 0.1f; i += 1.f) {
+        add_line({0.f, i, 0.f}, {0.f, i, depth});
     }
+    end_range(2);
 
-    {
-        glm::vec3 wall_dir{-1, 0, 0};
-        if (glm::dot(view_dir, wall_dir) < 0.f) {
-            for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
-                glVertex3f(width, 0.f, i);
-                glVertex3f(width, height, i);
-            }
+    // wall at z = depth
+    for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
+        add_line({i, 0.f, depth}, {i, height, depth});
+    }
+    for (auto i = 1.f; i < height + 0.1f; i += 1.f) {
+        add_line({width, i, depth}, {0.f, i, depth});
+    }
+    end_range(3);
 
-            for (auto i = 1.f; i < height + 0.1f; i += 1.f) {
-                glVertex3f(width, i, depth);
-                glVertex3f(width, i, 0.f);
-            }
-        }
+    // wall at x = width
+    for (auto i = 0.f; i < width + 0.1f; i += 1.f) {
+        add_line({width, 0.f, i}, {width, height, i});
+    }
+    for (auto i = 1.f; i < height + 0.1f; i += 1.f) {
+        add_line({width, i, depth}, {width, i, 0.f});
     }
+    end_range(4);
 
-    glEnd();
+    glBindBuffer(GL_ARRAY_BUFFER, bounds_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ColoredVertex) * vertices_.size(),
+                 vertices_.data(), GL_STATIC_DRAW);
 }
 
-void BasicRenderer::RenderCube(const glm::vec3& position, const Color& color,
-                               float width, float depth, float height) {
-    glBegin(GL_TRIANGLES);
-    glColor4f(color.r, color.g, color.b, color.a);
+void BasicRenderer::SetVertexPointers(unsigned buffer,
+                                      const ColoredVertex* vertices) {
+    // NOTE: With a buffer bound pointers are offsets into it
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    auto base = reinterpret_cast<const uint8_t*>(vertices);
+    glVertexPointer(3, GL_FLOAT, sizeof(ColoredVertex),
+                    base + offsetof(ColoredVertex, position));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ColoredVertex),
+                   base + offsetof(ColoredVertex, color));
+}
+
+void BasicRenderer::AppendVertex(const glm::vec3& position, const Color& color,
+                                 std::vector<ColoredVertex>& vertices) {
+    ColoredVertex vertex;
+    vertex.position = position;
+    vertex.color[0] = static_cast<uint8_t>(color.r * 255.f + 0.5f);
+    vertex.color[1] = static_cast<uint8_t>(color.g * 255.f + 0.5f);
+    vertex.color[2] = static_cast<uint8_t>(color.b * 255.f + 0.5f);
+    vertex.color[3] = static_cast<uint8_t>(color.a * 255.f + 0.5f);
+    vertices.push_back(vertex);
+}
 
+void BasicRenderer::AppendCube(const glm::vec3& position, const Color& color,
+                               float width, float depth, float height,
+                               std::vector<ColoredVertex>& vertices) {
     auto wOver2 = width / 2.f;
     auto hOver2 = height / 2.f;
     auto dOver2 = depth / 2.f;
-    glm::vec3 positions[] = {
+    const glm::vec3 positions[] = {
         {-wOver2, -hOver2, -dOver2}, // 0
         {-wOver2, hOver2, -dOver2},  // 1
         {wOver2, hOver2, -dOver2},   // 2
@@ -381,24 +552,18 @@ void BasicRenderer::RenderCube(const glm::vec3& position, const Color& color,
         {-wOver2, -hOver2, dOver2},
     };
 
-    for (auto& pos : positions) {
-        pos += position;
+    for (const auto& pos : positions) {
+        AppendVertex(pos + position, color, vertices);
     }
-
-    auto positions_count = sizeof(positions) / sizeof(positions[0]);
-
-    for (size_t i = 0; i < positions_count; ++i) {
-        glVertex3f(positions[i].x, positions[i].y, positions[i].z);
-    }
-    glEnd();
 }
 
-void BasicRenderer::RenderTetrisCube(const glm::vec3& pos, const Color& color) {
+void BasicRenderer::AppendTetrisCube(const glm::vec3& pos, const Color& color,
+                                     std::vector<ColoredVertex>& vertices) {
     Color cube_edge_color{0.1f, 0.1f, 0.1f};
-    RenderCube(pos, cube_edge_color, 1.0f, 1.0f, 1.0f);
-    RenderCube(pos, color, 1.01f, 0.8f, 0.8f);
-    RenderCube(pos, color, 0.8f, 1.01f, 0.8f);
-    RenderCube(pos, color, 0.8f, 0.8f, 1.01f);
+    AppendCube(pos, cube_edge_color, 1.0f, 1.0f, 1.0f, vertices);
+    AppendCube(pos, color, 1.01f, 0.8f, 0.8f, vertices);
+    AppendCube(pos, color, 0.8f, 1.01f, 0.8f, vertices);
+    AppendCube(pos, color, 0.8f, 0.8f, 1.01f, vertices);
 }
 
 // -----------------------------------------------------------------------
@@ -406,7 +571,7 @@ void BasicRenderer::RenderTetrisCube(const glm::vec3& pos, const Color& color) {
 
 Shader::~Shader() {
     if (id_) {
-        glDeleteShader(id_);
+        glDeleteProgram(id_);
     }
 }
 
@@ -428,62 +593,142 @@ void Shader::Create(const std::string& vs_str, const std::string& fs_str) {
     LogProgramErrorsIfAny(id_);
     glDeleteShader(vs);
     glDeleteShader(fs);
+    ReflectUniforms();
+}
+
+void Shader::ReflectUniforms() {
+    uniform_locations_.clear();
+    int count = 0;
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &count);
+    char name[256];
+    for (int i = 0; i < count; ++i) {
+        int length = 0;
+        int size = 0;
+        unsigned type = 0;
+        glGetActiveUniform(id_, i, sizeof(name), &length, &size, &type, name);
+        // NOTE: Members of uniform blocks have no location
+        auto location = glGetUniformLocation(id_, name);
+        if (location < 0) {
+            continue;
+        }
+        // NOTE: Arrays are reported as "name[0]"; callers use bare name
+        std::string uniform_name(name, length);
+        if (uniform_name.ends_with("[0]")) {
+            uniform_name.resize(uniform_name.size() - 3);
+        }
+        uniform_locations_[uniform_name] = location;
+    }
+}
+
+int Shader::GetUniformLocation(const char* name) const {
+    auto it = uniform_locations_.find(name);
+    return it != uniform_locations_.end() ? it->second : -1;
+}
+
+void Shader::BindUniformBlock(const char* name, unsigned binding) const {
+    auto index = glGetUniformBlockIndex(id_, name);
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(id_, index, binding);
+    }
+}
+
+void Shader::SetParam(ShaderUniform<bool> uniform, bool value) const {
+    glUniform1i(uniform.location, static_cast<int>(value));
+}
+
+void Shader::SetParam(ShaderUniform<int> uniform, int value) const {
+    glUniform1i(uniform.location, value);
+}
+
+void Shader::SetParam(ShaderUniform<float> uniform, float value) const {
+    glUniform1f(uniform.location, value);
+}
+
+void Shader::SetParam(ShaderUniform<glm::vec2> uniform,
+                      const glm::vec2& value) const {
+    glUniform2fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::SetParam(ShaderUniform<glm::vec3> uniform,
+                      const glm::vec3& value) const {
+    glUniform3fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::SetParam(ShaderUniform<glm::vec4> uniform,
+                      const glm::vec4& value) const {
+    glUniform4fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::SetParam(ShaderUniform<glm::mat2> uniform,
+                      const glm::mat2& value) const {
+    glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::SetParam(ShaderUniform<glm::mat3> uniform,
+                      const glm::mat3& value) const {
+    glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::SetParam(ShaderUniform<glm::mat4> uniform,
+                      const glm::mat4& value) const {
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::SetParam(ShaderUniform<Color> uniform, const Color& color) const {
+    glUniform4f(uniform.location, color.r, color.g, color.b, color.a);
 }
 
 void Shader::SetParam(const char* name, bool value) const {
-    glUniform1i(glGetUniformLocation(id_, name), static_cast<int>(value));
+    SetParam(GetUniform<bool>(name), value);
 }
 
 void Shader::SetParam(const char* name, int value) const {
-    glUniform1i(glGetUniformLocation(id_, name), value);
+    SetParam(GetUniform<int>(name), value);
 }
 
 void Shader::SetParam(const char* name, float value) const {
-    glUniform1f(glGetUniformLocation(id_, name), value);
+    SetParam(GetUniform<float>(name), value);
 }
 
 void Shader::SetParam(const char* name, const glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(id_, name), 1, &value[0]);
+    SetParam(GetUniform<glm::vec2>(name), value);
 }
 
 void Shader::SetParam(const char* name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(id_, name), x, y);
+    glUniform2f(GetUniformLocation(name), x, y);
 }
 
 void Shader::SetParam(const char* name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(id_, name), 1, &value[0]);
+    SetParam(GetUniform<glm::vec3>(name), value);
 }
 
 void Shader::SetParam(const char* name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(id_, name), x, y, z);
+    glUniform3f(GetUniformLocation(name), x, y, z);
 }
 
 void Shader::SetParam(const char* name, const glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(id_, name), 1, &value[0]);
+    SetParam(GetUniform<glm::vec4>(name), value);
 }
 
 void Shader::SetParam(const char* name, float x, float y, float z,
                       float w) const {
-    glUniform4f(glGetUniformLocation(id_, name), x, y, z, w);
+    glUniform4f(GetUniformLocation(name), x, y, z, w);
 }
 
 void Shader::SetParam(const char* name, const glm::mat2& value) const {
-    glUniformMatrix2fv(glGetUniformLocation(id_, name), 1, GL_FALSE,
-                       &value[0][0]);
+    SetParam(GetUniform<glm::mat2>(name), value);
 }
 
 void Shader::SetParam(const char* name, const glm::mat3& value) const {
-    glUniformMatrix3fv(glGetUniformLocation(id_, name), 1, GL_FALSE,
-                       &value[0][0]);
+    SetParam(GetUniform<glm::mat3>(name), value);
 }
 
 void Shader::SetParam(const char* name, const glm::mat4& value) const {
-    glUniformMatrix4fv(glGetUniformLocation(id_, name), 1, GL_FALSE,
-                       &value[0][0]);
+    SetParam(GetUniform<glm::mat4>(name), value);
 }
 
 void Shader::SetParam(const char* name, const Color& color) const {
-    SetParam(name, color.r, color.g, color.b, color.a);
+    SetParam(GetUniform<Color>(name), color);
 }
 
 void Shader::Bind() {
@@ -515,30 +760,34 @@ bool Shader::LogProgramErrorsIfAny(unsigned program) {
     return success != 0;
 }
 
-void Cube::Create(float width, float depth, float height) {
-    auto wOver2 = width / 2.f;
-    auto hOver2 = height / 2.f;
-    auto dOver2 = depth / 2.f;
-    std::vector<glm::vec3> positions = {
-        {-wOver2, -hOver2, -dOver2}, {-wOver2, hOver2, -dOver2},
-        {wOver2, hOver2, -dOver2},   {-wOver2, -hOver2, -dOver2},
-        {wOver2, hOver2, -dOver2},   {wOver2, -hOver2, -dOver2},
-        {wOver2, -hOver2, -dOver2},  {wOver2, hOver2, -dOver2},
-        {wOver2, -hOver2, dOver2},   {wOver2, -hOver2, dOver2},
-        {wOver2, hOver2, -dOver2},   {wOver2, hOver2, dOver2},
-        {wOver2, hOver2, -dOver2},   {-wOver2, hOver2, -dOver2},
-        {-wOver2, hOver2, dOver2},   {wOver2, hOver2, -dOver2},
-        {-wOver2, hOver2, dOver2},   {wOver2, hOver2, dOver2},
-        {wOver2, -hOver2, dOver2},   {-wOver2, hOver2, dOver2},
-        {-wOver2, -hOver2, dOver2},  {wOver2, -hOver2, dOver2},
-        {wOver2, hOver2, dOver2},    {-wOver2, hOver2, dOver2},
-        {-wOver2, -hOver2, dOver2},  {-wOver2, hOver2, -dOver2},
-        {-wOver2, -hOver2, -dOver2}, {-wOver2, -hOver2, dOver2},
-        {-wOver2, hOver2, dOver2},   {-wOver2, hOver2, -dOver2},
-        {-wOver2, -hOver2, -dOver2}, {wOver2, -hOver2, -dOver2},
-        {-wOver2, -hOver2, dOver2},  {wOver2, -hOver2, -dOver2},
-        {wOver2, -hOver2, dOver2},   {-wOver2, -hOver2, dOver2},
-    };
+void CubeInstanceBuffer::Create() { glGenBuffers(1, &vbo_); }
+
+CubeInstanceBuffer::~CubeInstanceBuffer() {
+    if (vbo_) {
+        glDeleteBuffers(1, &vbo_);
+        GLCounters::Get().RemoveBuffer(vbo_);
+    }
+}
+
+void CubeInstanceBuffer::Upload(const std::vector<CubeInstance>& instances) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    // NOTE: Respecifying the whole store lets the driver orphan the buffer
+    // still used by previous frame draws instead of waiting for them
+    auto size = sizeof(CubeInstance) * instances.size();
+    glBufferData(GL_ARRAY_BUFFER, size, instances.data(), GL_STREAM_DRAW);
+    count_ = instances.size();
+    auto& counters = GLCounters::Get();
+    counters.SetBufferSize(vbo_, size);
+    counters.CountBufferUpload(size);
+}
+
+void Cube::Create(const std::vector<glm::vec3>& box_sizes,
+                  const CubeInstanceBuffer& instances) {
+    std::vector<glm::vec3> positions;
+    for (const auto& size : box_sizes) {
+        AppendBox(size.x, size.z, size.y, positions);
+    }
+    vertex_count_ = positions.size();
 
     std::vector<glm::vec3> normals;
     for (size_t i = 0; i < positions.size(); i += 3) {
@@ -565,57 +814,361 @@ void Cube::Create(float width, float depth, float height) {
     glBindBuffer(GL_ARRAY_BUFFER, vbo_);
     glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(glm::vec3) * positions.size(),
                  positions_normals.data(), GL_STATIC_DRAW);
+    GLCounters::Get().SetBufferSize(vbo_,
+                                    2 * sizeof(glm::vec3) * positions.size());
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, false, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 3, GL_FLOAT, false, 6 * sizeof(float),
                           (void*)(3 * sizeof(float)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, instances.GetBuffer());
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, false, sizeof(CubeInstance),
+                          (void*)offsetof(CubeInstance, position));
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, true, sizeof(CubeInstance),
+                          (void*)offsetof(CubeInstance, color));
+    glVertexAttribDivisor(3, 1);
+    glBindVertexArray(0);
+}
+
+void Cube::AppendBox(float width, float depth, float height,
+                     std::vector<glm::vec3>& positions) {
+    auto wOver2 = width / 2.f;
+    auto hOver2 = height / 2.f;
+    auto dOver2 = depth / 2.f;
+    positions.insert(positions.end(), {
+        {-wOver2, -hOver2, -dOver2}, {-wOver2, hOver2, -dOver2},
+        {wOver2, hOver2, -dOver2},   {-wOver2, -hOver2, -dOver2},
+        {wOver2, hOver2, -dOver2},   {wOver2, -hOver2, -dOver2},
+        {wOver2, -hOver2, -dOver2},  {wOver2, hOver2, -dOver2},
+        {wOver2, -hOver2, dOver2},   {wOver2, -hOver2, dOver2},
+        {wOver2, hOver2, -dOver2},   {wOver2, hOver2, dOver2},
+        {wOver2, hOver2, -dOver2},   {-wOver2, hOver2, -dOver2},
+        {-wOver2, hOver2, dOver2},   {wOver2, hOver2, -dOver2},
+        {-wOver2, hOver2, dOver2},   {wOver2, hOver2, dOver2},
+        {wOver2, -hOver2, dOver2},   {-wOver2, hOver2, dOver2},
+        {-wOver2, -hOver2, dOver2},  {wOver2, -hOver2, dOver2},
+        {wOver2, hOver2, dOver2},    {-wOver2, hOver2, dOver2},
+        {-wOver2, -hOver2, dOver2},  {-wOver2, hOver2, -dOver2},
+        {-wOver2, -hOver2, -dOver2}, {-wOver2, -hOver2, dOver2},
+        {-wOver2, hOver2, dOver2},   {-wOver2, hOver2, -dOver2},
+        {-wOver2, -hOver2, -dOver2}, {wOver2, -hOver2, -dOver2},
+        {-wOver2, -hOver2, dOver2},  {wOver2, -hOver2, -dOver2},
+        {wOver2, -hOver2, dOver2},   {-wOver2, -hOver2, dOver2},
+    });
 }
 
 Cube::~Cube() {
     if (vbo_) {
         glDeleteBuffers(1, &vbo_);
+        GLCounters::Get().RemoveBuffer(vbo_);
     }
     if (vao_) {
         glDeleteVertexArrays(1, &vao_);
     }
 }
 
-void Cube::Render(Shader& shader, const Color& color, const glm::mat4& world,
-                  const Camera& camera) {
-    shader.Bind();
-    shader.SetParam("world", world);
-    shader.SetParam("view", camera.GetView());
-    shader.SetParam("projection", camera.GetProjection());
-    shader.SetParam("color", color);
-    glBindVertexArray(vao_);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-}
-
-void Cube::RenderRefract(Shader& shader, const Color& color,
-                         const SkyBox& skybox, const glm::mat4& world,
-                         const Camera& camera) {
-    shader.Bind();
-    shader.SetParam("world", world);
-    shader.SetParam("view", camera.GetView());
-    shader.SetParam("projection", camera.GetProjection());
-    shader.SetParam("camera_pos", camera.GetPosition());
-    shader.SetParam("color", color);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.texture);
+void Cube::Submit(RenderQueue& queue, DrawItem item,
+                  const CubeInstanceBuffer& instances) const {
+    item.vertex_array = vao_;
+    item.mode = GL_TRIANGLES;
+    item.first = 0;
+    item.count = vertex_count_;
+    item.instanced = true;
+    item.instance_count = instances.GetCount();
+    queue.Add(item);
+}
+
+namespace {
+
+// Appends two triangles of quad origin, origin + u, origin + u + v,
+// origin + v, wound counter-clockwise when seen from the normal side
+template <typename Vertex>
+void AppendQuad(std::vector<Vertex>& vertices, glm::vec3 origin, glm::vec3 u,
+                glm::vec3 v, const glm::vec3& normal, unsigned color_pack) {
+    if (glm::dot(glm::cross(u, v), normal) < 0.f) {
+        std::swap(u, v);
+    }
+    Vertex vertex;
+    vertex.normal = normal;
+    vertex.color[0] = (color_pack >> 16) & 0xff;
+    vertex.color[1] = (color_pack >> 8) & 0xff;
+    vertex.color[2] = color_pack & 0xff;
+    vertex.color[3] = 0xff;
+    for (auto corner : {origin, origin + u, origin + u + v, origin,
+                        origin + u + v, origin + v}) {
+        vertex.position = corner;
+        vertices.push_back(vertex);
+    }
+}
+
+unsigned GetBoardCell(const Board& board, int x, int y, int z) {
+    if (x < 0 || y < 0 || z < 0 || x >= board.GetWidth() ||
+        y >= board.GetHeight() || z >= board.GetDepth()) {
+        return 0;
+    }
+    return board.GetCell((x * board.GetWidth() + z) +
+                         (y * board.GetWidth() * board.GetDepth()));
+}
+
+} // namespace
+
+BoardMesh::~BoardMesh() {
+    if (vbo_) {
+        glDeleteBuffers(1, &vbo_);
+        GLCounters::Get().RemoveBuffer(vbo_);
+    }
+    if (vao_) {
+        glDeleteVertexArrays(1, &vao_);
+    }
+}
+
+void BoardMesh::Create() {
+    glGenVertexArrays(1, &vao_);
     glBindVertexArray(vao_);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glGenBuffers(1, &vbo_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex),
+                          (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(Vertex),
+                          (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, true, sizeof(Vertex),
+                          (void*)offsetof(Vertex, color));
+    glBindVertexArray(0);
+    // NOTE: Instance position (attribute 2) is disabled here, so shaders
+    // read its current value; vertices are already in world space
+    glVertexAttrib3f(2, 0.f, 0.f, 0.f);
+}
+
+void BoardMesh::Update(const Board& board) {
+    glm::ivec3 dimensions(board.GetWidth(), board.GetHeight(),
+                          board.GetDepth());
+    if (dimensions != board_dimensions_) {
+        board_dimensions_ = dimensions;
+        layers_.assign(board.GetHeight(), Layer{});
+        // Worst case: every cell of a layer exposes its 6 faces (6 quads
+        // each), with a bar cap and 4 bar sides on each
+        size_t layer_cells = static_cast<size_t>(board.GetWidth()) *
+                             board.GetDepth();
+        size_t face_vertices = layer_cells * 6 * 6;
+        size_t bar_vertices = layer_cells * 6 * 5 * 6;
+        size_t board_vertices =
+            (face_vertices + bar_vertices) * board.GetHeight();
+        if (2 * board_vertices * sizeof(Vertex) <= kMaxReservedVertexBytes) {
+            for (auto& layer : layers_) {
+                layer.faces.reserve(face_vertices);
+                layer.bars.reserve(bar_vertices);
+            }
+            vertices_.reserve(board_vertices);
+        }
+    }
+
+    auto rebuilt = false;
+    for (int y = 0; y < board.GetHeight(); ++y) {
+        auto& layer = layers_[y];
+        uint64_t revisions[3] = {
+            y > 0 ? board.GetLayerRevision(y - 1) : 0,
+            board.GetLayerRevision(y),
+            y + 1 < board.GetHeight() ? board.GetLayerRevision(y + 1) : 0,
+        };
+        if (std::equal(revisions, revisions + 3, layer.revisions)) {
+            continue;
+        }
+        std::copy(revisions, revisions + 3, layer.revisions);
+        BuildLayer(board, y, layer);
+        rebuilt = true;
+    }
+    if (rebuilt) {
+        Upload();
+    }
+}
+
+void BoardMesh::BuildLayer(const Board& board, int y, Layer& layer) {
+    layer.faces.clear();
+    layer.bars.clear();
+    auto width = board.GetWidth();
+    auto depth = board.GetDepth();
+    auto filled = [&board](int cell_x, int cell_y, int cell_z) {
+        return GetBoardCell(board, cell_x, cell_y, cell_z) != 0;
+    };
+
+    // Top and bottom faces: exposed cells of the layer are greedily merged
+    // into rectangles
+    for (int side : {1, -1}) {
+        mask_.assign(width * depth, 0);
+        for (int x = 0; x < width; ++x) {
+            for (int z = 0; z < depth; ++z) {
+                mask_[x * depth + z] =
+                    filled(x, y, z) && !filled(x, y + side, z);
+            }
+        }
+        auto plane_y = side > 0 ? y + 1.f : static_cast<float>(y);
+        for (int x = 0; x < width; ++x) {
+            for (int z = 0; z < depth; ++z) {
+                if (!mask_[x * depth + z]) {
+                    continue;
+                }
+                auto z_end = z + 1;
+                while (z_end < depth && mask_[x * depth + z_end]) {
+                    ++z_end;
+                }
+                auto x_end = x + 1;
+                while (x_end < width &&
+                       std::all_of(mask_.begin() + x_end * depth + z,
+                                   mask_.begin() + x_end * depth + z_end,
+                                   [](uint8_t value) { return value; })) {
+                    ++x_end;
+                }
+                for (auto i = x; i < x_end; ++i) {
+                    std::fill(mask_.begin() + i * depth + z,
+                              mask_.begin() + i * depth + z_end, 0);
+                }
+                AppendQuad(layer.faces, glm::vec3(x, plane_y, z),
+                           glm::vec3(x_end - x, 0.f, 0.f),
+                           glm::vec3(0.f, 0.f, z_end - z),
+                           glm::vec3(0.f, side, 0.f), 0);
+            }
+        }
+    }
+
+    // Side faces are one layer high, so runs of exposed cells are merged
+    for (int side : {1, -1}) {
+        for (int x = 0; x < width; ++x) {
+            auto plane_x = side > 0 ? x + 1.f : static_cast<float>(x);
+            for (int z = 0; z < depth;) {
+                auto z_end = z;
+                while (z_end < depth && filled(x, y, z_end) &&
+                       !filled(x + side, y, z_end)) {
+                    ++z_end;
+                }
+                if (z_end > z) {
+                    AppendQuad(layer.faces, glm::vec3(plane_x, y, z),
+                               glm::vec3(0.f, 0.f, z_end - z),
+                               glm::vec3(0.f, 1.f, 0.f),
+                               glm::vec3(side, 0.f, 0.f), 0);
+                }
+                z = std::max(z_end, z + 1);
+            }
+        }
+        for (int z = 0; z < depth; ++z) {
+            auto plane_z = side > 0 ? z + 1.f : static_cast<float>(z);
+            for (int x = 0; x < width;) {
+                auto x_end = x;
+                while (x_end < width && filled(x_end, y, z) &&
+                       !filled(x_end, y, z + side)) {
+                    ++x_end;
+                }
+                if (x_end > x) {
+                    AppendQuad(layer.faces, glm::vec3(x, y, plane_z),
+                               glm::vec3(x_end - x, 0.f, 0.f),
+                               glm::vec3(0.f, 1.f, 0.f),
+                               glm::vec3(0.f, 0.f, side), 0);
+                }
+                x = std::max(x_end, x + 1);
+            }
+        }
+    }
+
+    // Color bars: 0.8 wide square cap slightly in front of every exposed
+    // face, and its thin sides
+    const glm::ivec3 directions[] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                     {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+    for (int x = 0; x < width; ++x) {
+        for (int z = 0; z < depth; ++z) {
+            auto color = GetBoardCell(board, x, y, z);
+            if (!color) {
+                continue;
+            }
+            auto center = glm::vec3(x, y, z) + glm::vec3(0.5f);
+            for (const auto& direction : directions) {
+                auto neighbour = glm::ivec3(x, y, z) + direction;
+                if (filled(neighbour.x, neighbour.y, neighbour.z)) {
+                    continue;
+                }
+                auto normal = glm::vec3(direction);
+                auto tangent1 = direction.y ? glm::vec3(1.f, 0.f, 0.f)
+                                            : glm::vec3(0.f, 1.f, 0.f);
+                auto tangent2 = glm::cross(normal, tangent1);
+                AppendQuad(layer.bars,
+                           center + 0.505f * normal - 0.4f * tangent1 -
+                               0.4f * tangent2,
+                           0.8f * tangent1, 0.8f * tangent2, normal, color);
+                for (auto tangent : {tangent1, -tangent1, tangent2,
+                                     -tangent2}) {
+                    auto bitangent = glm::cross(normal, tangent);
+                    AppendQuad(layer.bars,
+                               center + 0.5f * normal + 0.4f * tangent -
+                                   0.4f * bitangent,
+                               0.005f * normal, 0.8f * bitangent, tangent,
+                               color);
+                }
+            }
+        }
+    }
+}
+
+void BoardMesh::Upload() {
+    vertices_.clear();
+    for (const auto& layer : layers_) {
+        vertices_.insert(vertices_.end(), layer.faces.begin(),
+                         layer.faces.end());
+    }
+    face_vertex_count_ = vertices_.size();
+    for (const auto& layer : layers_) {
+        vertices_.insert(vertices_.end(), layer.bars.begin(),
+                         layer.bars.end());
+    }
+    bar_vertex_count_ = vertices_.size() - face_vertex_count_;
+
+    auto size = vertices_.size() * sizeof(Vertex);
+    auto& counters = GLCounters::Get();
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    if (size > buffer_capacity_) {
+        // NOTE: Grown with headroom, so a rising stack does not reallocate
+        // the buffer on every merge
+        buffer_capacity_ = std::max(size * 2, buffer_capacity_);
+        glBufferData(GL_ARRAY_BUFFER, buffer_capacity_, nullptr,
+                     GL_DYNAMIC_DRAW);
+        counters.SetBufferSize(vbo_, buffer_capacity_);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices_.data());
+    counters.CountBufferUpload(size);
+}
+
+void BoardMesh::SubmitFaces(RenderQueue& queue, DrawItem item) const {
+    item.vertex_array = vao_;
+    item.mode = GL_TRIANGLES;
+    item.first = 0;
+    item.count = face_vertex_count_;
+    queue.Add(item);
+}
+
+void BoardMesh::SubmitBars(RenderQueue& queue, DrawItem item) const {
+    item.vertex_array = vao_;
+    item.mode = GL_TRIANGLES;
+    item.first = face_vertex_count_;
+    item.count = bar_vertex_count_;
+    queue.Add(item);
 }
 
 BoardBounds::~BoardBounds() {
     if (vbo_ground_) {
         glDeleteBuffers(1, &vbo_ground_);
+        GLCounters::Get().RemoveBuffer(vbo_ground_);
     }
     if (vao_ground_) {
         glDeleteVertexArrays(1, &vao_ground_);
     }
     if (vbo_wall_) {
         glDeleteBuffers(1, &vbo_wall_);
+        GLCounters::Get().RemoveBuffer(vbo_wall_);
     }
     if (vao_wall_) {
         glDeleteVertexArrays(1, &vao_wall_);
@@ -645,6 +1198,8 @@ void BoardBounds::Create(const Board& board) {
         glBindBuffer(GL_ARRAY_BUFFER, vbo_ground_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.size(),
                      vertices.data(), GL_STATIC_DRAW);
+        GLCounters::Get().SetBufferSize(vbo_ground_,
+                                        sizeof(glm::vec3) * vertices.size());
 
         glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(glm::vec3),
                               (void*)0);
@@ -673,6 +1228,8 @@ void BoardBounds::Create(const Board& board) {
         glBindBuffer(GL_ARRAY_BUFFER, vbo_wall_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.size(),
                      vertices.data(), GL_STATIC_DRAW);
+        GLCounters::Get().SetBufferSize(vbo_wall_,
+                                        sizeof(glm::vec3) * vertices.size());
 
         glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(glm::vec3),
                               (void*)0);
@@ -680,72 +1237,73 @@ void BoardBounds::Create(const Board& board) {
     }
 }
 
-void BoardBounds::Render(Shader& shader, const Color& color,
-                         const Camera& camera) {
-    // Render ground
+void BoardBounds::Submit(RenderQueue& queue, const Shader& shader,
+                         const Color& color, const Camera& camera) const {
+    DrawItem item;
+    item.program = shader.GetId();
+    item.mode = GL_LINES;
+    item.color_uniform = shader.GetUniform<Color>("color");
+    item.color = color;
+    item.world_uniform = shader.GetUniform<glm::mat4>("world");
+
+    // Ground
+    item.vertex_array = vao_ground_;
+    item.count = ground_vertex_count_;
+    queue.Add(item);
+
+    // Walls
+    item.vertex_array = vao_wall_;
+    item.count = wall_vertex_count_;
+    auto view_dir = camera.GetForward();
     {
-        shader.Bind();
-        shader.SetParam("world", glm::mat4(1.f));
-        shader.SetParam("view", camera.GetView());
-        shader.SetParam("projection", camera.GetProjection());
-        shader.SetParam("color", color);
-        glBindVertexArray(vao_ground_);
-        glDrawArrays(GL_LINES, 0, ground_vertex_count_);
+        glm::vec3 wall_dir{0, 0, 1};
+        if (glm::dot(view_dir, wall_dir) < 0.f) {
+            item.world = glm::mat4(1.f);
+            queue.Add(item);
+        }
     }
 
     {
-        auto view_dir = camera.GetForward();
-        {
-            glm::vec3 wall_dir{0, 0, 1};
-            if (glm::dot(view_dir, wall_dir) < 0.f) {
-                glBindVertexArray(vao_wall_);
-                glDrawArrays(GL_LINES, 0, wall_vertex_count_);
-            }
-        }
-
-        {
-            glm::vec3 wall_dir{1, 0, 0};
-            if (glm::dot(view_dir, wall_dir) < 0.f) {
-                glm::mat4 world(1.f);
-                world = glm::rotate(world, -glm::pi<float>() / 2,
-                                    glm::vec3(0.f, 1.f, 0.f));
-                shader.SetParam("world", world);
-                glBindVertexArray(vao_wall_);
-                glDrawArrays(GL_LINES, 0, wall_vertex_count_);
-            }
+        glm::vec3 wall_dir{1, 0, 0};
+        if (glm::dot(view_dir, wall_dir) < 0.f) {
+            glm::mat4 world(1.f);
+            world = glm::rotate(world, -glm::pi<float>() / 2,
+                                glm::vec3(0.f, 1.f, 0.f));
+            item.world = world;
+            queue.Add(item);
         }
+    }
 
-        {
-            glm::vec3 wall_dir{0, 0, -1};
-            if (glm::dot(view_dir, wall_dir) < 0.f) {
-                glm::mat4 world(1.f);
-                world = glm::translate(
-                    world, glm::vec3(0.f, 0.f, board_dimensions_.z));
-                shader.SetParam("world", world);
-                glBindVertexArray(vao_wall_);
-                glDrawArrays(GL_LINES, 0, wall_vertex_count_);
-            }
+    {
+        glm::vec3 wall_dir{0, 0, -1};
+        if (glm::dot(view_dir, wall_dir) < 0.f) {
+            glm::mat4 world(1.f);
+            world = glm::translate(world,
+                                   glm::vec3(0.f, 0.f, board_dimensions_.z));
+            item.world = world;
+            queue.Add(item);
         }
+    }
 
-        {
-            glm::vec3 wall_dir{-1, 0, 0};
-            if (glm::dot(view_dir, wall_dir) < 0.f) {
-                glm::mat4 world(1.f);
-                world = glm::rotate(world, -glm::pi<float>() / 2,
-                                    glm::vec3(0.f, 1.f, 0.f));
-                world = glm::translate(
-                    world, glm::vec3(0.f, 0.f, -board_dimensions_.z));
-                shader.SetParam("world", world);
-                glBindVertexArray(vao_wall_);
-                glDrawArrays(GL_LINES, 0, wall_vertex_count_);
-            }
+    {
+        glm::vec3 wall_dir{-1, 0, 0};
+        if (glm::dot(view_dir, wall_dir) < 0.f) {
+            glm::mat4 world(1.f);
+            world = glm::rotate(world, -glm::pi<float>() / 2,
+                                glm::vec3(0.f, 1.f, 0.f));
+            world = glm::translate(world,
+                                   glm::vec3(0.f, 0.f, -board_dimensions_.z));
+            item.world = world;
+            queue.Add(item);
         }
     }
 }
 
 SkyBox::~SkyBox() {}
 
-void SkyBox::Create() {
+void SkyBox::Create(unsigned environment_size) {
+    environment_size_ = environment_size;
+
     float vertices[] = {
         -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,
         -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f,
@@ -764,77 +1322,218 @@ void SkyBox::Create() {
     glBindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
+    GLCounters::Get().SetBufferSize(vbo, sizeof(vertices));
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(float), (void*)0);
 
+    load_start_ = std::chrono::steady_clock::now();
+    // NOTE: Packed bundle (make assets) needs no decoding; JPEG images are
+    // the fallback when it is missing or not usable
+    if (LoadBundle("data/skybox/skybox.bundle")) {
+        auto elapsed = std::chrono::steady_clock::now() - load_start_;
+        printf("Skybox loaded from bundle in %.0f ms\n",
+               std::chrono::duration<double, std::milli>(elapsed).count());
+        return;
+    }
+
+    // NOTE: Placeholder is close to the average color of the skybox, so
+    // the swap is barely visible
+    const uint8_t placeholder[3] = {46, 36, 31};
+    texture = CreateCubemapTexture();
+    for (unsigned i = 0; i < 6; ++i) {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, 1, 1, 0,
+                     GL_RGB, GL_UNSIGNED_BYTE, placeholder);
+    }
+    GLCounters::Get().AddTextureSize(texture, 6 * 4);
+
+    // Load order: X, -X, Y, -Y, Z, -Z
     std::vector<std::string> paths = {
         "data/skybox/right.jpg", "data/skybox/left.jpg",
         "data/skybox/top.jpg",   "data/skybox/bottom.jpg",
         "data/skybox/front.jpg", "data/skybox/back.jpg",
     };
-    texture = LoadCubemap(paths);
+    loading_texture_ = CreateCubemapTexture();
+    if (environment_size_) {
+        loading_environment_texture_ = CreateCubemapTexture();
+    }
+    loader_ = std::make_unique<CubemapLoader>(paths, environment_size_);
 }
 
-void SkyBox::Render(Shader& shader, const Camera& camera) {
-    shader.Bind();
-    shader.SetParam("skybox", 0);
-    shader.SetParam("color", color);
+void SkyBox::Update() {
+    if (loader_ && loader_->UploadNextFace(loading_texture_,
+                                           loading_environment_texture_)) {
+        OnLoaded();
+    }
+}
 
-    glDepthFunc(GL_LEQUAL);
-    auto view_no_translation = glm::mat4(glm::mat3(camera.GetView()));
-    shader.SetParam("view", view_no_translation);
-    shader.SetParam("projection", camera.GetProjection());
-    glBindVertexArray(vao);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS);
+void SkyBox::FinishLoading() {
+    if (loader_) {
+        loader_->UploadAll(loading_texture_, loading_environment_texture_);
+        OnLoaded();
+    }
 }
 
-unsigned SkyBox::LoadCubemap(const std::vector<std::string>& paths) {
-    unsigned id;
-    glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+void SkyBox::OnLoaded() {
+    glDeleteTextures(1, &texture);
+    GLCounters::Get().RemoveTexture(texture);
+    texture = loading_texture_;
+    environment_texture = loading_environment_texture_;
+    loading_texture_ = 0;
+    loading_environment_texture_ = 0;
+    GenerateCubemapMipmaps(texture);
+    if (environment_texture) {
+        GenerateCubemapMipmaps(environment_texture);
+    }
+    loader_.reset();
+    auto elapsed = std::chrono::steady_clock::now() - load_start_;
+    printf("Skybox loaded from images in %.0f ms\n",
+           std::chrono::duration<double, std::milli>(elapsed).count());
+}
+
+bool SkyBox::LoadBundle(const std::string& path) {
+    // NOTE: No bundle is the usual case of a fresh checkout, not an error
+    if (access(path.c_str(), R_OK) != 0) {
+        return false;
+    }
+    CubemapBundleReader reader;
+    try {
+        reader.Open(path);
+    } catch (const Error& error) {
+        printf("%s\n", error.what());
+        return false;
+    }
+    const auto& header = reader.GetHeader();
+    auto compressed = header.format == CubemapBundleFormat::Bc1;
+    if (compressed && !HasExtension("GL_EXT_texture_compression_s3tc")) {
+        printf("No S3TC support for compressed skybox bundle\n");
+        return false;
+    }
 
-    int width, height, nr_components;
-    for (unsigned int i = 0; i < paths.size(); i++) {
-        unsigned char* data =
-            stbi_load(paths[i].c_str(), &width, &height, &nr_components, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width,
-                         height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        } else {
-            printf("Texuture load failure: %s\n", paths[i].c_str());
-            stbi_image_free(data);
+    // Uploads levels from first_level on as a new mipmapped cubemap
+    auto& counters = GLCounters::Get();
+    auto upload = [&](unsigned first_level) {
+        auto id = CreateCubemapTexture();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (auto level = first_level; level < header.level_count; ++level) {
+            auto size = header.face_size >> level;
+            for (unsigned face = 0; face < 6; ++face) {
+                size_t image_size = 0;
+                auto image = reader.GetImage(level, face, image_size);
+                auto target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+                if (compressed) {
+                    glCompressedTexImage2D(
+                        target, level - first_level, kCompressedRgbS3tcDxt1,
+                        size, size, 0, image_size, image);
+                    counters.AddTextureSize(id, image_size);
+                } else {
+                    glTexImage2D(target, level - first_level, GL_RGB, size,
+                                 size, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+                    counters.AddTextureSize(id, size * size * 4);
+                }
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL,
+                        header.level_count - 1 - first_level);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR);
+        return id;
+    };
+    texture = upload(0);
+    // NOTE: Bundle levels are already prefiltered, so the environment is
+    // just the tail of the mipmap chain
+    for (unsigned level = 1; level < header.level_count; ++level) {
+        if ((header.face_size >> level) == environment_size_) {
+            environment_texture = upload(level);
         }
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return true;
+}
 
-    return id;
+// NOTE: Vertex shader drops the view translation itself
+void SkyBox::Submit(RenderQueue& queue, DrawItem item) const {
+    item.texture = texture;
+    item.vertex_array = vao;
+    item.mode = GL_TRIANGLES;
+    item.first = 0;
+    item.count = 36;
+    item.color = color;
+    queue.Add(item);
+}
+
+CameraUniformBuffer::~CameraUniformBuffer() {
+    if (ubo_) {
+        glDeleteBuffers(1, &ubo_);
+        GLCounters::Get().RemoveBuffer(ubo_);
+    }
+}
+
+void CameraUniformBuffer::Create() {
+    glGenBuffers(1, &ubo_);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), nullptr, GL_DYNAMIC_DRAW);
+    GLCounters::Get().SetBufferSize(ubo_, sizeof(Data));
+    glBindBufferBase(GL_UNIFORM_BUFFER, kBinding, ubo_);
+}
+
+void CameraUniformBuffer::Update(const Camera& camera) {
+    Data data;
+    data.view = camera.GetView();
+    data.projection = camera.GetProjection();
+    data.position = glm::vec4(camera.GetPosition(), 1.f);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), &data);
+    GLCounters::Get().CountBufferUpload(sizeof(data));
 }
 
 AdvancedRenderer::AdvancedRenderer(Config& config) : config_(config) {}
 
+AdvancedRenderer::~AdvancedRenderer() {}
+
 void AdvancedRenderer::StartUp(const GameState& state) {
     solid_shader_.Create(solid_vs, solid_fs);
     solid_wire_shader_.Create(solid_wire_vs, solid_wire_fs);
     refract_shader_.Create(refract_vs, refract_fs);
     skybox_shader_.Create(skybox_vs, skybox_fs);
-    tetris_cube_.Create(1.f, 1.f, 1.f);
+    for (auto* shader : {&solid_shader_, &solid_wire_shader_,
+                         &refract_shader_, &skybox_shader_}) {
+        shader->BindUniformBlock("Camera", CameraUniformBuffer::kBinding);
+    }
+    solid_color_uniform_ = solid_shader_.GetUniform<Color>("color");
+    camera_uniforms_.Create();
+    cube_instances_.Create();
+    projection_instances_.Create();
+    // NOTE: Tetris cube is a dark box with three color bars poking out of
+    // its faces
+    tetris_cube_.Create({glm::vec3(1.f, 1.f, 1.f)}, cube_instances_);
+    tetris_cube_bars_.Create({glm::vec3(1.01f, 0.8f, 0.8f),
+                              glm::vec3(0.8f, 1.01f, 0.8f),
+                              glm::vec3(0.8f, 0.8f, 1.01f)},
+                             cube_instances_);
+    projection_cube_.Create({glm::vec3(1.f, 1.f, 1.f)}, projection_instances_);
+    board_mesh_.Create();
     board_bounds_.Create(state.board);
-    skybox_.Create();
+    skybox_.Create(GetEnvironmentSize(config_.graphics_environment_quality));
+    // NOTE: Low resolution environment levels would show face seams
+    // otherwise
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    skybox_shader_.Bind();
+    skybox_shader_.SetParam("skybox", 0);
+    hud_ = std::make_unique<PerformanceHud>();
+    hud_->Create();
+    hud_->SetVisible(config_.hud_visible);
 }
 
 void AdvancedRenderer::Render(const GameState& state,
                               const PerspectiveCamera& camera) {
     glViewport(0, 0, framebuffer_width_, framebuffer_height_);
+    GLCounters::Get().BeginFrame();
+    hud_->BeginFrame();
 
+    {
+        ProfileScope scope("skybox upload");
+        skybox_.Update();
+    }
     if (state.phase == GameState::Phase::Lost) {
         skybox_.color = {0.9f, 0.1f, 0.1f, 1.f};
     } else if (state.phase == GameState::Phase::LayersErase) {
@@ -855,15 +1554,45 @@ void AdvancedRenderer::Render(const GameState& state,
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    board_bounds_.Render(solid_wire_shader_, Color{0.3f, 0.3f, 0.3f}, camera);
-
-    RenderBoard(state.board, camera);
-    RenderFallingBlock(state.falling_block, camera);
+    camera_uniforms_.Update(camera);
+    {
+        ProfileScope scope("bounds");
+        board_bounds_.Submit(render_queue_, solid_wire_shader_,
+                             Color{0.3f, 0.3f, 0.3f}, camera);
+    }
+    {
+        ProfileScope scope("board");
+        board_mesh_.Update(state.board);
+    }
+    {
+        ProfileScope scope("falling block");
+        UpdateCubeInstances(state);
+    }
+    SubmitCubes();
     if (state.phase == GameState::Phase::BlockFalling) {
-        RenderFallingBlockProjection(state, camera);
+        ProfileScope scope("ghost");
+        SubmitFallingBlockProjection(state);
     }
 
-    skybox_.Render(skybox_shader_, camera);
+    {
+        ProfileScope scope("skybox");
+        DrawItem item;
+        item.pass = RenderPass::Background;
+        item.program = skybox_shader_.GetId();
+        item.color_uniform = skybox_shader_.GetUniform<Color>("color");
+        skybox_.Submit(render_queue_, item);
+    }
+
+    {
+        ProfileScope scope("render queue");
+        render_queue_.Submit();
+    }
+
+    {
+        ProfileScope scope("hud");
+        hud_->Draw(framebuffer_width_, framebuffer_height_,
+                   render_queue_.GetStats());
+    }
 
     // TODO(panmar): Make error checking more verbose
     {
@@ -875,39 +1604,34 @@ void AdvancedRenderer::Render(const GameState& state,
     }
 }
 
-void AdvancedRenderer::RenderBoard(const Board& board, const Camera& camera) {
-    for (size_t k = 0; k < board.GetHeight(); ++k) {
-        for (size_t i = 0; i < board.GetWidth(); ++i) {
-            for (size_t j = 0; j < board.GetDepth(); ++j) {
-                auto index = (i * board.GetWidth() + j) +
-                             (k * board.GetWidth() * board.GetDepth());
-                if (board.GetCell(index)) {
-                    auto position = glm::vec3(i, k, j);
-                    Color color = FromPackedColorToColor(board.GetCell(index));
-                    RenderTetrisCube(position + glm::vec3(0.5f, 0.5f, 0.5f),
-                                     color, camera);
-                }
-            }
-        }
-    }
-}
-
-void AdvancedRenderer::RenderFallingBlock(const Block& block,
-                                          const Camera& camera) {
-    Color color;
-    color.r = block.GetColor().r / 255.f;
-    color.g = block.GetColor().g / 255.f;
-    color.b = block.GetColor().b / 255.f;
-
+void AdvancedRenderer::UpdateCubeInstances(const GameState& state) {
+    instances_.clear();
+    const auto& block = state.falling_block;
+    auto block_color = PackColor(block.GetColor());
     for (auto& offset : block.GetCubeOffsets()) {
         auto position = glm::vec3(block.GetPosition() + offset) +
                         glm::vec3(0.5f, 0.5f, 0.5f);
-        RenderTetrisCube(position, color, camera);
+        instances_.push_back(MakeCubeInstance(position, block_color));
     }
+    cube_instances_.Upload(instances_);
+}
+
+void AdvancedRenderer::SubmitCubes() {
+    DrawItem solid;
+    solid.program = solid_shader_.GetId();
+    solid.color_uniform = solid_color_uniform_;
+    solid.color = Color{0.1f, 0.1f, 0.1f};
+    board_mesh_.SubmitFaces(render_queue_, solid);
+    tetris_cube_.Submit(render_queue_, solid, cube_instances_);
+
+    DrawItem refract;
+    refract.program = refract_shader_.GetId();
+    refract.texture = skybox_.GetEnvironmentTexture();
+    board_mesh_.SubmitBars(render_queue_, refract);
+    tetris_cube_bars_.Submit(render_queue_, refract, cube_instances_);
 }
 
-void AdvancedRenderer::RenderFallingBlockProjection(const GameState& state,
-                                                    const Camera& camera) {
+void AdvancedRenderer::SubmitFallingBlockProjection(const GameState& state) {
     auto projected_block = state.falling_block;
     while (projected_block.IsValid(state.board)) {
         projected_block.Translate(glm::ivec3(0, -1, 0));
@@ -916,54 +1640,24 @@ void AdvancedRenderer::RenderFallingBlockProjection(const GameState& state,
 
     Color color{0.9, 0.9f, 0.9f, 0.6f};
 
-    glColorMask(false, false, false, false);
+    instances_.clear();
     for (auto& offset : projected_block.GetCubeOffsets()) {
-        RenderCube(glm::vec3(projected_block.GetPosition() + offset) +
-                       glm::vec3(0.5f, 0.5f, 0.5f),
-                   color, glm::vec3(1.f, 1.f, 1.f), camera);
+        instances_.push_back(MakeCubeInstance(
+            glm::vec3(projected_block.GetPosition() + offset) +
+                glm::vec3(0.5f, 0.5f, 0.5f),
+            0));
     }
-
-    glColorMask(true, true, true, true);
-    glDepthFunc(GL_LEQUAL);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for (auto& offset : projected_block.GetCubeOffsets()) {
-        RenderCube(glm::vec3(projected_block.GetPosition() + offset) +
-                       glm::vec3(0.5f, 0.5f, 0.5f),
-                   color, glm::vec3(1.f, 1.f, 1.f), camera);
-    }
-    glDisable(GL_BLEND);
-    glDepthFunc(GL_LESS);
-}
-
-void AdvancedRenderer::RenderTetrisCube(const glm::vec3& pos,
-                                        const Color& color,
-                                        const Camera& camera) {
-    Color cube_edge_color{0.1f, 0.1f, 0.1f};
-    RenderCube(pos, cube_edge_color, glm::vec3(1.0f, 1.0f, 1.0f), camera);
-    RenderRefractCube(pos, color, glm::vec3(1.01f, 0.8f, 0.8f), camera);
-    RenderRefractCube(pos, color, glm::vec3(0.8f, 1.01f, 0.8f), camera);
-    RenderRefractCube(pos, color, glm::vec3(0.8f, 0.8f, 1.01f), camera);
-}
-
-void AdvancedRenderer::RenderCube(const glm::vec3& position, const Color& color,
-                                  const glm::vec3& scale,
-                                  const Camera& camera) {
-
-    glm::mat4 world(1.f);
-    world = glm::translate(world, position);
-    world = glm::scale(world, scale);
-    tetris_cube_.Render(solid_shader_, color, world, camera);
-}
-
-void AdvancedRenderer::RenderRefractCube(const glm::vec3& position,
-                                         const Color& color,
-                                         const glm::vec3& scale,
-                                         const Camera& camera) {
-    glm::mat4 world(1.f);
-    world = glm::translate(world, position);
-    world = glm::scale(world, scale);
-    tetris_cube_.RenderRefract(refract_shader_, color, skybox_, world, camera);
+    projection_instances_.Upload(instances_);
+
+    // NOTE: Depth prepass leaves only the nearest faces for blending
+    DrawItem item;
+    item.pass = RenderPass::DepthPrepass;
+    item.program = solid_shader_.GetId();
+    item.color_uniform = solid_color_uniform_;
+    item.color = color;
+    projection_cube_.Submit(render_queue_, item, projection_instances_);
+    item.pass = RenderPass::Transparent;
+    projection_cube_.Submit(render_queue_, item, projection_instances_);
 }
 
 } // namespace tetris3d
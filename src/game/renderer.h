@@ -1,6 +1,11 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "glad/glad.h"
 #define GLFW_INCLUDE_GLU
@@ -10,10 +15,14 @@
 #include "config.h"
 #include "game/camera.h"
 #include "game/board.h"
+#include "game/cubemap_loader.h"
+#include "game/render_queue.h"
 #include "game/state.h"
 
 namespace tetris3d {
 
+class PerformanceHud;
+
 class IRenderer {
 public:
     virtual ~IRenderer() = default;
@@ -22,13 +31,24 @@ public:
                         const PerspectiveCamera& camera) = 0;
     virtual void SetFramebufferWidth(int value) = 0;
     virtual void SetFramebufferHeight(int value) = 0;
+    // Performance overlay; null if the renderer has none
+    virtual PerformanceHud* GetHud() { return nullptr; }
+};
+
+// Vertex of fixed function vertex arrays (vertex and color arrays)
+struct ColoredVertex {
+    glm::vec3 position;
+    uint8_t color[4];
 };
 
 // OpenGL 2.1 renderer
+// NOTE: Board and bounds geometry lives in buffers rebuilt only when the
+// board changes; falling block is drawn from client-side vertex arrays
 class BasicRenderer : public IRenderer {
 public:
-    ~BasicRenderer() {}
+    ~BasicRenderer();
     BasicRenderer(Config&);
+    void StartUp(const GameState& state) override;
     void Render(const GameState& state,
                 const PerspectiveCamera& camera) override;
 
@@ -40,26 +60,77 @@ public:
 
     void RenderBounds(const Board& board, const glm::vec3& view_dir);
 
-    void RenderCube(const glm::vec3& position, const Color& color, float width,
-                    float depth, float height);
-
-    void RenderTetrisCube(const glm::vec3& pos, const Color& color);
-
     void SetFramebufferWidth(int value) override { framebuffer_width_ = value; }
     void SetFramebufferHeight(int value) override {
         framebuffer_height_ = value;
     }
 
 private:
+    // First vertex and vertex count of a part of a buffer
+    struct VertexRange {
+        int first = 0;
+        int count = 0;
+    };
+
+    void UpdateBoardBuffer(const Board& board);
+    void UpdateBoundsBuffer(const Board& board);
+    // Points vertex and color arrays at the buffer, or at client memory if
+    // buffer is zero
+    void SetVertexPointers(unsigned buffer, const ColoredVertex* vertices);
+
+    static void AppendVertex(const glm::vec3& position, const Color& color,
+                             std::vector<ColoredVertex>& vertices);
+    static void AppendCube(const glm::vec3& position, const Color& color,
+                           float width, float depth, float height,
+                           std::vector<ColoredVertex>& vertices);
+    static void AppendTetrisCube(const glm::vec3& pos, const Color& color,
+                                 std::vector<ColoredVertex>& vertices);
+
     Config& config_;
     int framebuffer_width_ = 0;
     int framebuffer_height_ = 0;
+
+    std::vector<ColoredVertex> vertices_;
+    unsigned board_vbo_ = 0;
+    unsigned board_vertex_count_ = 0;
+    std::vector<uint64_t> board_revisions_;
+    unsigned bounds_vbo_ = 0;
+    glm::ivec3 bounds_dimensions_{0, 0, 0};
+    // Ground, then walls at z = 0, x = 0, z = depth, x = width
+    VertexRange bounds_ranges_[5];
 };
 
 class Shader {
 public:
     ~Shader();
     void Create(const std::string& vs_str, const std::string& fs_str);
+
+    // NOTE: Handle of an unknown (or optimized out) uniform is -1, which GL
+    // silently ignores
+    template <typename T> ShaderUniform<T> GetUniform(const char* name) const {
+        return ShaderUniform<T>{GetUniformLocation(name)};
+    }
+    // Connects uniform block of the program to a buffer binding point
+    void BindUniformBlock(const char* name, unsigned binding) const;
+
+    void SetParam(ShaderUniform<bool> uniform, bool value) const;
+    void SetParam(ShaderUniform<int> uniform, int value) const;
+    void SetParam(ShaderUniform<float> uniform, float value) const;
+    void SetParam(ShaderUniform<glm::vec2> uniform,
+                  const glm::vec2& value) const;
+    void SetParam(ShaderUniform<glm::vec3> uniform,
+                  const glm::vec3& value) const;
+    void SetParam(ShaderUniform<glm::vec4> uniform,
+                  const glm::vec4& value) const;
+    void SetParam(ShaderUniform<glm::mat2> uniform,
+                  const glm::mat2& value) const;
+    void SetParam(ShaderUniform<glm::mat3> uniform,
+                  const glm::mat3& value) const;
+    void SetParam(ShaderUniform<glm::mat4> uniform,
+                  const glm::mat4& value) const;
+    void SetParam(ShaderUniform<Color> uniform, const Color& color) const;
+
+    // Name based setters look the location up in the reflected table
     void SetParam(const char* name, bool value) const;
     void SetParam(const char* name, int value) const;
     void SetParam(const char* name, float value) const;
@@ -74,47 +145,180 @@ public:
     void SetParam(const char* name, const glm::mat4& value) const;
     void SetParam(const char* name, const Color& color) const;
     void Bind();
+    unsigned GetId() const { return id_; }
 
 private:
+    void ReflectUniforms();
+    int GetUniformLocation(const char* name) const;
     bool LogShaderErrorsIfAny(unsigned shader);
     bool LogProgramErrorsIfAny(unsigned shader);
     unsigned id_ = 0;
+    std::unordered_map<std::string, int> uniform_locations_;
 };
 
-class SkyBox {
+// Camera uniform block (std140) shared by all shaders, updated once per
+// frame:
+// ----
+// mat4 view, mat4 projection, vec4 camera_position
+// ----
+class CameraUniformBuffer {
 public:
-    ~SkyBox();
+    static inline constexpr unsigned kBinding = 0;
+
+    ~CameraUniformBuffer();
     void Create();
-    void Render(Shader& shader, const Camera& camera);
+    void Update(const Camera& camera);
 
-    // Load order: X, -X, Y, -Y, Z, -Z
-    unsigned LoadCubemap(const std::vector<std::string>& paths);
+private:
+    struct Data {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 position;
+    };
+
+    unsigned ubo_ = 0;
+};
+
+// NOTE: Cubemap comes from a packed bundle if there is one; otherwise faces
+// are decoded from JPEG images in background, and until all of them are
+// uploaded, a solid color placeholder cubemap is drawn instead
+class SkyBox {
+public:
+    ~SkyBox();
+    // @environment_size size of the environment cubemap faces; zero makes
+    // it the skybox cubemap itself
+    void Create(unsigned environment_size);
+    // Uploads faces decoded since the last frame; swaps in the cubemap once
+    // it is complete
+    void Update();
+    // Blocks until the cubemap is complete (e.g. for offscreen rendering)
+    void FinishLoading();
+    bool IsLoaded() const { return !loader_; }
+    // @item pass, program and uniforms of the draw
+    void Submit(RenderQueue& queue, DrawItem item) const;
+    // Mipmapped, low resolution cubemap for reflections, so small cubes do
+    // not sample the full resolution skybox
+    unsigned GetEnvironmentTexture() const {
+        return environment_texture ? environment_texture : texture;
+    }
 
     Color color = Color{1.f, 1.f, 1.f, 1.f};
     unsigned vao = 0;
     unsigned vbo = 0;
     unsigned texture = 0;
+    // Zero if the environment is the skybox texture itself
+    unsigned environment_texture = 0;
+
+private:
+    // Uploads the whole cubemap from a packed bundle (tetris3d-pack-skybox);
+    // returns false if there is none or it cannot be used
+    bool LoadBundle(const std::string& path);
+    void OnLoaded();
+
+    unsigned environment_size_ = 0;
+    std::unique_ptr<CubemapLoader> loader_;
+    unsigned loading_texture_ = 0;
+    unsigned loading_environment_texture_ = 0;
+    std::chrono::steady_clock::time_point load_start_;
+};
+
+// Per-instance vertex attributes of a cube drawn instanced
+struct CubeInstance {
+    // Cube center in world space
+    glm::vec3 position;
+    // RGBA, normalized by the vertex fetch
+    uint8_t color[4];
+};
+
+CubeInstance MakeCubeInstance(const glm::vec3& position, unsigned color_pack);
+
+// Instance data streamed every frame
+class CubeInstanceBuffer {
+public:
+    ~CubeInstanceBuffer();
+    void Create();
+    void Upload(const std::vector<CubeInstance>& instances);
+
+    unsigned GetBuffer() const { return vbo_; }
+    unsigned GetCount() const { return count_; }
+
+private:
+    unsigned vbo_ = 0;
+    unsigned count_ = 0;
 };
 
+// Boxes centered at the origin (position, normal attributes), drawn once per
+// instance of the buffer given on creation in a single draw call
 class Cube {
 public:
-    void Create(float width, float depth, float height);
+    // @box_sizes width, height, depth of every box
+    void Create(const std::vector<glm::vec3>& box_sizes,
+                const CubeInstanceBuffer& instances);
     ~Cube();
-    void Render(Shader& shader, const Color& color, const glm::mat4& world,
-                const Camera& camera);
-    void RenderRefract(Shader& shader, const Color& color, const SkyBox& skybox,
-                       const glm::mat4& world, const Camera& camera);
+    // @item pass, program, texture and uniforms of the draw
+    void Submit(RenderQueue& queue, DrawItem item,
+                const CubeInstanceBuffer& instances) const;
 
 private:
+    static void AppendBox(float width, float depth, float height,
+                          std::vector<glm::vec3>& positions);
+
     unsigned vbo_ = 0;
     unsigned vao_ = 0;
+    unsigned vertex_count_ = 0;
+};
+
+// Settled board cubes as one mesh of exposed faces only: dark cube faces
+// greedily merged into rectangles, plus a color bar cap for every exposed
+// cube face (same look as tetris cube drawn by Cube); rebuilt only for
+// layers changed since last update
+class BoardMesh {
+public:
+    ~BoardMesh();
+    void Create();
+    // Rebuilds changed layers and their neighbours (their top and bottom
+    // faces depend on it); uploads vertices only if anything was rebuilt
+    void Update(const Board& board);
+    // Dark cube faces (position attribute)
+    void SubmitFaces(RenderQueue& queue, DrawItem item) const;
+    // Color bars (position, normal, color attributes)
+    void SubmitBars(RenderQueue& queue, DrawItem item) const;
+
+private:
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        uint8_t color[4];
+    };
+
+    struct Layer {
+        // Revisions of layer below, this one and above when it was built
+        uint64_t revisions[3] = {0, 0, 0};
+        std::vector<Vertex> faces;
+        std::vector<Vertex> bars;
+    };
+
+    void BuildLayer(const Board& board, int y, Layer& layer);
+    void Upload();
+
+    glm::ivec3 board_dimensions_{0, 0, 0};
+    std::vector<Layer> layers_;
+    std::vector<Vertex> vertices_;
+    std::vector<uint8_t> mask_;
+    unsigned vbo_ = 0;
+    unsigned vao_ = 0;
+    size_t buffer_capacity_ = 0;
+    unsigned face_vertex_count_ = 0;
+    unsigned bar_vertex_count_ = 0;
 };
 
 class BoardBounds {
 public:
     ~BoardBounds();
     void Create(const Board& board);
-    void Render(Shader& shader, const Color& color, const Camera& camera);
+    // Ground and walls behind the board from camera point of view
+    void Submit(RenderQueue& queue, const Shader& shader, const Color& color,
+                const Camera& camera) const;
 
 private:
     unsigned vbo_wall_ = 0;
@@ -130,7 +334,7 @@ private:
 class AdvancedRenderer : public IRenderer {
 public:
     AdvancedRenderer(Config&);
-    ~AdvancedRenderer() {}
+    ~AdvancedRenderer();
     void StartUp(const GameState& state) override;
     void Render(const GameState& state,
                 const PerspectiveCamera& camera) override;
@@ -138,19 +342,24 @@ public:
     void SetFramebufferHeight(int value) override {
         framebuffer_height_ = value;
     }
+    PerformanceHud* GetHud() override { return hud_.get(); }
+
+    // Blocks until background loading of assets (skybox) is finished, so
+    // the next frame is final
+    void FinishLoading() { skybox_.FinishLoading(); }
+
+    // Draw calls and state changes of the last rendered frame
+    const RenderStats& GetRenderStats() const {
+        return render_queue_.GetStats();
+    }
 
 private:
-    void RenderBoard(const Board& board, const Camera& camera);
-    void RenderFallingBlock(const Block& block, const Camera& camera);
-    void RenderFallingBlockProjection(const GameState& state,
-                                      const Camera& camera);
-    void RenderTetrisCube(const glm::vec3& pos, const Color& color,
-                          const Camera& camera);
-    void RenderCube(const glm::vec3& position, const Color& color,
-                    const glm::vec3& scale, const Camera& camera);
-
-    void RenderRefractCube(const glm::vec3& position, const Color& color,
-                           const glm::vec3& scale, const Camera& camera);
+    // Collects falling block cubes; settled cubes are in board_mesh_
+    void UpdateCubeInstances(const GameState& state);
+    // NOTE: Cubes are drawn twice: dark boxes, then color bars; each is one
+    // board mesh draw and one instanced draw of the falling block
+    void SubmitCubes();
+    void SubmitFallingBlockProjection(const GameState& state);
 
     Config config_;
     int framebuffer_width_ = 0;
@@ -160,9 +369,19 @@ private:
     Shader solid_wire_shader_;
     Shader refract_shader_;
     Shader skybox_shader_;
+    RenderQueue render_queue_;
+    CameraUniformBuffer camera_uniforms_;
+    ShaderUniform<Color> solid_color_uniform_;
+    CubeInstanceBuffer cube_instances_;
+    CubeInstanceBuffer projection_instances_;
+    std::vector<CubeInstance> instances_;
     Cube tetris_cube_;
+    Cube tetris_cube_bars_;
+    Cube projection_cube_;
+    BoardMesh board_mesh_;
     BoardBounds board_bounds_;
     SkyBox skybox_;
+    std::unique_ptr<PerformanceHud> hud_;
 };
 
 } // namespace tetris3d
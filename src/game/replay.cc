@@ -0,0 +1,230 @@
+#include "game/replay.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "game/state_io.h"
+
+namespace tetris3d {
+
+static_assert(sizeof(ReplayFrame) == 20, "ReplayFrame is stored verbatim");
+
+ReplayWriter::~ReplayWriter() { Close(); }
+
+void ReplayWriter::Open(const std::string& path, const Config& config) {
+    Close();
+    if (config.replay_keyframe_interval_ticks <= 0) {
+        throw Error("Replay keyframe interval must be positive");
+    }
+
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        throw Error("Cannot open replay file for writing: " + path);
+    }
+
+    offset_ = 0;
+    tick_count_ = 0;
+    index_.clear();
+    keyframe_interval_ = config.replay_keyframe_interval_ticks;
+
+    ReplayHeader header;
+    header.map_width = config.map_width;
+    header.map_depth = config.map_depth;
+    header.map_height = config.map_height;
+    header.keyframe_interval = keyframe_interval_;
+    Write(&header, sizeof(header));
+}
+
+void ReplayWriter::Record(const GameState& state, const ReplayFrame& frame) {
+    assert(IsOpen());
+
+    if (tick_count_ % keyframe_interval_ == 0) {
+        keyframe_buffer_.clear();
+        ByteWriter writer(keyframe_buffer_);
+        WriteGameState(writer, state);
+
+        ReplayIndexEntry entry;
+        entry.tick = tick_count_;
+        entry.keyframe_offset = offset_;
+        uint32_t state_size = keyframe_buffer_.size();
+        Write(&state_size, sizeof(state_size));
+        Write(keyframe_buffer_.data(), keyframe_buffer_.size());
+        entry.frames_offset = offset_;
+        index_.push_back(entry);
+    }
+
+    Write(&frame, sizeof(frame));
+    ++tick_count_;
+}
+
+void ReplayWriter::Close() {
+    if (!IsOpen()) {
+        return;
+    }
+
+    ReplayTrailer trailer;
+    trailer.index_offset = offset_;
+    trailer.index_count = index_.size();
+    trailer.tick_count = tick_count_;
+    Write(index_.data(), index_.size() * sizeof(ReplayIndexEntry));
+    Write(&trailer, sizeof(trailer));
+    file_.close();
+}
+
+void ReplayWriter::Write(const void* data, size_t size) {
+    file_.write(static_cast<const char*>(data), size);
+    offset_ += size;
+}
+
+ReplayReader::~ReplayReader() { Close(); }
+
+void ReplayReader::Open(const std::string& path) {
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw Error("Cannot open replay file: " + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<size_t>(file_stat.st_size) <
+            sizeof(ReplayHeader) + sizeof(ReplayTrailer)) {
+        close(fd);
+        throw Error("Replay file is truncated: " + path);
+    }
+    size_ = file_stat.st_size;
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw Error("Cannot map replay file: " + path);
+    }
+    data_ = static_cast<const uint8_t*>(data);
+
+    std::memcpy(&header_, data_, sizeof(header_));
+    std::memcpy(&trailer_, data_ + size_ - sizeof(trailer_), sizeof(trailer_));
+
+    // NOTE: Missing index means the writer did not finish (e.g. crashed)
+    auto index_end = size_ - sizeof(trailer_);
+    auto valid = std::memcmp(header_.magic, ReplayHeader().magic, 4) == 0 &&
+                 std::memcmp(trailer_.magic, ReplayTrailer().magic, 4) == 0 &&
+                 header_.version == ReplayHeader().version &&
+                 header_.keyframe_interval != 0 &&
+                 trailer_.index_offset >= sizeof(header_) &&
+                 trailer_.index_offset <= index_end &&
+                 trailer_.index_count <=
+                     (index_end - trailer_.index_offset) /
+                         sizeof(ReplayIndexEntry) &&
+                 (trailer_.index_count > 0 || trailer_.tick_count == 0);
+    if (valid) {
+        index_.resize(trailer_.index_count);
+        std::memcpy(index_.data(), data_ + trailer_.index_offset,
+                    index_.size() * sizeof(ReplayIndexEntry));
+        valid = IsIndexValid();
+    }
+    if (!valid) {
+        Close();
+        throw Error("Replay file is corrupted or has no index: " + path);
+    }
+}
+
+// NOTE: Offsets and ticks are checked once, so keyframes and frames are
+// never read past the mapping
+bool ReplayReader::IsIndexValid() const {
+    // Keyframe and frames of an entry run up to the next keyframe; the
+    // first keyframe (tick 0) follows the header, the last frames end at
+    // the index
+    if (!index_.empty() &&
+        (index_.front().tick != 0 ||
+         index_.front().keyframe_offset != sizeof(header_))) {
+        return false;
+    }
+    for (size_t i = 0; i < index_.size(); ++i) {
+        const auto& entry = index_[i];
+        auto is_last = i + 1 == index_.size();
+        auto next_tick = is_last ? trailer_.tick_count : index_[i + 1].tick;
+        auto section_end =
+            is_last ? trailer_.index_offset : index_[i + 1].keyframe_offset;
+        if (entry.tick >= next_tick || section_end > trailer_.index_offset ||
+            entry.keyframe_offset > section_end ||
+            section_end - entry.keyframe_offset < sizeof(uint32_t)) {
+            return false;
+        }
+        uint32_t state_size = 0;
+        std::memcpy(&state_size, data_ + entry.keyframe_offset,
+                    sizeof(state_size));
+        if (state_size >
+                section_end - entry.keyframe_offset - sizeof(state_size) ||
+            entry.frames_offset !=
+                entry.keyframe_offset + sizeof(state_size) + state_size ||
+            next_tick - entry.tick >
+                (section_end - entry.frames_offset) / sizeof(ReplayFrame)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReplayReader::Close() {
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    index_.clear();
+    trailer_ = ReplayTrailer();
+}
+
+uint64_t ReplayReader::LoadKeyframe(uint64_t tick, GameState& state) const {
+    const auto& entry = FindIndexEntry(tick);
+    // NOTE: State size was checked when opened; the state ends where
+    // frames start
+    ByteReader state_reader(data_ + entry.keyframe_offset + sizeof(uint32_t),
+                            data_ + entry.frames_offset);
+    ReadGameState(state_reader, state);
+    return entry.tick;
+}
+
+ReplayFrame ReplayReader::GetFrame(uint64_t tick) const {
+    assert(tick < GetTickCount());
+    const auto& entry = FindIndexEntry(tick);
+    ReplayFrame frame;
+    std::memcpy(&frame,
+                data_ + entry.frames_offset +
+                    (tick - entry.tick) * sizeof(ReplayFrame),
+                sizeof(frame));
+    // NOTE: Commands are stored verbatim; the simulation trusts them
+    if (frame.commands.count > CommandBatch::kMaxCommands) {
+        throw Error("Replay frame commands are too long");
+    }
+    for (auto command : frame.commands) {
+        if (static_cast<uint8_t>(command) >=
+            static_cast<uint8_t>(GameCommand::Count)) {
+            throw Error("Replay frame command is invalid");
+        }
+    }
+    return frame;
+}
+
+const ReplayIndexEntry& ReplayReader::FindIndexEntry(uint64_t tick) const {
+    if (index_.empty()) {
+        throw Error("Replay has no keyframes");
+    }
+    // NOTE: Keyframes are written every keyframe_interval ticks, so the
+    // entry could be computed directly; searching keeps reader independent
+    // of that writer detail
+    auto it = std::upper_bound(
+        index_.begin(), index_.end(), tick,
+        [](uint64_t tick, const ReplayIndexEntry& entry) {
+            return tick < entry.tick;
+        });
+    assert(it != index_.begin());
+    return *std::prev(it);
+}
+
+} // namespace tetris3d
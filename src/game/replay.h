@@ -0,0 +1,116 @@
+#ifndef TETRIS3D_GAME_REPLAY_H_
+#define TETRIS3D_GAME_REPLAY_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "game/command.h"
+#include "game/state.h"
+
+namespace tetris3d {
+
+// Everything the simulation consumed during a single Game::Update call (tick)
+struct ReplayFrame {
+    float elapsed_seconds = 0.f;
+    CommandBatch commands;
+};
+
+// Replay file layout:
+// ----
+// ReplayHeader
+// keyframe 0, frames [0, K)
+// keyframe 1, frames [K, 2K)
+// ...
+// ReplayIndexEntry[index_count]
+// ReplayTrailer
+// ----
+// Keyframe is: u32 state size, serialized GameState (before tick is
+// applied); K is the keyframe interval
+struct ReplayHeader {
+    char magic[4] = {'T', '3', 'D', 'R'};
+    uint32_t version = 2;
+    int32_t map_width = 0;
+    int32_t map_depth = 0;
+    int32_t map_height = 0;
+    uint32_t keyframe_interval = 0;
+};
+
+struct ReplayIndexEntry {
+    uint64_t tick = 0;
+    uint64_t keyframe_offset = 0;
+    uint64_t frames_offset = 0;
+};
+
+struct ReplayTrailer {
+    uint64_t index_offset = 0;
+    uint64_t index_count = 0;
+    uint64_t tick_count = 0;
+    char magic[4] = {'T', '3', 'D', 'I'};
+    uint32_t reserved = 0;
+};
+
+class ReplayWriter {
+public:
+    ~ReplayWriter();
+
+    void Open(const std::string& path, const Config& config);
+    bool IsOpen() const { return file_.is_open(); }
+
+    // @state game state before the frame is applied; it is stored as
+    // keyframe every keyframe interval ticks
+    void Record(const GameState& state, const ReplayFrame& frame);
+
+    // Writes index footer and closes the file
+    void Close();
+
+private:
+    void Write(const void* data, size_t size);
+
+    std::ofstream file_;
+    uint64_t offset_ = 0;
+    uint64_t tick_count_ = 0;
+    uint32_t keyframe_interval_ = 0;
+    std::vector<ReplayIndexEntry> index_;
+    std::vector<uint8_t> keyframe_buffer_;
+};
+
+// Random access replay reader; the file is memory mapped, so seeking costs
+// a single keyframe decode plus at most keyframe interval ticks to simulate
+class ReplayReader {
+public:
+    ReplayReader() = default;
+    ~ReplayReader();
+
+    void Open(const std::string& path);
+    bool IsOpen() const { return data_ != nullptr; }
+    void Close();
+
+    const ReplayHeader& GetHeader() const { return header_; }
+    uint64_t GetTickCount() const { return trailer_.tick_count; }
+
+    // Restores the nearest keyframe at or before tick; returns its tick
+    uint64_t LoadKeyframe(uint64_t tick, GameState& state) const;
+    ReplayFrame GetFrame(uint64_t tick) const;
+
+private:
+    ReplayReader(const ReplayReader&) = delete;
+    ReplayReader& operator=(const ReplayReader&) = delete;
+
+    // Index entries are in tick order, and their keyframes and frames lie
+    // within the file
+    bool IsIndexValid() const;
+    const ReplayIndexEntry& FindIndexEntry(uint64_t tick) const;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    ReplayHeader header_;
+    ReplayTrailer trailer_;
+    std::vector<ReplayIndexEntry> index_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_REPLAY_H_
@@ -0,0 +1,199 @@
+#include "game/rollback_session.h"
+
+#include <algorithm>
+
+#include "error.h"
+#include "game/game.h"
+#include "game/state_io.h"
+
+namespace {
+
+uint32_t HashBytes(uint32_t hash, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool IsSameInput(const tetris3d::CommandBatch& a,
+                 const tetris3d::CommandBatch& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end());
+}
+
+} // namespace
+
+namespace tetris3d {
+
+RollbackSession::RollbackSession(const Config& config, unsigned local_player,
+                                 unsigned max_rollback_ticks,
+                                 float tick_seconds)
+    : local_player_(local_player), remote_player_(1 - local_player),
+      max_rollback_ticks_(max_rollback_ticks), tick_seconds_(tick_seconds),
+      states_{GameState(config), GameState(config)} {
+    if (local_player >= kPlayerCount) {
+        throw Error("Invalid local player index");
+    }
+    if (max_rollback_ticks == 0 || max_rollback_ticks > kMaxRollbackTicks) {
+        throw Error("Rollback window must be 1 to " +
+                    std::to_string(kMaxRollbackTicks) + " ticks");
+    }
+
+    snapshots_.reserve(max_rollback_ticks + 1);
+    for (unsigned i = 0; i <= max_rollback_ticks; ++i) {
+        snapshots_.push_back(Snapshot{{GameStateSnapshot(states_[0].board),
+                                       GameStateSnapshot(states_[1].board)}});
+    }
+    for (auto& inputs : inputs_) {
+        inputs.resize(kInputRingSize);
+    }
+}
+
+bool RollbackSession::IsStalled() const {
+    // NOTE: Peer may be ahead, so received ticks can exceed local ones
+    return tick_ >= remote_received_tick_ + max_rollback_ticks_ ||
+           tick_ >= remote_acked_tick_ + kInputRingSize - 1;
+}
+
+bool RollbackSession::AdvanceTick(const CommandBatch& local_commands) {
+    Synchronize();
+    if (IsStalled()) {
+        ++stats_.stalled_ticks;
+        return false;
+    }
+
+    // NOTE: Versus cannot be paused by one of the players
+    auto& input = inputs_[local_player_][tick_ % kInputRingSize];
+    input.Clear();
+    for (auto command : local_commands) {
+        if (command != GameCommand::TogglePause) {
+            input.Push(command);
+        }
+    }
+
+    Simulate(tick_);
+    ++tick_;
+    return true;
+}
+
+uint64_t RollbackSession::GetConfirmedTick() const {
+    return std::min(tick_, remote_received_tick_);
+}
+
+void RollbackSession::WritePacket(std::vector<uint8_t>& packet) const {
+    ByteWriter writer(packet);
+    writer.WriteVarint(remote_received_tick_);
+    writer.WriteVarint(remote_acked_tick_);
+    writer.WriteVarint(tick_ - remote_acked_tick_);
+    for (auto tick = remote_acked_tick_; tick < tick_; ++tick) {
+        const auto& input = inputs_[local_player_][tick % kInputRingSize];
+        writer.Write<uint8_t>(input.count);
+        for (auto command : input) {
+            writer.Write<uint8_t>(static_cast<uint8_t>(command));
+        }
+    }
+}
+
+void RollbackSession::ReadPacket(const uint8_t* data, size_t size) {
+    ByteReader reader(data, data + size);
+    auto ack = reader.ReadVarint();
+    remote_acked_tick_ = std::max(remote_acked_tick_, std::min(ack, tick_));
+
+    auto first_tick = reader.ReadVarint();
+    auto count = reader.ReadVarint();
+    CommandBatch input;
+    for (uint64_t i = 0; i < count; ++i) {
+        input.Clear();
+        auto command_count = reader.Read<uint8_t>();
+        if (command_count > CommandBatch::kMaxCommands) {
+            throw Error("Rollback packet input is too long");
+        }
+        for (uint8_t j = 0; j < command_count; ++j) {
+            auto command = reader.Read<uint8_t>();
+            if (command >= static_cast<uint8_t>(GameCommand::Count)) {
+                throw Error("Rollback packet command is invalid");
+            }
+            input.Push(static_cast<GameCommand>(command));
+        }
+
+        // NOTE: Inputs are taken in order only; those still needed for
+        // rollback must not be overwritten by inputs too far ahead
+        auto tick = first_tick + i;
+        if (tick != remote_received_tick_ ||
+            tick >= tick_ + kInputRingSize - max_rollback_ticks_) {
+            continue;
+        }
+        inputs_[remote_player_][tick % kInputRingSize] = input;
+        ++remote_received_tick_;
+        if (tick < tick_ && !IsSameInput(input, predicted_input_)) {
+            rollback_tick_ = std::min(rollback_tick_, tick);
+        }
+    }
+}
+
+uint32_t RollbackSession::GetChecksum() const {
+    uint32_t hash = 2166136261u;
+    for (const auto& state : states_) {
+        const auto& cells = state.board.GetCells();
+        hash = HashBytes(hash, cells.data(), cells.size() * sizeof(unsigned));
+        const auto& block = state.falling_block;
+        const auto& offsets = block.GetCubeOffsets();
+        hash = HashBytes(hash, &block.GetPosition(), sizeof(glm::ivec3));
+        hash = HashBytes(hash, offsets.data(),
+                         offsets.size() * sizeof(glm::ivec3));
+        hash = HashBytes(hash, &state.phase, sizeof(state.phase));
+        hash = HashBytes(hash, &state.erased_layers,
+                         sizeof(state.erased_layers));
+        hash = HashBytes(hash, &state.seconds_to_next_block_fall,
+                         sizeof(state.seconds_to_next_block_fall));
+        auto random_state = state.random.GetState();
+        hash = HashBytes(hash, &random_state, sizeof(random_state));
+    }
+    return hash;
+}
+
+const CommandBatch& RollbackSession::GetInput(unsigned player,
+                                              uint64_t tick) const {
+    if (player == remote_player_ && tick >= remote_received_tick_) {
+        return predicted_input_;
+    }
+    return inputs_[player][tick % kInputRingSize];
+}
+
+void RollbackSession::Simulate(uint64_t tick) {
+    auto& snapshot = snapshots_[tick % snapshots_.size()];
+    for (unsigned player = 0; player < kPlayerCount; ++player) {
+        snapshot.states[player].Save(states_[player]);
+        Game::Update(states_[player], tick_seconds_, GetInput(player, tick));
+    }
+}
+
+void RollbackSession::Synchronize() {
+    if (rollback_tick_ == UINT64_MAX) {
+        return;
+    }
+
+    auto begin_time = std::chrono::steady_clock::now();
+    auto from_tick = rollback_tick_;
+    rollback_tick_ = UINT64_MAX;
+
+    const auto& snapshot = snapshots_[from_tick % snapshots_.size()];
+    for (unsigned player = 0; player < kPlayerCount; ++player) {
+        snapshot.states[player].Restore(states_[player]);
+    }
+    for (auto tick = from_tick; tick < tick_; ++tick) {
+        Simulate(tick);
+    }
+
+    auto ticks = static_cast<unsigned>(tick_ - from_tick);
+    auto time = std::chrono::steady_clock::now() - begin_time;
+    ++stats_.rollbacks;
+    stats_.resimulated_ticks += ticks;
+    stats_.max_rollback_ticks = std::max(stats_.max_rollback_ticks, ticks);
+    stats_.rollback_time += time;
+    stats_.max_rollback_time = std::max(
+        stats_.max_rollback_time,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(time));
+}
+
+} // namespace tetris3d
@@ -0,0 +1,111 @@
+#ifndef TETRIS3D_GAME_ROLLBACK_SESSION_H_
+#define TETRIS3D_GAME_ROLLBACK_SESSION_H_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "config.h"
+#include "game/command.h"
+#include "game/state.h"
+#include "game/state_snapshot.h"
+
+namespace tetris3d {
+
+struct RollbackStats {
+    uint64_t stalled_ticks = 0;
+    uint64_t rollbacks = 0;
+    uint64_t resimulated_ticks = 0;
+    unsigned max_rollback_ticks = 0;
+    std::chrono::nanoseconds rollback_time{0};
+    std::chrono::nanoseconds max_rollback_time{0};
+};
+
+// Versus match of two players, both simulated in lockstep on each peer
+// NOTE: Remote input is predicted (no commands) until it arrives; every
+// tick both states are snapshotted into a ring, so when the actual input
+// differs the states are restored at the mispredicted tick and simulated
+// again up to the current one
+// Packet (peer to peer, unreliable):
+// ----
+// varint ack: count of peer ticks received (in order)
+// varint first tick, varint count of local inputs since the last ack
+// per tick: u8 command count, commands (GameCommand)
+// ----
+// Inputs are resent until acknowledged, so lost packets need no retransmit
+class RollbackSession {
+public:
+    static inline constexpr unsigned kPlayerCount = 2;
+    static inline constexpr unsigned kMaxRollbackTicks = 30;
+
+    // @local_player index of the player controlled by this peer; the peer
+    // uses the other one
+    // @max_rollback_ticks local simulation stalls when running this many
+    // ticks ahead of the received remote input
+    RollbackSession(const Config& config, unsigned local_player,
+                    unsigned max_rollback_ticks, float tick_seconds);
+
+    // Simulates next tick with the local commands (pause is ignored);
+    // returns false if stalled waiting for remote input, commands are
+    // dropped then
+    // NOTE: Pending rollback is performed first, even if stalled
+    bool AdvanceTick(const CommandBatch& local_commands);
+    bool IsStalled() const;
+
+    // Performs pending rollback, so states reflect all received input
+    void Synchronize();
+
+    // Appends packet for the peer
+    void WritePacket(std::vector<uint8_t>& packet) const;
+    // Throws Error on malformed packet
+    void ReadPacket(const uint8_t* data, size_t size);
+
+    const GameState& GetState(unsigned player) const {
+        return states_[player];
+    }
+    unsigned GetLocalPlayer() const { return local_player_; }
+    uint64_t GetTick() const { return tick_; }
+    // Ticks simulated with actual inputs of both players
+    uint64_t GetConfirmedTick() const;
+    // Local ticks the peer acknowledged
+    uint64_t GetAckedTick() const { return remote_acked_tick_; }
+    const RollbackStats& GetStats() const { return stats_; }
+
+    // Hash of both simulated states, for desync detection
+    uint32_t GetChecksum() const;
+
+private:
+    // NOTE: Bounds how far peers run apart; inputs of ticks closer than
+    // this are kept
+    static inline constexpr unsigned kInputRingSize = 64;
+
+    struct Snapshot {
+        GameStateSnapshot states[kPlayerCount];
+    };
+
+    const CommandBatch& GetInput(unsigned player, uint64_t tick) const;
+    void Simulate(uint64_t tick);
+
+    unsigned local_player_ = 0;
+    unsigned remote_player_ = 1;
+    unsigned max_rollback_ticks_ = 0;
+    float tick_seconds_ = 0.f;
+
+    GameState states_[kPlayerCount];
+    // Snapshot of tick is taken before the tick is simulated
+    std::vector<Snapshot> snapshots_;
+    std::vector<CommandBatch> inputs_[kPlayerCount];
+    CommandBatch predicted_input_;
+
+    uint64_t tick_ = 0;
+    uint64_t remote_received_tick_ = 0;
+    uint64_t remote_acked_tick_ = 0;
+    // Earliest mispredicted tick; UINT64_MAX if none
+    uint64_t rollback_tick_ = UINT64_MAX;
+
+    RollbackStats stats_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_ROLLBACK_SESSION_H_
@@ -0,0 +1,172 @@
+#include "game/session_save.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "game/state_io.h"
+
+namespace {
+
+uint32_t HashBytes(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool WriteAll(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        auto written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+} // namespace
+
+namespace tetris3d {
+
+SessionSaver::~SessionSaver() { Close(); }
+
+void SessionSaver::Open(const std::string& path) {
+    Close();
+    path_ = path;
+    stopping_ = false;
+    back_busy_ = false;
+    thread_ = std::thread([this] { RunWriter(); });
+}
+
+bool SessionSaver::Save(const GameState& state) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (back_busy_) {
+            return false;
+        }
+    }
+
+    // NOTE: Buffers keep their capacity, so steady state saves do not
+    // allocate
+    auto& buffer = buffers_[front_];
+    buffer.resize(sizeof(SessionSaveHeader));
+    ByteWriter writer(buffer);
+    WriteGameState(writer, state);
+
+    SessionSaveHeader header;
+    auto state_data = buffer.data() + sizeof(header);
+    header.state_size = buffer.size() - sizeof(header);
+    header.state_checksum = HashBytes(state_data, header.state_size);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        front_ = 1 - front_;
+        back_busy_ = true;
+    }
+    condition_.notify_one();
+    return true;
+}
+
+void SessionSaver::Close() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+void SessionSaver::RunWriter() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        condition_.wait(lock, [this] { return back_busy_ || stopping_; });
+        // NOTE: Pending snapshot is written even when stopping
+        if (!back_busy_) {
+            return;
+        }
+        const auto& buffer = buffers_[1 - front_];
+        lock.unlock();
+        if (!WriteFile(buffer)) {
+            printf("Cannot write session save: %s\n", path_.c_str());
+        }
+        lock.lock();
+        back_busy_ = false;
+    }
+}
+
+bool SessionSaver::WriteFile(const std::vector<uint8_t>& buffer) const {
+    auto temp_path = path_ + ".tmp";
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    auto written = WriteAll(fd, buffer.data(), buffer.size());
+    // NOTE: Data must hit the disk before the rename makes it the save
+    written = written && fsync(fd) == 0;
+    close(fd);
+    if (!written || rename(temp_path.c_str(), path_.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LoadSession(const std::string& path, GameState& state) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        file_stat.st_size < static_cast<off_t>(sizeof(SessionSaveHeader))) {
+        close(fd);
+        return false;
+    }
+    size_t size = file_stat.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    auto bytes = static_cast<const uint8_t*>(data);
+    SessionSaveHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    auto state_data = bytes + sizeof(header);
+    auto loaded =
+        std::memcmp(header.magic, SessionSaveHeader().magic, 4) == 0 &&
+        header.version == SessionSaveHeader().version &&
+        header.state_size == size - sizeof(header) &&
+        header.state_checksum == HashBytes(state_data, header.state_size);
+    if (loaded) {
+        // NOTE: Decoded into a copy, so a failure keeps the state intact
+        auto loaded_state = state;
+        try {
+            ByteReader reader(state_data, state_data + header.state_size);
+            ReadGameState(reader, loaded_state);
+            state = loaded_state;
+        } catch (const Error&) {
+            loaded = false;
+        }
+    }
+    munmap(data, size);
+    return loaded;
+}
+
+} // namespace tetris3d
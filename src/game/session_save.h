@@ -0,0 +1,76 @@
+#ifndef TETRIS3D_GAME_SESSION_SAVE_H_
+#define TETRIS3D_GAME_SESSION_SAVE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "game/state.h"
+
+namespace tetris3d {
+
+// Session save file layout:
+// ----
+// SessionSaveHeader
+// serialized GameState (see WriteGameState)
+// ----
+struct SessionSaveHeader {
+    char magic[4] = {'T', '3', 'D', 'S'};
+    uint32_t version = 1;
+    uint32_t state_size = 0;
+    // FNV-1a of the serialized state; detects torn or corrupted writes
+    uint32_t state_checksum = 0;
+};
+
+// Writes game state snapshots to a file on a background thread
+// NOTE: The caller only serializes the state into the front buffer; the
+// buffers are swapped and the back one is written meanwhile, so the game
+// loop never waits on I/O. The file is replaced atomically (temporary file,
+// fsync, rename), so a power loss keeps either the old or the new save
+class SessionSaver {
+public:
+    SessionSaver() = default;
+    ~SessionSaver();
+
+    void Open(const std::string& path);
+    bool IsOpen() const { return thread_.joinable(); }
+
+    // Returns false (snapshot skipped) if the previous one is still being
+    // written
+    bool Save(const GameState& state);
+
+    // Finishes pending write and stops the writer thread
+    void Close();
+
+private:
+    SessionSaver(const SessionSaver&) = delete;
+    SessionSaver& operator=(const SessionSaver&) = delete;
+
+    void RunWriter();
+    bool WriteFile(const std::vector<uint8_t>& buffer) const;
+
+    std::string path_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+
+    // buffers_[front_] is filled by Save, the other one is written by the
+    // writer thread while back_busy_ is set
+    std::vector<uint8_t> buffers_[2];
+    unsigned front_ = 0;
+    bool back_busy_ = false;
+    bool stopping_ = false;
+};
+
+// Restores state saved by SessionSaver; the file is memory mapped and
+// decoded in place
+// NOTE: Returns false if the file does not exist or is not a valid save
+// for the state board dimensions; state is left untouched then
+bool LoadSession(const std::string& path, GameState& state);
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_SESSION_SAVE_H_
@@ -0,0 +1,490 @@
+#include "game/software_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "glm/geometric.hpp"
+#include "glm/mat4x4.hpp"
+
+#include "game/color.h"
+
+namespace tetris3d {
+namespace {
+
+constexpr int kLanes = 8;
+// Ground and wall lines are as wide as the GL lines of other renderers
+constexpr float kGridLinePixels = 1.f;
+
+// NOTE: GCC/Clang vector extensions compile to whatever SIMD the target has
+// (SSE, AVX, NEON), operations with scalars broadcast them
+// NOTE: Helpers taking vectors are internal, so the AVX calling convention
+// warning does not apply
+#pragma GCC diagnostic ignored "-Wpsabi"
+typedef float Floats __attribute__((vector_size(kLanes * sizeof(float))));
+typedef int32_t Ints __attribute__((vector_size(kLanes * sizeof(int32_t))));
+typedef uint32_t Uints __attribute__((vector_size(kLanes * sizeof(uint32_t))));
+
+const Floats kLaneOffsets = {0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f};
+const Ints kLaneIndices = {0, 1, 2, 3, 4, 5, 6, 7};
+
+bool Any(const Ints& mask) {
+    uint64_t words[kLanes / 2];
+    std::memcpy(words, &mask, sizeof(words));
+    auto result = 0ull;
+    for (auto word : words) {
+        result |= word;
+    }
+    return result != 0;
+}
+
+template <typename Vector> Vector Load(const void* data) {
+    Vector result;
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+template <typename Vector> void Store(void* data, const Vector& value) {
+    std::memcpy(data, &value, sizeof(value));
+}
+
+template <typename Vector>
+Vector Select(const Ints& mask, const Vector& a, const Vector& b) {
+    return reinterpret_cast<Vector>((mask & reinterpret_cast<Ints>(a)) |
+                                    (~mask & reinterpret_cast<Ints>(b)));
+}
+
+uint32_t PackRgba(const glm::vec3& color) {
+    auto channel = [](float value) {
+        return static_cast<uint32_t>(std::clamp(value, 0.f, 1.f) * 255.f +
+                                     0.5f);
+    };
+    return channel(color.r) | (channel(color.g) << 8) |
+           (channel(color.b) << 16) | 0xff000000u;
+}
+
+glm::vec3 UnpackColor(unsigned color_pack) {
+    return glm::vec3((color_pack >> 16) & 0xff, (color_pack >> 8) & 0xff,
+                     color_pack & 0xff) /
+           255.f;
+}
+
+// Stand-in for the skybox: dark ground below horizon, dim sky above
+glm::vec3 SampleSky(const glm::vec3& direction) {
+    auto t = std::clamp(direction.y * 0.5f + 0.5f, 0.f, 1.f);
+    return glm::mix(glm::vec3(0.12f, 0.1f, 0.09f),
+                    glm::vec3(0.45f, 0.5f, 0.6f), t);
+}
+
+// Plane of attribute values at three screen points: d / dx, d / dy and value
+// at the origin
+void SetupPlane(const glm::vec2 points[3], const float values[3],
+                float inv_area, float plane[3]) {
+    auto d1 = values[1] - values[0];
+    auto d2 = values[2] - values[0];
+    auto x1 = points[1].x - points[0].x;
+    auto y1 = points[1].y - points[0].y;
+    auto x2 = points[2].x - points[0].x;
+    auto y2 = points[2].y - points[0].y;
+    plane[0] = (d1 * y2 - d2 * y1) * inv_area;
+    plane[1] = (d2 * x1 - d1 * x2) * inv_area;
+    plane[2] = values[0] - plane[0] * points[0].x - plane[1] * points[0].y;
+}
+
+unsigned GetCell(const Board& board, const glm::ivec3& cell) {
+    if (!board.Contains(cell)) {
+        return 0;
+    }
+    return board.GetCell((cell.x * board.GetWidth() + cell.z) +
+                         (cell.y * board.GetWidth() * board.GetDepth()));
+}
+
+} // namespace
+
+SoftwareRenderer::SoftwareRenderer(Config& config, ThreadPool* pool)
+    : config_(config), pool_(pool) {}
+
+void SoftwareRenderer::ResizeBuffers() {
+    stride_ = (width_ + kLanes - 1) / kLanes * kLanes;
+    tiles_x_ = (width_ + kTileSize - 1) / kTileSize;
+    tiles_y_ = (height_ + kTileSize - 1) / kTileSize;
+    color_.assign(static_cast<size_t>(stride_) * height_, 0);
+    depth_.assign(static_cast<size_t>(stride_) * height_, 0.f);
+    bins_.resize(tiles_x_ * tiles_y_);
+}
+
+void SoftwareRenderer::Render(const GameState& state,
+                              const PerspectiveCamera& camera) {
+    if (width_ <= 0 || height_ <= 0) {
+        return;
+    }
+    if (color_.size() != static_cast<size_t>(stride_) * height_ ||
+        stride_ < width_ || stride_ >= width_ + kLanes) {
+        ResizeBuffers();
+    }
+
+    view_projection_ = camera.GetProjection() * camera.GetView();
+    camera_position_ = camera.GetPosition();
+    // NOTE: Same background tints as BasicRenderer
+    if (state.phase == GameState::Phase::Lost) {
+        clear_color_ = PackRgba({0.2f, 0.1f, 0.1f});
+    } else if (state.phase == GameState::Phase::LayersErase) {
+        clear_color_ = PackRgba({0.9f, 0.9f, 0.9f});
+    } else if (state.paused) {
+        clear_color_ = PackRgba({0.05f, 0.08f, 0.08f});
+    } else {
+        clear_color_ = PackRgba({0.2f, 0.2f, 0.2f});
+    }
+
+    triangles_.clear();
+    for (auto& bin : bins_) {
+        bin.clear();
+    }
+
+    // Ground is always drawn, walls only when they are behind the board
+    // from camera point of view (same rule as other renderers)
+    const auto& board = state.board;
+    glm::vec3 size(board.GetWidth(), board.GetHeight(), board.GetDepth());
+    AddGrid({0.f, 0.f, 0.f}, {size.x, 0.f, 0.f}, {0.f, 0.f, size.z},
+            {0.f, 1.f, 0.f});
+    auto view_dir = camera.GetForward();
+    struct Wall {
+        glm::vec3 origin;
+        glm::vec3 u_axis;
+        // Towards the board
+        glm::vec3 normal;
+    };
+    const Wall walls[] = {
+        {{0.f, 0.f, 0.f}, {size.x, 0.f, 0.f}, {0.f, 0.f, 1.f}},
+        {{0.f, 0.f, 0.f}, {0.f, 0.f, size.z}, {1.f, 0.f, 0.f}},
+        {{0.f, 0.f, size.z}, {size.x, 0.f, 0.f}, {0.f, 0.f, -1.f}},
+        {{size.x, 0.f, 0.f}, {0.f, 0.f, size.z}, {-1.f, 0.f, 0.f}},
+    };
+    for (const auto& wall : walls) {
+        if (glm::dot(view_dir, wall.normal) < 0.f) {
+            AddGrid(wall.origin, wall.u_axis, {0.f, size.y, 0.f},
+                    wall.normal);
+        }
+    }
+
+    for (int y = 0; y < board.GetHeight(); ++y) {
+        for (int x = 0; x < board.GetWidth(); ++x) {
+            for (int z = 0; z < board.GetDepth(); ++z) {
+                glm::ivec3 cell(x, y, z);
+                if (auto color = GetCell(board, cell)) {
+                    AddCubeFaces(board, cell, color, true);
+                }
+            }
+        }
+    }
+    const auto& block = state.falling_block;
+    auto block_color = PackColor(block.GetColor());
+    for (const auto& offset : block.GetCubeOffsets()) {
+        AddCubeFaces(board, block.GetPosition() + offset, block_color, false);
+    }
+
+    if (pool_) {
+        pool_->ParallelFor(bins_.size(),
+                           [this](size_t tile, unsigned) { RenderTile(tile); });
+    } else {
+        for (size_t tile = 0; tile < bins_.size(); ++tile) {
+            RenderTile(tile);
+        }
+    }
+}
+
+void SoftwareRenderer::ReadPixels(std::vector<uint8_t>& rgb) const {
+    rgb.resize(static_cast<size_t>(width_) * height_ * 3);
+    auto output = rgb.data();
+    for (int y = 0; y < height_; ++y) {
+        auto row = color_.data() + static_cast<size_t>(y) * stride_;
+        for (int x = 0; x < width_; ++x) {
+            *output++ = row[x] & 0xff;
+            *output++ = (row[x] >> 8) & 0xff;
+            *output++ = (row[x] >> 16) & 0xff;
+        }
+    }
+}
+
+void SoftwareRenderer::AddCubeFaces(const Board& board,
+                                    const glm::ivec3& cell,
+                                    unsigned color_pack, bool skip_hidden) {
+    const glm::ivec3 directions[] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                     {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+    auto center = glm::vec3(cell) + glm::vec3(0.5f);
+    for (const auto& direction : directions) {
+        // NOTE: Face between two settled cubes is never visible
+        if (skip_hidden && GetCell(board, cell + direction)) {
+            continue;
+        }
+        auto normal = glm::vec3(direction);
+        auto tangent1 = direction.y ? glm::vec3(1.f, 0.f, 0.f)
+                                    : glm::vec3(0.f, 1.f, 0.f);
+        auto tangent2 = glm::cross(normal, tangent1);
+        auto face_center = center + 0.5f * normal;
+        // Color bars of AdvancedRenderer are 0.8 wide, so 0.1 of the face
+        // on every side is the dark cube
+        AddQuad(face_center - 0.5f * tangent1 - 0.5f * tangent2, tangent1,
+                tangent2, normal, {1.f, 1.f}, 0.1f, 0.f,
+                ShadeFace(face_center, normal, color_pack),
+                PackRgba({0.1f, 0.1f, 0.1f}));
+    }
+}
+
+uint32_t SoftwareRenderer::ShadeFace(const glm::vec3& center,
+                                     const glm::vec3& normal,
+                                     unsigned color_pack) const {
+    // NOTE: Same mix as refract shader of AdvancedRenderer, reflection is
+    // evaluated once per face
+    auto incident = glm::normalize(center - camera_position_);
+    auto reflected = glm::reflect(incident, normal);
+    return PackRgba(
+        glm::mix(UnpackColor(color_pack), SampleSky(reflected), 0.4f));
+}
+
+void SoftwareRenderer::AddGrid(const glm::vec3& origin,
+                               const glm::vec3& u_axis,
+                               const glm::vec3& v_axis,
+                               const glm::vec3& normal) {
+    // NOTE: GL lines have no back side; the grid faces the camera, so
+    // back-face culling never drops it
+    auto facing_normal =
+        glm::dot(camera_position_ - origin, normal) < 0.f ? -normal : normal;
+    AddQuad(origin, u_axis, v_axis, facing_normal,
+            {glm::length(u_axis), glm::length(v_axis)}, 0.f,
+            kGridLinePixels / 2.f, clear_color_, PackRgba({0.3f, 0.3f, 0.3f}));
+}
+
+void SoftwareRenderer::AddQuad(glm::vec3 origin, glm::vec3 u_axis,
+                               glm::vec3 v_axis, const glm::vec3& normal,
+                               glm::vec2 uv_size, float border,
+                               float border_pixels, uint32_t color,
+                               uint32_t border_color) {
+    // NOTE: Counter-clockwise when seen from the normal side, as GL
+    // front faces
+    if (glm::dot(glm::cross(u_axis, v_axis), normal) < 0.f) {
+        std::swap(u_axis, v_axis);
+        std::swap(uv_size.x, uv_size.y);
+    }
+    Vertex vertices[4] = {
+        {view_projection_ * glm::vec4(origin, 1.f), {0.f, 0.f}},
+        {view_projection_ * glm::vec4(origin + u_axis, 1.f), {uv_size.x, 0.f}},
+        {view_projection_ * glm::vec4(origin + u_axis + v_axis, 1.f),
+         uv_size},
+        {view_projection_ * glm::vec4(origin + v_axis, 1.f), {0.f, uv_size.y}},
+    };
+    AddTriangle(vertices[0], vertices[1], vertices[2], border, border_pixels,
+                color, border_color);
+    AddTriangle(vertices[0], vertices[2], vertices[3], border, border_pixels,
+                color, border_color);
+}
+
+void SoftwareRenderer::AddTriangle(const Vertex& v0, const Vertex& v1,
+                                   const Vertex& v2, float border,
+                                   float border_pixels, uint32_t color,
+                                   uint32_t border_color) {
+    // NOTE: Triangles crossing the near plane are dropped instead of
+    // clipped; cameras orbit outside of the board
+    const Vertex* vertices[3] = {&v0, &v1, &v2};
+    for (auto vertex : vertices) {
+        if (vertex->clip.w < 1e-3f) {
+            return;
+        }
+    }
+
+    glm::vec2 points[3];
+    float depths[3];
+    float inv_ws[3];
+    float us[3];
+    float vs[3];
+    for (int i = 0; i < 3; ++i) {
+        const auto& clip = vertices[i]->clip;
+        auto inv_w = 1.f / clip.w;
+        points[i] = glm::vec2((clip.x * inv_w * 0.5f + 0.5f) * width_,
+                              (0.5f - clip.y * inv_w * 0.5f) * height_);
+        depths[i] = clip.z * inv_w;
+        inv_ws[i] = inv_w;
+        us[i] = vertices[i]->uv.x * inv_w;
+        vs[i] = vertices[i]->uv.y * inv_w;
+    }
+
+    // NOTE: Screen y goes down, so front faces have negative area
+    auto area = (points[1].x - points[0].x) * (points[2].y - points[0].y) -
+                (points[2].x - points[0].x) * (points[1].y - points[0].y);
+    if (area > -1e-6f) {
+        return;
+    }
+    std::swap(points[1], points[2]);
+    std::swap(depths[1], depths[2]);
+    std::swap(inv_ws[1], inv_ws[2]);
+    std::swap(us[1], us[2]);
+    std::swap(vs[1], vs[2]);
+    area = -area;
+
+    Triangle triangle;
+    auto min_x =
+        std::min({points[0].x, points[1].x, points[2].x}) - border_pixels;
+    auto max_x =
+        std::max({points[0].x, points[1].x, points[2].x}) + border_pixels;
+    auto min_y =
+        std::min({points[0].y, points[1].y, points[2].y}) - border_pixels;
+    auto max_y =
+        std::max({points[0].y, points[1].y, points[2].y}) + border_pixels;
+    triangle.min_x = std::max(0, static_cast<int>(std::floor(min_x)));
+    triangle.min_y = std::max(0, static_cast<int>(std::floor(min_y)));
+    triangle.max_x = std::min(width_ - 1, static_cast<int>(std::ceil(max_x)));
+    triangle.max_y = std::min(height_ - 1, static_cast<int>(std::ceil(max_y)));
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+        return;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        const auto& from = points[i];
+        const auto& to = points[(i + 1) % 3];
+        triangle.edge_a[i] = from.y - to.y;
+        triangle.edge_b[i] = to.x - from.x;
+        triangle.edge_c[i] =
+            (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+        // NOTE: Lines on edges would be cut in half, so edges move out by
+        // the line half width (u, v planes extend beyond them)
+        triangle.edge_c[i] += border_pixels * std::hypot(triangle.edge_a[i],
+                                                         triangle.edge_b[i]);
+    }
+    auto inv_area = 1.f / area;
+    SetupPlane(points, depths, inv_area, triangle.depth);
+    SetupPlane(points, inv_ws, inv_area, triangle.inv_w);
+    SetupPlane(points, us, inv_area, triangle.u_over_w);
+    SetupPlane(points, vs, inv_area, triangle.v_over_w);
+    triangle.border = border;
+    triangle.border_pixels = border_pixels;
+    triangle.color = color;
+    triangle.border_color = border_color;
+
+    auto index = static_cast<uint32_t>(triangles_.size());
+    triangles_.push_back(triangle);
+    for (int tile_y = triangle.min_y / kTileSize;
+         tile_y <= triangle.max_y / kTileSize; ++tile_y) {
+        for (int tile_x = triangle.min_x / kTileSize;
+             tile_x <= triangle.max_x / kTileSize; ++tile_x) {
+            bins_[tile_y * tiles_x_ + tile_x].push_back(index);
+        }
+    }
+}
+
+void SoftwareRenderer::RenderTile(size_t tile) {
+    auto tile_min_x = static_cast<int>(tile % tiles_x_) * kTileSize;
+    auto tile_min_y = static_cast<int>(tile / tiles_x_) * kTileSize;
+    auto tile_max_x = std::min(tile_min_x + kTileSize, width_) - 1;
+    auto tile_max_y = std::min(tile_min_y + kTileSize, height_) - 1;
+
+    // NOTE: Tile width is a multiple of 8, so whole vectors never leave
+    // the tile (and its rows never leave the buffer, see stride_)
+    auto tile_end_x = std::min(tile_min_x + kTileSize, stride_);
+    for (int y = tile_min_y; y <= tile_max_y; ++y) {
+        auto offset = static_cast<size_t>(y) * stride_;
+        std::fill(color_.begin() + offset + tile_min_x,
+                  color_.begin() + offset + tile_end_x, clear_color_);
+        std::fill(depth_.begin() + offset + tile_min_x,
+                  depth_.begin() + offset + tile_end_x, 2.f);
+    }
+
+    for (auto index : bins_[tile]) {
+        const auto& triangle = triangles_[index];
+        auto min_x = std::max(triangle.min_x, tile_min_x) / kLanes * kLanes;
+        auto max_x = std::min(triangle.max_x, tile_max_x);
+        auto min_y = std::max(triangle.min_y, tile_min_y);
+        auto max_y = std::min(triangle.max_y, tile_max_y);
+        auto border = triangle.border;
+        auto border_pixels_squared =
+            triangle.border_pixels * triangle.border_pixels;
+        for (int y = min_y; y <= max_y; ++y) {
+            auto pixel_y = y + 0.5f;
+            auto row = static_cast<size_t>(y) * stride_;
+            for (int x = min_x; x <= max_x; x += kLanes) {
+                auto pixel_x = kLaneOffsets + static_cast<float>(x);
+                Ints inside = kLaneIndices + x <= max_x;
+                for (int edge = 0; edge < 3; ++edge) {
+                    auto value = triangle.edge_a[edge] * pixel_x +
+                                 (triangle.edge_b[edge] * pixel_y +
+                                  triangle.edge_c[edge]);
+                    inside &= value >= 0.f;
+                }
+                if (!Any(inside)) {
+                    continue;
+                }
+
+                auto depth = triangle.depth[0] * pixel_x +
+                             (triangle.depth[1] * pixel_y + triangle.depth[2]);
+                auto stored_depth = Load<Floats>(&depth_[row + x]);
+                inside &= depth < stored_depth;
+                if (!Any(inside)) {
+                    continue;
+                }
+
+                auto w = 1.f / (triangle.inv_w[0] * pixel_x +
+                                (triangle.inv_w[1] * pixel_y +
+                                 triangle.inv_w[2]));
+                auto u = (triangle.u_over_w[0] * pixel_x +
+                          (triangle.u_over_w[1] * pixel_y +
+                           triangle.u_over_w[2])) *
+                         w;
+                auto v = (triangle.v_over_w[0] * pixel_x +
+                          (triangle.v_over_w[1] * pixel_y +
+                           triangle.v_over_w[2])) *
+                         w;
+                // NOTE: u, v are non-negative, so truncation is floor
+                auto u_fraction = u - __builtin_convertvector(
+                                          __builtin_convertvector(u, Ints),
+                                          Floats);
+                auto v_fraction = v - __builtin_convertvector(
+                                          __builtin_convertvector(v, Ints),
+                                          Floats);
+                Ints on_border = (u_fraction < border) |
+                                 (u_fraction > 1.f - border) |
+                                 (v_fraction < border) |
+                                 (v_fraction > 1.f - border);
+                if (border_pixels_squared > 0.f) {
+                    // Distance to the nearest integer u (v) in pixels is
+                    // the u distance over the length of the u gradient;
+                    // perspective correct d(u) = w * (d(u / w) - u d(1 / w))
+                    auto du_dx = (triangle.u_over_w[0] -
+                                  u * triangle.inv_w[0]) *
+                                 w;
+                    auto du_dy = (triangle.u_over_w[1] -
+                                  u * triangle.inv_w[1]) *
+                                 w;
+                    auto dv_dx = (triangle.v_over_w[0] -
+                                  v * triangle.inv_w[0]) *
+                                 w;
+                    auto dv_dy = (triangle.v_over_w[1] -
+                                  v * triangle.inv_w[1]) *
+                                 w;
+                    // NOTE: Fraction is slightly negative beyond edges,
+                    // distances are squared
+                    auto u_distance =
+                        Select(u_fraction < 0.5f, u_fraction,
+                               1.f - u_fraction);
+                    auto v_distance =
+                        Select(v_fraction < 0.5f, v_fraction,
+                               1.f - v_fraction);
+                    on_border |= (u_distance * u_distance <
+                                  border_pixels_squared *
+                                      (du_dx * du_dx + du_dy * du_dy)) |
+                                 (v_distance * v_distance <
+                                  border_pixels_squared *
+                                      (dv_dx * dv_dx + dv_dy * dv_dy));
+                    inside &= on_border;
+                }
+                Uints color = Select(on_border,
+                                     Uints{} + triangle.border_color,
+                                     Uints{} + triangle.color);
+
+                Store(&depth_[row + x], Select(inside, depth, stored_depth));
+                Store(&color_[row + x],
+                      Select(inside, color, Load<Uints>(&color_[row + x])));
+            }
+        }
+    }
+}
+
+} // namespace tetris3d
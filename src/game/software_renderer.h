@@ -0,0 +1,124 @@
+#ifndef TETRIS3D_GAME_SOFTWARE_RENDERER_H_
+#define TETRIS3D_GAME_SOFTWARE_RENDERER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include "config.h"
+#include "game/renderer.h"
+#include "thread_pool.h"
+
+namespace tetris3d {
+
+// CPU renderer for machines without GPU (server thumbnails, spectator
+// previews); draws into its own RGBA buffer, no GL context is needed
+// ----
+// 1. Exposed cube faces, ground and walls become screen space triangles
+// 2. Triangles are binned into 64x64 pixel tiles
+// 3. Tiles are rasterized in parallel: edge functions, depth test and
+//    shading evaluated for 8 pixels at once (compiler vector extensions)
+// ----
+// NOTE: Cube look follows AdvancedRenderer: dark edges and color face with
+// reflection of an analytic sky instead of the skybox; shading is flat per
+// face, falling block projection (translucent) is not drawn
+class SoftwareRenderer : public IRenderer {
+public:
+    // @pool optional; tiles are rendered on the calling thread if null
+    SoftwareRenderer(Config& config, ThreadPool* pool);
+
+    void Render(const GameState& state,
+                const PerspectiveCamera& camera) override;
+    void SetFramebufferWidth(int value) override { width_ = value; }
+    void SetFramebufferHeight(int value) override { height_ = value; }
+
+    // Pixels of the last frame: RGBA with R in the lowest byte, rows from the
+    // top one, GetStride() pixels apart
+    const uint32_t* GetPixels() const { return color_.data(); }
+    int GetStride() const { return stride_; }
+    // Copies the last frame as RGB rows from the top one
+    void ReadPixels(std::vector<uint8_t>& rgb) const;
+
+private:
+    static inline constexpr int kTileSize = 64;
+
+    struct Vertex {
+        glm::vec4 clip;
+        glm::vec2 uv;
+    };
+
+    // Everything the rasterizer needs, in screen space (pixel units)
+    struct Triangle {
+        // Edge functions a * x + b * y + c, non-negative inside
+        float edge_a[3];
+        float edge_b[3];
+        float edge_c[3];
+        // Planes d / dx, d / dy, value at origin of depth, 1 / w, u / w and
+        // v / w (the last two give perspective correct u, v)
+        float depth[3];
+        float inv_w[3];
+        float u_over_w[3];
+        float v_over_w[3];
+        int min_x = 0;
+        int min_y = 0;
+        int max_x = 0;
+        int max_y = 0;
+        // Pixels closer than border to an integer u or v get border color
+        float border = 0.f;
+        // Same in pixels on screen, so lines keep their width at any
+        // distance; if not zero, the triangle is a grid and only its
+        // border pixels are drawn
+        float border_pixels = 0.f;
+        uint32_t color = 0;
+        uint32_t border_color = 0;
+    };
+
+    void ResizeBuffers();
+    // Quad origin, origin + u_axis, origin + u_axis + v_axis,
+    // origin + v_axis; uv goes from (0, 0) to uv_size
+    // @border_pixels see Triangle::border_pixels
+    void AddQuad(glm::vec3 origin, glm::vec3 u_axis, glm::vec3 v_axis,
+                 const glm::vec3& normal, glm::vec2 uv_size, float border,
+                 float border_pixels, uint32_t color, uint32_t border_color);
+    void AddTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2,
+                     float border, float border_pixels, uint32_t color,
+                     uint32_t border_color);
+    // Grid of unit cells; only its lines are drawn, as lines of other
+    // renderers
+    void AddGrid(const glm::vec3& origin, const glm::vec3& u_axis,
+                 const glm::vec3& v_axis, const glm::vec3& normal);
+    void AddCubeFaces(const Board& board, const glm::ivec3& cell,
+                      unsigned color_pack, bool skip_hidden);
+    uint32_t ShadeFace(const glm::vec3& center, const glm::vec3& normal,
+                       unsigned color_pack) const;
+    void RenderTile(size_t tile);
+
+    Config& config_;
+    ThreadPool* pool_ = nullptr;
+
+    int width_ = 0;
+    int height_ = 0;
+    // Row length of buffers, multiple of 8, so rows are processed 8 pixels
+    // at once without bounds checks
+    int stride_ = 0;
+    int tiles_x_ = 0;
+    int tiles_y_ = 0;
+    std::vector<uint32_t> color_;
+    std::vector<float> depth_;
+
+    // Per frame data
+    glm::mat4 view_projection_;
+    glm::vec3 camera_position_;
+    uint32_t clear_color_ = 0;
+    std::vector<Triangle> triangles_;
+    // Triangle indices per tile, in submission order
+    std::vector<std::vector<uint32_t>> bins_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_SOFTWARE_RENDERER_H_
@@ -0,0 +1,326 @@
+#include "game/spectator_stream.h"
+
+#include <algorithm>
+
+#include "error.h"
+#include "game/state_io.h"
+#include "lz.h"
+
+namespace {
+
+enum MessageFlags : uint8_t {
+    kKeyframe = 1 << 0,
+    kCompressed = 1 << 1,
+};
+
+enum FieldFlags : uint8_t {
+    kPhase = 1 << 0,
+    kScore = 1 << 1,
+    kErasedLayers = 1 << 2,
+    kCells = 1 << 3,
+    kBlock = 1 << 4,
+    kBlockPosition = 1 << 5,
+};
+
+// Smaller payloads (regular deltas) are not worth compressing
+constexpr size_t kMinCompressedSize = 64;
+
+// NOTE: Guards decoder against absurd allocations from malformed data
+constexpr uint64_t kMaxDimension = 1024;
+constexpr uint64_t kMaxPayloadSize = 1 << 24;
+
+// Compares all but position
+bool HasSameShape(const tetris3d::Block& a, const tetris3d::Block& b) {
+    return a.GetType() == b.GetType() &&
+           tetris3d::PackColor(a.GetColor()) ==
+               tetris3d::PackColor(b.GetColor()) &&
+           a.GetCubeOffsets() == b.GetCubeOffsets();
+}
+
+} // namespace
+
+namespace tetris3d {
+
+SpectatorStreamEncoder::SpectatorStreamEncoder(bool compress)
+    : compress_(compress) {}
+
+void SpectatorStreamEncoder::EncodeKeyframe(uint64_t tick,
+                                            const GameState& state,
+                                            std::vector<uint8_t>& message) {
+    Encode(tick, state, true, message);
+}
+
+void SpectatorStreamEncoder::EncodeDelta(uint64_t tick,
+                                         const GameState& state,
+                                         std::vector<uint8_t>& message) {
+    Encode(tick, state, false, message);
+}
+
+void SpectatorStreamEncoder::Encode(uint64_t tick, const GameState& state,
+                                    bool keyframe,
+                                    std::vector<uint8_t>& message) {
+    const auto& board = state.board;
+    if (!has_baseline_ || board.GetWidth() != board_.GetWidth() ||
+        board.GetDepth() != board_.GetDepth() ||
+        board.GetHeight() != board_.GetHeight()) {
+        keyframe = true;
+    }
+    if (keyframe) {
+        // NOTE: Keyframe is a delta against an empty board
+        board_ = Board(board.GetWidth(), board.GetDepth(), board.GetHeight());
+        block_ = Block();
+        erased_layers_ = 0;
+    }
+
+    // NOTE: Layers are erased only when full, so if the counter grew by the
+    // number of full layers in the last sent board, those were erased
+    erased_layer_indices_.clear();
+    if (state.erased_layers > erased_layers_) {
+        for (auto layer = board_.GetHeight(); layer-- > 0;) {
+            if (board_.IsLayerFilled(layer)) {
+                erased_layer_indices_.push_back(layer);
+            }
+        }
+        if (erased_layer_indices_.size() !=
+            state.erased_layers - erased_layers_) {
+            erased_layer_indices_.clear();
+        }
+        for (auto layer : erased_layer_indices_) {
+            board_.EraseLayer(layer);
+        }
+    }
+
+    const auto& cells = board.GetCells();
+    auto& sent_cells = board_.GetCells();
+    size_t changed_cells = 0;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        changed_cells += cells[i] != sent_cells[i];
+    }
+
+    uint8_t fields = 0;
+    if (keyframe || state.phase != phase_ || state.paused != paused_) {
+        fields |= kPhase;
+    }
+    if (state.erased_layers != erased_layers_) {
+        fields |= kScore;
+    }
+    if (!erased_layer_indices_.empty()) {
+        fields |= kErasedLayers;
+    }
+    if (changed_cells) {
+        fields |= kCells;
+    }
+    if (keyframe || !HasSameShape(state.falling_block, block_)) {
+        fields |= kBlock;
+    }
+    if (keyframe ||
+        state.falling_block.GetPosition() != block_.GetPosition()) {
+        fields |= kBlockPosition;
+    }
+
+    payload_.clear();
+    ByteWriter writer(payload_);
+    writer.WriteVarint(tick);
+    writer.Write<uint8_t>(fields);
+    if (keyframe) {
+        writer.WriteVarint(board.GetWidth());
+        writer.WriteVarint(board.GetDepth());
+        writer.WriteVarint(board.GetHeight());
+    }
+    if (fields & kPhase) {
+        writer.Write<uint8_t>(static_cast<uint8_t>(state.phase));
+        writer.Write<uint8_t>(state.paused);
+    }
+    if (fields & kScore) {
+        writer.WriteVarint(state.erased_layers);
+    }
+    if (fields & kErasedLayers) {
+        writer.WriteVarint(erased_layer_indices_.size());
+        for (auto layer : erased_layer_indices_) {
+            writer.WriteVarint(layer);
+        }
+    }
+    if (fields & kCells) {
+        writer.WriteVarint(changed_cells);
+        size_t previous_index = 0;
+        unsigned previous_value = 0;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (cells[i] == sent_cells[i]) {
+                continue;
+            }
+            writer.WriteVarint(i - previous_index);
+            writer.WriteVarint(cells[i] == previous_value
+                                   ? 0
+                                   : static_cast<uint64_t>(cells[i]) + 1);
+            previous_index = i;
+            previous_value = cells[i];
+            sent_cells[i] = cells[i];
+        }
+    }
+    if (fields & kBlock) {
+        const auto& block = state.falling_block;
+        writer.Write<uint8_t>(static_cast<uint8_t>(block.GetType()));
+        writer.Write(block.GetColor());
+        writer.Write<uint8_t>(block.GetCubeOffsets().size());
+        for (const auto& offset : block.GetCubeOffsets()) {
+            writer.WriteSignedVarint(offset.x);
+            writer.WriteSignedVarint(offset.y);
+            writer.WriteSignedVarint(offset.z);
+        }
+    }
+    if (fields & kBlockPosition) {
+        const auto& position = state.falling_block.GetPosition();
+        writer.WriteSignedVarint(position.x);
+        writer.WriteSignedVarint(position.y);
+        writer.WriteSignedVarint(position.z);
+    }
+    if (fields & (kBlock | kBlockPosition)) {
+        block_ = state.falling_block;
+    }
+
+    has_baseline_ = true;
+    phase_ = state.phase;
+    paused_ = state.paused;
+    erased_layers_ = state.erased_layers;
+
+    uint8_t flags = keyframe ? kKeyframe : 0;
+    if (compress_ && payload_.size() >= kMinCompressedSize) {
+        compressed_.clear();
+        LzCompress(payload_.data(), payload_.size(), compressed_);
+        if (compressed_.size() + 4 < payload_.size()) {
+            ByteWriter message_writer(message);
+            message_writer.Write<uint8_t>(flags | kCompressed);
+            message_writer.WriteVarint(payload_.size());
+            message_writer.WriteBytes(compressed_.data(), compressed_.size());
+            return;
+        }
+    }
+    ByteWriter message_writer(message);
+    message_writer.Write<uint8_t>(flags);
+    message_writer.WriteBytes(payload_.data(), payload_.size());
+}
+
+uint64_t SpectatorStreamDecoder::Decode(const uint8_t* data, size_t size,
+                                        GameState& state) {
+    ByteReader reader(data, data + size);
+    auto flags = reader.Read<uint8_t>();
+    const uint8_t* payload_begin = reader.GetPosition();
+    const uint8_t* payload_end = data + size;
+    if (flags & kCompressed) {
+        auto payload_size = reader.ReadVarint();
+        if (payload_size > kMaxPayloadSize) {
+            throw Error("Spectator stream message is too large");
+        }
+        payload_.clear();
+        LzDecompress(reader.GetPosition(), payload_end - reader.GetPosition(),
+                     payload_size, payload_);
+        payload_begin = payload_.data();
+        payload_end = payload_.data() + payload_.size();
+    }
+
+    ByteReader payload(payload_begin, payload_end);
+    auto tick = payload.ReadVarint();
+    auto fields = payload.Read<uint8_t>();
+    auto& board = state.board;
+    if (flags & kKeyframe) {
+        auto width = payload.ReadVarint();
+        auto depth = payload.ReadVarint();
+        auto height = payload.ReadVarint();
+        if (width > kMaxDimension || depth > kMaxDimension ||
+            height > kMaxDimension) {
+            throw Error("Spectator stream board is too large");
+        }
+        if (width != static_cast<uint64_t>(board.GetWidth()) ||
+            depth != static_cast<uint64_t>(board.GetDepth()) ||
+            height != static_cast<uint64_t>(board.GetHeight())) {
+            board = Board(width, depth, height);
+        } else {
+            std::fill(board.GetCells().begin(), board.GetCells().end(), 0);
+            board.MarkAllLayersDirty();
+        }
+        state.erased_layers = 0;
+        has_keyframe_ = true;
+    } else if (!has_keyframe_) {
+        throw Error("Spectator stream delta without keyframe");
+    }
+
+    if (fields & kPhase) {
+        auto phase = payload.Read<uint8_t>();
+        if (phase > static_cast<uint8_t>(GameState::Phase::Lost)) {
+            throw Error("Spectator stream phase is invalid");
+        }
+        state.phase = static_cast<GameState::Phase>(phase);
+        state.paused = payload.Read<uint8_t>() != 0;
+    }
+    if (fields & kScore) {
+        state.erased_layers = payload.ReadVarint();
+    }
+    if (fields & kErasedLayers) {
+        auto count = payload.ReadVarint();
+        for (uint64_t i = 0; i < count; ++i) {
+            auto layer = payload.ReadVarint();
+            if (layer >= static_cast<uint64_t>(board.GetHeight())) {
+                throw Error("Spectator stream layer is out of board");
+            }
+            board.EraseLayer(layer);
+        }
+    }
+    if (fields & kCells) {
+        auto& cells = board.GetCells();
+        auto layer_size = static_cast<uint64_t>(board.GetWidth()) *
+                          board.GetDepth();
+        auto count = payload.ReadVarint();
+        uint64_t index = 0;
+        unsigned previous_value = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            index += payload.ReadVarint();
+            if (index >= cells.size()) {
+                throw Error("Spectator stream cell is out of board");
+            }
+            auto value = payload.ReadVarint();
+            cells[index] = value ? static_cast<unsigned>(value - 1)
+                                 : previous_value;
+            previous_value = cells[index];
+            board.MarkLayerDirty(index / layer_size);
+        }
+    }
+    if (fields & kBlock) {
+        auto type = static_cast<BlockType>(payload.Read<uint8_t>());
+        auto color = payload.Read<ColorR8G8B8>();
+        if (type > BlockType::Undefined) {
+            throw Error("Spectator stream block type is invalid");
+        }
+        // NOTE: Position is kept, it is sent separately
+        auto& block = state.falling_block;
+        auto position = block.GetPosition();
+        if (type == BlockType::Undefined) {
+            block = Block();
+        } else {
+            block = Block::Create(type, color, board);
+        }
+        block.GetPosition() = position;
+        auto count = payload.Read<uint8_t>();
+        if (count > Block::kMaxCubes) {
+            throw Error("Spectator stream block is invalid");
+        }
+        auto& offsets = block.GetCubeOffsets();
+        offsets.resize(count);
+        for (auto& offset : offsets) {
+            offset.x = payload.ReadSignedVarint();
+            offset.y = payload.ReadSignedVarint();
+            offset.z = payload.ReadSignedVarint();
+        }
+    }
+    if (fields & kBlockPosition) {
+        auto& position = state.falling_block.GetPosition();
+        position.x = payload.ReadSignedVarint();
+        position.y = payload.ReadSignedVarint();
+        position.z = payload.ReadSignedVarint();
+    }
+    if (!payload.IsAtEnd()) {
+        throw Error("Spectator stream message has trailing data");
+    }
+    return tick;
+}
+
+} // namespace tetris3d
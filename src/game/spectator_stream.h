@@ -0,0 +1,87 @@
+#ifndef TETRIS3D_GAME_SPECTATOR_STREAM_H_
+#define TETRIS3D_GAME_SPECTATOR_STREAM_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "game/block.h"
+#include "game/board.h"
+#include "game/state.h"
+
+namespace tetris3d {
+
+// Compact stream of game states for spectators: a keyframe carries the
+// whole board once, following deltas only what changed during the tick
+// Message layout:
+// ----
+// u8 flags (kKeyframe, kCompressed)
+// [varint payload size, if compressed]
+// payload (LZ compressed, if flagged):
+//   varint tick
+//   u8 fields (kPhase, kScore, kErasedLayers, kCells, kBlock,
+//      kBlockPosition)
+//   [varint width, depth, height, if keyframe]
+//   [u8 phase, u8 paused, if kPhase]
+//   [varint erased layers total, if kScore]
+//   [varint count, varint layer indices in descending order, if
+//    kErasedLayers]
+//   [varint count, (varint index delta, varint value) per cell, if kCells]
+//   [u8 type, u8 r, g, b, u8 count, zigzag x, y, z per cube offset, if
+//    kBlock]
+//   [zigzag x, y, z of block position, if kBlockPosition]
+// ----
+// NOTE: Erased layers are sent as indices, so a layer clear shifting the
+// whole stack costs a byte or two; changed cells are sent in index order
+// with index deltas, and value 0 repeats the value of the previous cell (so
+// a merged block costs about 2 bytes per cube)
+class SpectatorStreamEncoder {
+public:
+    // @compress LZ compression is used when it makes the message smaller
+    explicit SpectatorStreamEncoder(bool compress = true);
+
+    // Appends message with the full state; following deltas are relative
+    // to it
+    void EncodeKeyframe(uint64_t tick, const GameState& state,
+                        std::vector<uint8_t>& message);
+
+    // Appends message with changes since the last encoded state (keyframe
+    // if there is none yet)
+    void EncodeDelta(uint64_t tick, const GameState& state,
+                     std::vector<uint8_t>& message);
+
+private:
+    void Encode(uint64_t tick, const GameState& state, bool keyframe,
+                std::vector<uint8_t>& message);
+
+    bool compress_ = true;
+    bool has_baseline_ = false;
+
+    // Last encoded state
+    Board board_{0, 0, 0};
+    Block block_;
+    GameState::Phase phase_ = GameState::Phase::Uninitialized;
+    bool paused_ = false;
+    unsigned erased_layers_ = 0;
+
+    std::vector<uint8_t> payload_;
+    std::vector<uint8_t> compressed_;
+    std::vector<unsigned> erased_layer_indices_;
+};
+
+// Rebuilds game state from messages of SpectatorStreamEncoder, so it can be
+// drawn by the regular renderers
+class SpectatorStreamDecoder {
+public:
+    // Applies message to the state; returns its tick
+    // NOTE: Throws Error on malformed message or on a delta not preceded by
+    // a keyframe; state board is resized to match the keyframe
+    uint64_t Decode(const uint8_t* data, size_t size, GameState& state);
+
+private:
+    bool has_keyframe_ = false;
+    std::vector<uint8_t> payload_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_SPECTATOR_STREAM_H_
@@ -5,6 +5,7 @@
 #include "game/block.h"
 #include "game/board.h"
 #include "game/camera.h"
+#include "game/random.h"
 
 namespace tetris3d {
 
@@ -17,7 +18,8 @@ struct GameState {
           block_speed_inc_multiplier(config.block_speed_inc_multiplier),
           block_speed_inc_period_seconds(config.block_speed_inc_period_seconds),
           seconds_from_last_speed_inc(config.block_speed_inc_period_seconds),
-          seconds_to_next_block_fall(config.block_init_fall_step_seconds) {}
+          seconds_to_next_block_fall(config.block_init_fall_step_seconds),
+          random(config.rand_seed) {}
 
     Board board;
     Block falling_block;
@@ -40,13 +42,20 @@ struct GameState {
     float block_current_speed = 0.f;
     // current normal speed (not accelerated)
     float block_current_normal_speed = 0.f;
-    const float block_max_fall_step_seconds = 0.f;
-    const float block_speed_inc_multiplier = 0.f;
-    const float block_speed_inc_period_seconds = 0.f;
+    float block_max_fall_step_seconds = 0.f;
+    float block_speed_inc_multiplier = 0.f;
+    float block_speed_inc_period_seconds = 0.f;
 
     float total_time = 0.f;
     float seconds_from_last_speed_inc = 0.f;
     float seconds_to_next_block_fall = 0.f;
+
+    // Total number of erased layers (score)
+    unsigned erased_layers = 0;
+
+    // NOTE: Source of all game randomness; part of the state, so a saved
+    // state resumes with the very same sequence of blocks
+    Random random;
 };
 
 } // namespace tetris3d
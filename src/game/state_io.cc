@@ -0,0 +1,147 @@
+#include "game/state_io.h"
+
+namespace {
+
+constexpr uint32_t kGameStateFormatVersion = 2;
+
+void WriteVec3(tetris3d::ByteWriter& writer, const glm::vec3& value) {
+    writer.Write(value.x);
+    writer.Write(value.y);
+    writer.Write(value.z);
+}
+
+glm::vec3 ReadVec3(tetris3d::ByteReader& reader) {
+    glm::vec3 value;
+    value.x = reader.Read<float>();
+    value.y = reader.Read<float>();
+    value.z = reader.Read<float>();
+    return value;
+}
+
+void WriteIVec3(tetris3d::ByteWriter& writer, const glm::ivec3& value) {
+    writer.Write<int32_t>(value.x);
+    writer.Write<int32_t>(value.y);
+    writer.Write<int32_t>(value.z);
+}
+
+glm::ivec3 ReadIVec3(tetris3d::ByteReader& reader) {
+    glm::ivec3 value;
+    value.x = reader.Read<int32_t>();
+    value.y = reader.Read<int32_t>();
+    value.z = reader.Read<int32_t>();
+    return value;
+}
+
+} // namespace
+
+namespace tetris3d {
+
+void WriteGameState(ByteWriter& writer, const GameState& state) {
+    writer.Write(kGameStateFormatVersion);
+
+    const auto& board = state.board;
+    writer.Write<int32_t>(board.GetWidth());
+    writer.Write<int32_t>(board.GetDepth());
+    writer.Write<int32_t>(board.GetHeight());
+    writer.WriteBytes(board.GetCells().data(),
+                      board.GetCells().size() * sizeof(unsigned));
+
+    const auto& block = state.falling_block;
+    writer.Write<uint8_t>(static_cast<uint8_t>(block.GetType()));
+    writer.Write(block.GetColor());
+    WriteIVec3(writer, block.GetPosition());
+    writer.Write<uint8_t>(block.GetCubeOffsets().size());
+    for (auto& offset : block.GetCubeOffsets()) {
+        WriteIVec3(writer, offset);
+    }
+
+    writer.Write<uint8_t>(static_cast<uint8_t>(state.phase));
+    writer.Write<uint8_t>(state.paused);
+    writer.Write(state.block_current_speed);
+    writer.Write(state.block_current_normal_speed);
+    writer.Write(state.block_max_fall_step_seconds);
+    writer.Write(state.block_speed_inc_multiplier);
+    writer.Write(state.block_speed_inc_period_seconds);
+    writer.Write(state.total_time);
+    writer.Write(state.seconds_from_last_speed_inc);
+    writer.Write(state.seconds_to_next_block_fall);
+    writer.Write(state.random.GetState());
+    writer.Write<uint32_t>(state.erased_layers);
+
+    WriteVec3(writer, state.camera.GetPosition());
+    WriteVec3(writer, state.camera.GetTarget());
+    WriteVec3(writer, state.camera.GetUp());
+    writer.Write(state.camera.GetFov());
+    writer.Write(state.camera.GetAspectRatio());
+}
+
+void ReadGameState(ByteReader& reader, GameState& state) {
+    if (reader.Read<uint32_t>() != kGameStateFormatVersion) {
+        throw Error("Unsupported game state format version");
+    }
+
+    auto& board = state.board;
+    auto width = reader.Read<int32_t>();
+    auto depth = reader.Read<int32_t>();
+    auto height = reader.Read<int32_t>();
+    if (width != board.GetWidth() || depth != board.GetDepth() ||
+        height != board.GetHeight()) {
+        throw Error("Serialized board dimensions do not match");
+    }
+    reader.ReadBytes(board.GetCells().data(),
+                     board.GetCells().size() * sizeof(unsigned));
+    board.MarkAllLayersDirty();
+
+    auto type = static_cast<BlockType>(reader.Read<uint8_t>());
+    auto color = reader.Read<ColorR8G8B8>();
+    auto position = ReadIVec3(reader);
+    auto offsets_count = reader.Read<uint8_t>();
+    if (type > BlockType::Undefined || offsets_count > Block::kMaxCubes) {
+        throw Error("Serialized block type is invalid");
+    }
+    if (type == BlockType::Undefined) {
+        state.falling_block = Block();
+    } else {
+        state.falling_block = Block::Create(type, color, board);
+    }
+    auto& offsets = state.falling_block.GetCubeOffsets();
+    offsets.resize(offsets_count);
+    for (auto& offset : offsets) {
+        offset = ReadIVec3(reader);
+        // NOTE: Cubes lie over the board (a lost block sticks out of its
+        // top), so the simulation never indexes cells out of the board
+        auto x = int64_t{position.x} + offset.x;
+        auto y = int64_t{position.y} + offset.y;
+        auto z = int64_t{position.z} + offset.z;
+        if (x < 0 || x >= width || z < 0 || z >= depth || y < 0 ||
+            y >= height + Block::kMaxCubes) {
+            throw Error("Serialized block position is invalid");
+        }
+    }
+    state.falling_block.GetPosition() = position;
+
+    auto phase = reader.Read<uint8_t>();
+    if (phase > static_cast<uint8_t>(GameState::Phase::Lost)) {
+        throw Error("Serialized game phase is invalid");
+    }
+    state.phase = static_cast<GameState::Phase>(phase);
+    state.paused = reader.Read<uint8_t>() != 0;
+    state.block_current_speed = reader.Read<float>();
+    state.block_current_normal_speed = reader.Read<float>();
+    state.block_max_fall_step_seconds = reader.Read<float>();
+    state.block_speed_inc_multiplier = reader.Read<float>();
+    state.block_speed_inc_period_seconds = reader.Read<float>();
+    state.total_time = reader.Read<float>();
+    state.seconds_from_last_speed_inc = reader.Read<float>();
+    state.seconds_to_next_block_fall = reader.Read<float>();
+    state.random.SetState(reader.Read<uint32_t>());
+    state.erased_layers = reader.Read<uint32_t>();
+
+    state.camera.SetPosition(ReadVec3(reader));
+    state.camera.SetTarget(ReadVec3(reader));
+    state.camera.SetUp(ReadVec3(reader));
+    state.camera.SetFov(reader.Read<float>());
+    state.camera.SetAspectRatio(reader.Read<float>());
+}
+
+} // namespace tetris3d
@@ -0,0 +1,103 @@
+#ifndef TETRIS3D_GAME_STATE_IO_H_
+#define TETRIS3D_GAME_STATE_IO_H_
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "error.h"
+#include "game/state.h"
+
+namespace tetris3d {
+
+// Appends raw little-endian values to a byte buffer
+class ByteWriter {
+public:
+    explicit ByteWriter(std::vector<uint8_t>& buffer) : buffer_(buffer) {}
+
+    template <typename T> void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteBytes(&value, sizeof(T));
+    }
+
+    void WriteBytes(const void* data, size_t size) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+    }
+
+    // LEB128: 7 bits per byte, high bit set on all bytes but the last
+    void WriteVarint(uint64_t value) {
+        while (value >= 0x80) {
+            buffer_.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buffer_.push_back(static_cast<uint8_t>(value));
+    }
+
+    // NOTE: Zigzag maps small negative values to small varints as well
+    void WriteSignedVarint(int64_t value) {
+        WriteVarint((static_cast<uint64_t>(value) << 1) ^
+                    static_cast<uint64_t>(value >> 63));
+    }
+
+private:
+    std::vector<uint8_t>& buffer_;
+};
+
+// Reads values written by ByteWriter; throws Error on truncated data
+class ByteReader {
+public:
+    ByteReader(const uint8_t* begin, const uint8_t* end)
+        : position_(begin), end_(end) {}
+
+    template <typename T> T Read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        ReadBytes(&value, sizeof(T));
+        return value;
+    }
+
+    void ReadBytes(void* data, size_t size) {
+        if (static_cast<size_t>(end_ - position_) < size) {
+            throw Error("Unexpected end of serialized data");
+        }
+        std::memcpy(data, position_, size);
+        position_ += size;
+    }
+
+    uint64_t ReadVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            auto byte = Read<uint8_t>();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw Error("Varint is too long");
+    }
+
+    int64_t ReadSignedVarint() {
+        auto value = ReadVarint();
+        return static_cast<int64_t>(value >> 1) ^
+               -static_cast<int64_t>(value & 1);
+    }
+
+    const uint8_t* GetPosition() const { return position_; }
+    bool IsAtEnd() const { return position_ == end_; }
+
+private:
+    const uint8_t* position_ = nullptr;
+    const uint8_t* end_ = nullptr;
+};
+
+// Binary (de)serialization of complete simulation state: board, falling
+// block, phase, speed timers, paused flag, random generator and camera
+// NOTE: Board dimensions of the target state must match serialized ones
+void WriteGameState(ByteWriter& writer, const GameState& state);
+void ReadGameState(ByteReader& reader, GameState& state);
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_STATE_IO_H_
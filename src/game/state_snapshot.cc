@@ -0,0 +1,51 @@
+#include "game/state_snapshot.h"
+
+#include <cstring>
+
+namespace tetris3d {
+
+GameStateSnapshot::GameStateSnapshot(const Board& board) {
+    cells_.resize(board.GetCells().size());
+}
+
+void GameStateSnapshot::Save(const GameState& state) {
+    const auto& cells = state.board.GetCells();
+    std::memcpy(cells_.data(), cells.data(), cells.size() * sizeof(unsigned));
+    block_ = state.falling_block;
+
+    phase_ = state.phase;
+    paused_ = state.paused;
+    block_current_speed_ = state.block_current_speed;
+    block_current_normal_speed_ = state.block_current_normal_speed;
+    block_max_fall_step_seconds_ = state.block_max_fall_step_seconds;
+    block_speed_inc_multiplier_ = state.block_speed_inc_multiplier;
+    block_speed_inc_period_seconds_ = state.block_speed_inc_period_seconds;
+    total_time_ = state.total_time;
+    seconds_from_last_speed_inc_ = state.seconds_from_last_speed_inc;
+    seconds_to_next_block_fall_ = state.seconds_to_next_block_fall;
+    erased_layers_ = state.erased_layers;
+    random_state_ = state.random.GetState();
+}
+
+void GameStateSnapshot::Restore(GameState& state) const {
+    auto& cells = state.board.GetCells();
+    std::memcpy(cells.data(), cells_.data(), cells.size() * sizeof(unsigned));
+    state.board.MarkAllLayersDirty();
+    // NOTE: Does not allocate, cube offsets are stored inline (CubeOffsets)
+    state.falling_block = block_;
+
+    state.phase = phase_;
+    state.paused = paused_;
+    state.block_current_speed = block_current_speed_;
+    state.block_current_normal_speed = block_current_normal_speed_;
+    state.block_max_fall_step_seconds = block_max_fall_step_seconds_;
+    state.block_speed_inc_multiplier = block_speed_inc_multiplier_;
+    state.block_speed_inc_period_seconds = block_speed_inc_period_seconds_;
+    state.total_time = total_time_;
+    state.seconds_from_last_speed_inc = seconds_from_last_speed_inc_;
+    state.seconds_to_next_block_fall = seconds_to_next_block_fall_;
+    state.erased_layers = erased_layers_;
+    state.random.SetState(random_state_);
+}
+
+} // namespace tetris3d
@@ -0,0 +1,45 @@
+#ifndef TETRIS3D_GAME_STATE_SNAPSHOT_H_
+#define TETRIS3D_GAME_STATE_SNAPSHOT_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "game/block.h"
+#include "game/state.h"
+
+namespace tetris3d {
+
+// Copy of the simulated part of GameState (camera is view only, so it is
+// left out) kept in storage preallocated for the board size
+// NOTE: Save and Restore are plain copies with no allocations, so states
+// can be snapshotted every tick and rolled back cheaply
+class GameStateSnapshot {
+public:
+    GameStateSnapshot() = default;
+    explicit GameStateSnapshot(const Board& board);
+
+    // NOTE: State board must have dimensions the snapshot was created for
+    void Save(const GameState& state);
+    void Restore(GameState& state) const;
+
+private:
+    std::vector<unsigned> cells_;
+    Block block_;
+
+    GameState::Phase phase_ = GameState::Phase::Uninitialized;
+    bool paused_ = false;
+    float block_current_speed_ = 0.f;
+    float block_current_normal_speed_ = 0.f;
+    float block_max_fall_step_seconds_ = 0.f;
+    float block_speed_inc_multiplier_ = 0.f;
+    float block_speed_inc_period_seconds_ = 0.f;
+    float total_time_ = 0.f;
+    float seconds_from_last_speed_inc_ = 0.f;
+    float seconds_to_next_block_fall_ = 0.f;
+    unsigned erased_layers_ = 0;
+    uint32_t random_state_ = 0;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_STATE_SNAPSHOT_H_
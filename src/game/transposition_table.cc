@@ -0,0 +1,55 @@
+#include "game/transposition_table.h"
+
+#include <bit>
+
+namespace tetris3d {
+
+TranspositionTable::TranspositionTable(unsigned bucket_count_log2)
+    : buckets_(new Bucket[size_t(1) << bucket_count_log2]),
+      mask_((uint64_t(1) << bucket_count_log2) - 1) {}
+
+bool TranspositionTable::Probe(uint64_t key, float& value) const {
+    const auto& bucket = buckets_[key & mask_];
+    for (const auto& entry : bucket.entries) {
+        auto data = entry.data.load(std::memory_order_relaxed);
+        auto check = entry.check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && (check | data)) {
+            value = std::bit_cast<float>(static_cast<uint32_t>(data));
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::Store(uint64_t key, float value) {
+    auto& bucket = buckets_[key & mask_];
+    uint64_t data = std::bit_cast<uint32_t>(value);
+
+    // NOTE: Prefer the entry holding the same key, then an empty one;
+    // otherwise replace an entry picked by high key bits
+    auto* target = &bucket.entries[(key >> 62) % kEntriesPerBucket];
+    for (auto& entry : bucket.entries) {
+        auto entry_data = entry.data.load(std::memory_order_relaxed);
+        auto entry_check = entry.check.load(std::memory_order_relaxed);
+        if ((entry_check ^ entry_data) == key) {
+            target = &entry;
+            break;
+        }
+        if (!entry_check && !entry_data) {
+            target = &entry;
+        }
+    }
+    target->data.store(data, std::memory_order_relaxed);
+    target->check.store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::Clear() {
+    for (uint64_t i = 0; i <= mask_; ++i) {
+        for (auto& entry : buckets_[i].entries) {
+            entry.data.store(0, std::memory_order_relaxed);
+            entry.check.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+} // namespace tetris3d
@@ -0,0 +1,44 @@
+#ifndef TETRIS3D_GAME_TRANSPOSITION_TABLE_H_
+#define TETRIS3D_GAME_TRANSPOSITION_TABLE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace tetris3d {
+
+// Fixed-size, lock-free hash table memoizing search values of board states
+// NOTE: Each entry stores (key ^ data, data) pair written with relaxed
+// atomics; a torn write by racing threads makes the pair inconsistent, so it
+// is simply treated as a miss (no locks needed)
+class TranspositionTable {
+public:
+    // @bucket_count_log2 table holds 4 * 2^bucket_count_log2 entries
+    explicit TranspositionTable(unsigned bucket_count_log2);
+
+    bool Probe(uint64_t key, float& value) const;
+    void Store(uint64_t key, float value);
+    void Clear();
+
+private:
+    static inline constexpr int kEntriesPerBucket = 4;
+
+    struct Entry {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    // NOTE: Bucket fills exactly one cache line, so probe touches one line
+    // and buckets used by different threads never share a line
+    struct alignas(64) Bucket {
+        Entry entries[kEntriesPerBucket];
+    };
+    static_assert(sizeof(Bucket) == 64);
+
+    std::unique_ptr<Bucket[]> buckets_;
+    uint64_t mask_ = 0;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_GAME_TRANSPOSITION_TABLE_H_
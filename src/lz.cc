@@ -0,0 +1,91 @@
+#include "lz.h"
+
+#include <cstring>
+
+#include "error.h"
+#include "game/state_io.h"
+
+namespace {
+
+constexpr int kHashBits = 12;
+constexpr size_t kMaxOffset = 1 << 16;
+
+uint32_t HashSequence(const uint8_t* data) {
+    uint32_t sequence;
+    std::memcpy(&sequence, data, sizeof(sequence));
+    return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+} // namespace
+
+namespace tetris3d {
+
+void LzCompress(const uint8_t* data, size_t size,
+                std::vector<uint8_t>& output) {
+    ByteWriter writer(output);
+    // NOTE: Positions are stored + 1, so zero marks an empty entry
+    uint32_t table[1 << kHashBits] = {};
+
+    size_t literals_begin = 0;
+    size_t position = 0;
+    while (position + kLzMinMatch <= size) {
+        auto hash = HashSequence(data + position);
+        size_t candidate = table[hash];
+        table[hash] = position + 1;
+        if (!candidate || position - (candidate - 1) > kMaxOffset ||
+            std::memcmp(data + candidate - 1, data + position, kLzMinMatch)) {
+            ++position;
+            continue;
+        }
+        --candidate;
+
+        auto length = kLzMinMatch;
+        while (position + length < size &&
+               data[candidate + length] == data[position + length]) {
+            ++length;
+        }
+
+        writer.WriteVarint(position - literals_begin);
+        writer.WriteBytes(data + literals_begin, position - literals_begin);
+        writer.WriteVarint(position - candidate);
+        writer.WriteVarint(length - kLzMinMatch);
+        position += length;
+        literals_begin = position;
+    }
+
+    writer.WriteVarint(size - literals_begin);
+    writer.WriteBytes(data + literals_begin, size - literals_begin);
+}
+
+void LzDecompress(const uint8_t* data, size_t size, size_t raw_size,
+                  std::vector<uint8_t>& output) {
+    ByteReader reader(data, data + size);
+    auto begin = output.size();
+    output.reserve(begin + raw_size);
+    while (true) {
+        auto literal_count = reader.ReadVarint();
+        if (literal_count > raw_size - (output.size() - begin)) {
+            throw Error("Compressed data is malformed");
+        }
+        auto literals_position = output.size();
+        output.resize(literals_position + literal_count);
+        reader.ReadBytes(output.data() + literals_position, literal_count);
+        if (output.size() - begin == raw_size) {
+            return;
+        }
+
+        auto offset = reader.ReadVarint();
+        auto length = reader.ReadVarint() + kLzMinMatch;
+        if (offset == 0 || offset > output.size() - begin ||
+            length > raw_size - (output.size() - begin)) {
+            throw Error("Compressed data is malformed");
+        }
+        // NOTE: Byte by byte, as the match may overlap its own output
+        auto source = output.size() - offset;
+        for (size_t i = 0; i < length; ++i) {
+            output.push_back(output[source + i]);
+        }
+    }
+}
+
+} // namespace tetris3d
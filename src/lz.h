@@ -0,0 +1,28 @@
+#ifndef TETRIS3D_LZ_H_
+#define TETRIS3D_LZ_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tetris3d {
+
+// Small LZ77 byte compressor (greedy matching through a hash table); meant
+// for short network messages, where speed matters more than ratio
+// Format: sequence of [varint literal count][literals][varint match offset]
+// [varint match length - kLzMinMatch], the last sequence has literals only
+// NOTE: Uncompressed size is not stored; callers transmit it themselves
+
+inline constexpr size_t kLzMinMatch = 4;
+
+// Appends compressed data to output
+void LzCompress(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+
+// Appends exactly raw_size decompressed bytes to output; throws Error on
+// malformed data
+void LzDecompress(const uint8_t* data, size_t size, size_t raw_size,
+                  std::vector<uint8_t>& output);
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_LZ_H_
@@ -0,0 +1,48 @@
+#include "net/latency_shim.h"
+
+#include <algorithm>
+
+namespace tetris3d {
+
+LatencyShim::LatencyShim(IPacketTransport& transport,
+                         const LatencyShimSettings& settings)
+    : transport_(transport), settings_(settings), random_(settings.seed) {}
+
+void LatencyShim::Send(const uint8_t* data, size_t size) {
+    SendDue();
+    if (random_.NextBelow(1000000) < settings_.loss * 1000000.f) {
+        return;
+    }
+
+    auto delay_ms = settings_.latency_ms;
+    if (settings_.jitter_ms > 0.f) {
+        delay_ms += settings_.jitter_ms * random_.NextBelow(1001) / 1000.f;
+    }
+    auto send_time =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<float, std::milli>(delay_ms));
+    delayed_.push_back({send_time, std::vector<uint8_t>(data, data + size)});
+}
+
+bool LatencyShim::Receive(std::vector<uint8_t>& packet) {
+    SendDue();
+    return transport_.Receive(packet);
+}
+
+void LatencyShim::SendDue() {
+    auto now = Clock::now();
+    auto due = std::stable_partition(
+        delayed_.begin(), delayed_.end(),
+        [&](const DelayedPacket& packet) { return packet.send_time > now; });
+    // NOTE: Due packets go out in their send time order
+    std::sort(due, delayed_.end(),
+              [](const DelayedPacket& a, const DelayedPacket& b) {
+                  return a.send_time < b.send_time;
+              });
+    for (auto it = due; it != delayed_.end(); ++it) {
+        transport_.Send(it->data.data(), it->data.size());
+    }
+    delayed_.erase(due, delayed_.end());
+}
+
+} // namespace tetris3d
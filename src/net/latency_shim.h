@@ -0,0 +1,52 @@
+#ifndef TETRIS3D_NET_LATENCY_SHIM_H_
+#define TETRIS3D_NET_LATENCY_SHIM_H_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "game/random.h"
+#include "net/packet_transport.h"
+
+namespace tetris3d {
+
+struct LatencyShimSettings {
+    float latency_ms = 0.f;
+    // Extra random delay up to this value; reorders packets as well
+    float jitter_ms = 0.f;
+    // Probability of dropping a packet
+    float loss = 0.f;
+    uint32_t seed = 1;
+};
+
+// Transport decorator simulating a bad network on outgoing packets, so
+// netcode can be tested over loopback
+// NOTE: Delayed packets go out from Send and Receive calls, so the owner
+// should call either of them regularly
+class LatencyShim : public IPacketTransport {
+public:
+    LatencyShim(IPacketTransport& transport,
+                const LatencyShimSettings& settings);
+
+    void Send(const uint8_t* data, size_t size) override;
+    bool Receive(std::vector<uint8_t>& packet) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct DelayedPacket {
+        Clock::time_point send_time;
+        std::vector<uint8_t> data;
+    };
+
+    void SendDue();
+
+    IPacketTransport& transport_;
+    LatencyShimSettings settings_;
+    Random random_;
+    std::vector<DelayedPacket> delayed_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_NET_LATENCY_SHIM_H_
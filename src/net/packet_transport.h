@@ -0,0 +1,23 @@
+#ifndef TETRIS3D_NET_PACKET_TRANSPORT_H_
+#define TETRIS3D_NET_PACKET_TRANSPORT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tetris3d {
+
+// Unreliable, unordered datagrams between two peers
+class IPacketTransport {
+public:
+    virtual ~IPacketTransport() = default;
+
+    virtual void Send(const uint8_t* data, size_t size) = 0;
+    // Replaces packet content with the next received one; returns false if
+    // none is pending (never blocks)
+    virtual bool Receive(std::vector<uint8_t>& packet) = 0;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_NET_PACKET_TRANSPORT_H_
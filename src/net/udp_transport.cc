@@ -0,0 +1,79 @@
+#include "net/udp_transport.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "error.h"
+
+namespace {
+
+sockaddr_in MakeAddress(const std::string& address, uint16_t port) {
+    sockaddr_in result = {};
+    result.sin_family = AF_INET;
+    result.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &result.sin_addr) != 1) {
+        throw tetris3d::Error("Invalid address: " + address);
+    }
+    return result;
+}
+
+} // namespace
+
+namespace tetris3d {
+
+UdpTransport::UdpTransport(const std::string& address, uint16_t port,
+                           const std::string& peer_address,
+                           uint16_t peer_port) {
+    auto local = MakeAddress(address, port);
+    auto peer = MakeAddress(peer_address, peer_port);
+
+    socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_ < 0) {
+        throw Error("Cannot create UDP socket");
+    }
+    if (bind(socket_, reinterpret_cast<sockaddr*>(&local), sizeof(local)) !=
+        0) {
+        close(socket_);
+        throw Error("Cannot bind UDP socket to " + address + ":" +
+                    std::to_string(port));
+    }
+    // NOTE: Connected socket filters out datagrams of other senders
+    if (connect(socket_, reinterpret_cast<sockaddr*>(&peer), sizeof(peer)) !=
+        0) {
+        close(socket_);
+        throw Error("Cannot set UDP peer " + peer_address + ":" +
+                    std::to_string(peer_port));
+    }
+}
+
+UdpTransport::~UdpTransport() {
+    if (socket_ >= 0) {
+        close(socket_);
+    }
+}
+
+void UdpTransport::Send(const uint8_t* data, size_t size) {
+    // NOTE: Failures (e.g. peer not listening yet) count as packet loss
+    send(socket_, data, size, MSG_DONTWAIT);
+}
+
+bool UdpTransport::Receive(std::vector<uint8_t>& packet) {
+    packet.resize(kMaxPacketSize);
+    while (true) {
+        auto size = recv(socket_, packet.data(), packet.size(), MSG_DONTWAIT);
+        if (size >= 0) {
+            packet.resize(size);
+            return true;
+        }
+        // NOTE: ECONNREFUSED reports an earlier send to a closed peer port
+        if (errno != EINTR && errno != ECONNREFUSED) {
+            packet.clear();
+            return false;
+        }
+    }
+}
+
+} // namespace tetris3d
@@ -0,0 +1,33 @@
+#ifndef TETRIS3D_NET_UDP_TRANSPORT_H_
+#define TETRIS3D_NET_UDP_TRANSPORT_H_
+
+#include <cstdint>
+#include <string>
+
+#include "net/packet_transport.h"
+
+namespace tetris3d {
+
+// Non-blocking UDP socket bound to a local port, exchanging packets with a
+// single peer; packets from other addresses are dropped
+class UdpTransport : public IPacketTransport {
+public:
+    UdpTransport(const std::string& address, uint16_t port,
+                 const std::string& peer_address, uint16_t peer_port);
+    ~UdpTransport() override;
+
+    void Send(const uint8_t* data, size_t size) override;
+    bool Receive(std::vector<uint8_t>& packet) override;
+
+private:
+    UdpTransport(const UdpTransport&) = delete;
+    UdpTransport& operator=(const UdpTransport&) = delete;
+
+    static inline constexpr size_t kMaxPacketSize = 1500;
+
+    int socket_ = -1;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_NET_UDP_TRANSPORT_H_
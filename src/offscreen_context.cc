@@ -0,0 +1,146 @@
+#include "offscreen_context.h"
+
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "glad/glad.h"
+
+#include "error.h"
+
+namespace tetris3d {
+namespace {
+
+EGLDisplay GetDisplay() {
+    // NOTE: Surfaceless platform needs neither X11/Wayland nor DRM device
+    auto extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions &&
+        std::strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        auto get_platform_display =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display) {
+            auto display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                                EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY) {
+                return display;
+            }
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+} // namespace
+
+OffscreenContext::OffscreenContext(Config::RendererType renderer_type,
+                                   int width, int height)
+    : width_(width), height_(height) {
+    try {
+        Create(renderer_type);
+    } catch (const Error&) {
+        Destroy();
+        throw;
+    }
+}
+
+OffscreenContext::~OffscreenContext() { Destroy(); }
+
+void OffscreenContext::Create(Config::RendererType renderer_type) {
+    auto display = GetDisplay();
+    if (display == EGL_NO_DISPLAY ||
+        !eglInitialize(display, nullptr, nullptr)) {
+        throw Error("Failed to initialize EGL display");
+    }
+    display_ = display;
+
+    const EGLint config_attributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(display, config_attributes, &config, 1,
+                         &config_count) ||
+        !config_count) {
+        throw Error("No EGL config for offscreen OpenGL rendering");
+    }
+
+    const EGLint surface_attributes[] = {
+        EGL_WIDTH, width_, EGL_HEIGHT, height_, EGL_NONE,
+    };
+    surface_ = eglCreatePbufferSurface(display, config, surface_attributes);
+    if (surface_ == EGL_NO_SURFACE) {
+        throw Error("Failed to create EGL pbuffer surface");
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        throw Error("EGL does not support OpenGL");
+    }
+    const EGLint basic_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 2,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_NONE,
+    };
+    const EGLint advanced_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    context_ = eglCreateContext(
+        display, config, EGL_NO_CONTEXT,
+        renderer_type == Config::RendererType::Basic ? basic_attributes
+                                                     : advanced_attributes);
+    if (context_ == EGL_NO_CONTEXT) {
+        throw Error("Failed to create EGL OpenGL context");
+    }
+    if (!eglMakeCurrent(display, surface_, surface_, context_)) {
+        throw Error("Failed to make EGL context current");
+    }
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+        throw Error("Failed to load OpenGL functions");
+    }
+}
+
+void OffscreenContext::Destroy() {
+    if (!display_) {
+        return;
+    }
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context_ != EGL_NO_CONTEXT) {
+        eglDestroyContext(display_, context_);
+    }
+    if (surface_ != EGL_NO_SURFACE) {
+        eglDestroySurface(display_, surface_);
+    }
+    eglTerminate(display_);
+    display_ = nullptr;
+}
+
+const char* OffscreenContext::GetRendererName() const {
+    return reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+}
+
+void OffscreenContext::ReadPixels(std::vector<uint8_t>& rgb) const {
+    auto row_size = static_cast<size_t>(width_) * 3;
+    rgb.resize(row_size * height_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+    // NOTE: GL rows go from the bottom one
+    std::vector<uint8_t> row(row_size);
+    for (int y = 0; y < height_ / 2; ++y) {
+        auto top = rgb.data() + y * row_size;
+        auto bottom = rgb.data() + (height_ - 1 - y) * row_size;
+        std::memcpy(row.data(), top, row_size);
+        std::memcpy(top, bottom, row_size);
+        std::memcpy(bottom, row.data(), row_size);
+    }
+}
+
+} // namespace tetris3d
@@ -0,0 +1,49 @@
+#ifndef TETRIS3D_OFFSCREEN_CONTEXT_H_
+#define TETRIS3D_OFFSCREEN_CONTEXT_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "config.h"
+
+namespace tetris3d {
+
+// OpenGL context without any window: renderers draw into an offscreen
+// (pbuffer) framebuffer of fixed size, which can be read back
+// NOTE: Uses EGL on Mesa surfaceless platform when available, so it works
+// without display server and GPU (llvmpipe); falls back to default display
+class OffscreenContext {
+public:
+    // Context version matches the renderer type, as for the game window:
+    // OpenGL 2.1 for Basic, 3.3 core for Advanced; throws Error on failure
+    OffscreenContext(Config::RendererType renderer_type, int width,
+                     int height);
+    ~OffscreenContext();
+
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+    // GL_RENDERER string, e.g. to tell llvmpipe from hardware
+    const char* GetRendererName() const;
+
+    // Waits for rendering to finish and copies the framebuffer as RGB rows
+    // from the top one
+    void ReadPixels(std::vector<uint8_t>& rgb) const;
+
+private:
+    OffscreenContext(const OffscreenContext&) = delete;
+    OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+    void Create(Config::RendererType renderer_type);
+    // Releases whatever was created so far
+    void Destroy();
+
+    int width_ = 0;
+    int height_ = 0;
+    void* display_ = nullptr;
+    void* surface_ = nullptr;
+    void* context_ = nullptr;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_OFFSCREEN_CONTEXT_H_
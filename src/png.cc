@@ -0,0 +1,128 @@
+#include "png.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "stb_image.h"
+
+#include "error.h"
+
+namespace tetris3d {
+namespace {
+
+// Largest payload of a stored deflate block
+constexpr size_t kMaxStoredBlock = 65535;
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const auto table = [] {
+        std::vector<uint32_t> table(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            auto value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+            }
+            table[i] = value;
+        }
+        return table;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void AppendBigEndian(std::vector<uint8_t>& output, uint32_t value) {
+    output.insert(output.end(), {static_cast<uint8_t>(value >> 24),
+                                 static_cast<uint8_t>(value >> 16),
+                                 static_cast<uint8_t>(value >> 8),
+                                 static_cast<uint8_t>(value)});
+}
+
+void AppendChunk(std::vector<uint8_t>& output, const char* type,
+                 const std::vector<uint8_t>& data) {
+    AppendBigEndian(output, data.size());
+    auto type_begin = output.size();
+    output.insert(output.end(), type, type + 4);
+    output.insert(output.end(), data.begin(), data.end());
+    AppendBigEndian(output, Crc32(output.data() + type_begin,
+                                  output.size() - type_begin));
+}
+
+// zlib stream of stored (uncompressed) deflate blocks
+std::vector<uint8_t> StoreZlib(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> output = {0x78, 0x01};
+    size_t offset = 0;
+    do {
+        auto size = std::min(kMaxStoredBlock, data.size() - offset);
+        auto last = offset + size == data.size();
+        output.push_back(last ? 1 : 0);
+        // NOTE: Block length and its one's complement, little endian
+        output.insert(output.end(), {static_cast<uint8_t>(size),
+                                     static_cast<uint8_t>(size >> 8),
+                                     static_cast<uint8_t>(~size),
+                                     static_cast<uint8_t>(~size >> 8)});
+        output.insert(output.end(), data.begin() + offset,
+                      data.begin() + offset + size);
+        offset += size;
+    } while (offset < data.size());
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (auto byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    AppendBigEndian(output, (b << 16) | a);
+    return output;
+}
+
+} // namespace
+
+void WritePng(const std::string& path, const RgbImage& image) {
+    auto row_size = static_cast<size_t>(image.width) * 3;
+    if (image.pixels.size() != row_size * image.height) {
+        throw Error("Image size does not match its pixels");
+    }
+
+    // NOTE: Every row starts with filter type; rows are not filtered
+    std::vector<uint8_t> rows;
+    rows.reserve((row_size + 1) * image.height);
+    for (int y = 0; y < image.height; ++y) {
+        rows.push_back(0);
+        auto row = image.pixels.begin() + y * row_size;
+        rows.insert(rows.end(), row, row + row_size);
+    }
+
+    std::vector<uint8_t> header;
+    AppendBigEndian(header, image.width);
+    AppendBigEndian(header, image.height);
+    // 8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    AppendChunk(png, "IHDR", header);
+    AppendChunk(png, "IDAT", StoreZlib(rows));
+    AppendChunk(png, "IEND", {});
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    if (!file) {
+        throw Error("Failed to write " + path);
+    }
+}
+
+RgbImage ReadPng(const std::string& path) {
+    RgbImage image;
+    int channels = 0;
+    auto pixels =
+        stbi_load(path.c_str(), &image.width, &image.height, &channels, 3);
+    if (!pixels) {
+        throw Error("Failed to read " + path + ": " + stbi_failure_reason());
+    }
+    image.pixels.assign(pixels, pixels + image.width * image.height * 3);
+    stbi_image_free(pixels);
+    return image;
+}
+
+} // namespace tetris3d
@@ -0,0 +1,28 @@
+#ifndef TETRIS3D_PNG_H_
+#define TETRIS3D_PNG_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tetris3d {
+
+// 8-bit RGB image, rows from the top one
+struct RgbImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Writes image as PNG; throws Error on failure
+// NOTE: Pixel data is stored in uncompressed deflate blocks, so no zlib is
+// needed; files are meant for golden image comparisons, not distribution
+void WritePng(const std::string& path, const RgbImage& image);
+
+// Reads any PNG (or other stb_image format, e.g. JPEG) converted to RGB;
+// throws Error on failure
+RgbImage ReadPng(const std::string& path);
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_PNG_H_
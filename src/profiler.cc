@@ -0,0 +1,137 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "error.h"
+
+namespace tetris3d {
+namespace {
+
+int64_t GetSteadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// NOTE: Names are string literals of the code, so they need no escaping
+// beyond quotes and backslashes
+void WriteJsonString(FILE* file, const char* value) {
+    fputc('"', file);
+    for (auto c = value; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+} // namespace
+
+Profiler& Profiler::Get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() : epoch_ns_(GetSteadyNanoseconds()) {}
+
+// NOTE: Queries are not deleted, the GL context is gone at exit
+Profiler::~Profiler() {}
+
+void Profiler::SetEnabled(bool value) {
+    if (value && !slots_) {
+        slots_ = std::make_unique<Slot[]>(kCapacity);
+    }
+    enabled_.store(value, std::memory_order_relaxed);
+}
+
+int64_t Profiler::GetTime() const { return GetSteadyNanoseconds() - epoch_ns_; }
+
+uint32_t Profiler::GetThreadId() {
+    thread_local uint32_t id = next_thread_++;
+    return id;
+}
+
+void Profiler::RecordCpu(const char* name, int64_t start_ns, int64_t end_ns) {
+    Sample sample;
+    sample.name = name;
+    sample.start_ns = start_ns;
+    sample.duration_ns = end_ns - start_ns;
+    sample.thread = GetThreadId();
+    Record(sample);
+}
+
+void Profiler::Record(const Sample& sample) {
+    if (!IsEnabled()) {
+        return;
+    }
+    // NOTE: Sequence of a slot is 2 * index + 1 while sample index is being
+    // written and 2 * index + 2 once it is complete
+    auto index = next_slot_.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = slots_[index % kCapacity];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.sample = sample;
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+void Profiler::WriteTrace(const std::string& path) const {
+    std::vector<Sample> samples;
+    if (slots_) {
+        auto end = next_slot_.load(std::memory_order_acquire);
+        auto begin = end > kCapacity ? end - kCapacity : 0;
+        samples.reserve(end - begin);
+        for (auto index = begin; index < end; ++index) {
+            const auto& slot = slots_[index % kCapacity];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * index + 2) {
+                continue;
+            }
+            auto sample = slot.sample;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+                samples.push_back(sample);
+            }
+        }
+    }
+
+    auto file = fopen(path.c_str(), "w");
+    if (!file) {
+        throw Error("Cannot create trace file: " + path);
+    }
+    uint32_t thread_count = 0;
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (const auto& sample : samples) {
+        fprintf(file,
+                "{\"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"cat\": \"%s\", "
+                "\"name\": ",
+                sample.thread, sample.thread == kGpuThread ? "gpu" : "cpu");
+        WriteJsonString(file, sample.name);
+        fprintf(file, ", \"ts\": %.3f, \"dur\": %.3f},\n",
+                sample.start_ns / 1000.0, sample.duration_ns / 1000.0);
+        thread_count = std::max(thread_count, sample.thread + 1);
+    }
+    // NOTE: Track name events also end the list without a trailing comma
+    auto track_count = std::max(thread_count, 1u);
+    for (uint32_t thread = 0; thread < track_count; ++thread) {
+        auto name = thread == kGpuThread
+                        ? std::string("GPU")
+                        : "CPU thread " + std::to_string(thread);
+        fprintf(file,
+                "{\"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"name\": "
+                "\"thread_name\", \"args\": {\"name\": \"%s\"}}%s\n",
+                thread, name.c_str(), thread + 1 < track_count ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    auto failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        throw Error("Failed to write trace file: " + path);
+    }
+    printf("Profile trace with %zu samples written to %s\n", samples.size(),
+           path.c_str());
+}
+
+} // namespace tetris3d
@@ -0,0 +1,154 @@
+#ifndef TETRIS3D_PROFILER_H_
+#define TETRIS3D_PROFILER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace tetris3d {
+
+// Frame profiler for shipped builds: timing samples of CPU scopes (any
+// thread) and GPU ranges (GL_TIME_ELAPSED queries) go into a fixed size
+// ring, which can be written as Chrome trace_event JSON any time (open in
+// chrome://tracing or Perfetto)
+// ----
+// NOTE: Disabled profiler costs one relaxed load per scope; samples are
+// recorded only after SetEnabled(true)
+// NOTE: Ring slots are guarded by sequence numbers (seqlock, as in
+// ObservationRing): writers never block each other nor the trace writer,
+// which skips slots being overwritten
+class Profiler {
+public:
+    // Samples kept; older ones are overwritten
+    static inline constexpr uint64_t kCapacity = 1 << 16;
+    // GPU results are read this many frames later, so reading never stalls
+    static inline constexpr unsigned kGpuFramesInFlight = 4;
+    static inline constexpr unsigned kMaxGpuRangesPerFrame = 16;
+
+    // The process-wide profiler; scopes anywhere in the game record into it
+    static Profiler& Get();
+
+    void SetEnabled(bool value);
+    bool IsEnabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Records a finished CPU scope of the calling thread
+    // @name must outlive the profiler (string literal)
+    void RecordCpu(const char* name, int64_t start_ns, int64_t end_ns);
+
+    // GPU ranges; GL thread only, ranges must not nest (GL_TIME_ELAPSED
+    // queries cannot); no-op if the context has no timer queries
+    // NOTE: Defined in profiler_gpu.cc, so code recording CPU scopes only
+    // links without GL (environment library)
+    void BeginGpuRange(const char* name);
+    void EndGpuRange();
+    // Collects GPU results of kGpuFramesInFlight frames ago; call once per
+    // frame on the GL thread, before any range of the frame
+    void BeginFrame();
+
+    // Writes samples in the ring as Chrome trace JSON; throws Error on
+    // failure
+    void WriteTrace(const std::string& path) const;
+
+    // Nanoseconds since the profiler was created
+    int64_t GetTime() const;
+
+private:
+    Profiler();
+    ~Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    struct Sample {
+        const char* name = nullptr;
+        int64_t start_ns = 0;
+        int64_t duration_ns = 0;
+        // Small id per recording thread; kGpuThread for GPU ranges
+        uint32_t thread = 0;
+    };
+
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        Sample sample;
+    };
+
+    struct GpuRange {
+        const char* name = nullptr;
+        // CPU time the range was issued at; GPU work starts no earlier
+        int64_t issue_ns = 0;
+    };
+
+    struct GpuFrame {
+        GpuRange ranges[kMaxGpuRangesPerFrame];
+        unsigned range_count = 0;
+    };
+
+    static inline constexpr uint32_t kGpuThread = 0;
+
+    void Record(const Sample& sample);
+    uint32_t GetThreadId();
+
+    std::atomic<bool> enabled_{false};
+    int64_t epoch_ns_ = 0;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> next_slot_{0};
+    std::atomic<uint32_t> next_thread_{kGpuThread + 1};
+
+    // GL thread only
+    bool gpu_checked_ = false;
+    bool gpu_supported_ = false;
+    unsigned gpu_queries_[kGpuFramesInFlight][kMaxGpuRangesPerFrame] = {};
+    GpuFrame gpu_frames_[kGpuFramesInFlight];
+    uint64_t gpu_frame_ = 0;
+    bool gpu_range_open_ = false;
+    // End of the latest GPU sample, so ranges do not overlap in the trace
+    int64_t gpu_end_ns_ = 0;
+};
+
+// Times the enclosing scope on the CPU
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name_(name) {
+        auto& profiler = Profiler::Get();
+        if (profiler.IsEnabled()) {
+            start_ns_ = profiler.GetTime();
+        }
+    }
+
+    ~ProfileScope() {
+        if (start_ns_ >= 0) {
+            auto& profiler = Profiler::Get();
+            profiler.RecordCpu(name_, start_ns_, profiler.GetTime());
+        }
+    }
+
+private:
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    const char* name_;
+    int64_t start_ns_ = -1;
+};
+
+// Times the enclosing scope on the CPU and the GL commands issued within it
+// (GL thread only)
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name) : cpu_scope_(name) {
+        Profiler::Get().BeginGpuRange(name);
+    }
+
+    ~GpuProfileScope() { Profiler::Get().EndGpuRange(); }
+
+private:
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+    ProfileScope cpu_scope_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_PROFILER_H_
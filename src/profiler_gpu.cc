@@ -0,0 +1,74 @@
+#include "profiler.h"
+
+#include <algorithm>
+
+#include "glad/glad.h"
+
+namespace tetris3d {
+
+void Profiler::BeginGpuRange(const char* name) {
+    if (!IsEnabled()) {
+        return;
+    }
+    if (!gpu_checked_) {
+        gpu_checked_ = true;
+        // NOTE: Timer queries are core since OpenGL 3.3; Basic renderer
+        // contexts (2.1) get CPU timing only
+        gpu_supported_ = GLAD_GL_VERSION_3_3 && glGetQueryObjecti64v;
+        if (gpu_supported_) {
+            glGenQueries(kGpuFramesInFlight * kMaxGpuRangesPerFrame,
+                         &gpu_queries_[0][0]);
+        }
+    }
+    auto frame = gpu_frame_ % kGpuFramesInFlight;
+    auto& ranges = gpu_frames_[frame];
+    if (!gpu_supported_ || gpu_range_open_ ||
+        ranges.range_count == kMaxGpuRangesPerFrame) {
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, gpu_queries_[frame][ranges.range_count]);
+    ranges.ranges[ranges.range_count] = GpuRange{name, GetTime()};
+    gpu_range_open_ = true;
+}
+
+void Profiler::EndGpuRange() {
+    if (!gpu_range_open_) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    ++gpu_frames_[gpu_frame_ % kGpuFramesInFlight].range_count;
+    gpu_range_open_ = false;
+}
+
+void Profiler::BeginFrame() {
+    ++gpu_frame_;
+    auto frame = gpu_frame_ % kGpuFramesInFlight;
+    auto& ranges = gpu_frames_[frame];
+    if (!ranges.range_count) {
+        return;
+    }
+    // NOTE: Queries finish in order, so the last one tells about all of
+    // them; results still not available are dropped rather than waited for
+    GLint available = 0;
+    glGetQueryObjectiv(gpu_queries_[frame][ranges.range_count - 1],
+                       GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available && IsEnabled()) {
+        for (unsigned i = 0; i < ranges.range_count; ++i) {
+            GLint64 duration_ns = 0;
+            glGetQueryObjecti64v(gpu_queries_[frame][i], GL_QUERY_RESULT,
+                                 &duration_ns);
+            // NOTE: Elapsed queries have no start time; GPU work of a range
+            // starts once issued and after the previous range
+            Sample sample;
+            sample.name = ranges.ranges[i].name;
+            sample.start_ns = std::max(ranges.ranges[i].issue_ns, gpu_end_ns_);
+            sample.duration_ns = duration_ns;
+            sample.thread = kGpuThread;
+            gpu_end_ns_ = sample.start_ns + sample.duration_ns;
+            Record(sample);
+        }
+    }
+    ranges.range_count = 0;
+}
+
+} // namespace tetris3d
@@ -0,0 +1,111 @@
+#include "rl/tetris3d_env.h"
+
+#include <exception>
+#include <string>
+
+#include "rl/vec_env.h"
+
+struct tetris3d_env {
+    tetris3d::VecEnv env;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+// NOTE: Exceptions must not cross the C boundary
+template <typename Fn> int Guard(Fn&& fn) {
+    try {
+        fn();
+        return 0;
+    } catch (const std::exception& error) {
+        last_error = error.what();
+    } catch (...) {
+        last_error = "Unknown error";
+    }
+    return -1;
+}
+
+int NullArgument() {
+    last_error = "Required argument is null";
+    return -1;
+}
+
+} // namespace
+
+extern "C" {
+
+tetris3d_env* tetris3d_env_create(const tetris3d_env_config* config) {
+    if (!config) {
+        NullArgument();
+        return nullptr;
+    }
+
+    tetris3d_env* env = nullptr;
+    Guard([&] {
+        tetris3d::Config game_config;
+        if (config->map_width > 0) {
+            game_config.map_width = config->map_width;
+        }
+        if (config->map_depth > 0) {
+            game_config.map_depth = config->map_depth;
+        }
+        if (config->map_height > 0) {
+            game_config.map_height = config->map_height;
+        }
+        env = new tetris3d_env{tetris3d::VecEnv(
+            game_config, config->env_count, config->thread_count)};
+    });
+    return env;
+}
+
+void tetris3d_env_destroy(tetris3d_env* env) { delete env; }
+
+int tetris3d_env_get_layout(const tetris3d_env* env,
+                            tetris3d_env_layout* layout) {
+    if (!env || !layout) {
+        return NullArgument();
+    }
+
+    const auto& observation_layout = env->env.GetObservationLayout();
+    const auto& board = env->env.GetState(0).board;
+    layout->occupancy_offset = observation_layout.occupancy_offset;
+    layout->block_cells_offset = observation_layout.block_cells_offset;
+    layout->phase_offset = observation_layout.phase_offset;
+    layout->size = observation_layout.size;
+    layout->env_count = env->env.GetEnvCount();
+    layout->cell_count = env->env.GetCellCount();
+    layout->max_block_cubes = tetris3d::Block::kMaxCubes;
+    layout->map_width = board.GetWidth();
+    layout->map_depth = board.GetDepth();
+    layout->map_height = board.GetHeight();
+    return 0;
+}
+
+int tetris3d_env_reset(tetris3d_env* env, uint32_t seed,
+                       uint8_t* observations) {
+    if (!env) {
+        return NullArgument();
+    }
+    return Guard([&] { env->env.Reset(seed, observations); });
+}
+
+int tetris3d_env_step(tetris3d_env* env, const uint8_t* actions,
+                      float* rewards, uint8_t* dones, uint8_t* observations) {
+    if (!env || !actions || !rewards || !dones) {
+        return NullArgument();
+    }
+    return Guard(
+        [&] { env->env.Step(actions, rewards, dones, observations); });
+}
+
+int tetris3d_env_observe(const tetris3d_env* env, uint8_t* observations) {
+    if (!env || !observations) {
+        return NullArgument();
+    }
+    return Guard([&] { env->env.Observe(observations); });
+}
+
+const char* tetris3d_env_last_error(void) { return last_error.c_str(); }
+
+} // extern "C"
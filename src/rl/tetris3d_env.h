@@ -0,0 +1,70 @@
+#ifndef TETRIS3D_RL_TETRIS3D_ENV_H_
+#define TETRIS3D_RL_TETRIS3D_ENV_H_
+
+// C interface of the vectorized environment (libtetris3d-env), usable from
+// training stacks through any FFI; see VecEnv for semantics
+// NOTE: Functions returning int return 0 on success and -1 on failure;
+// tetris3d_env_last_error describes the last failure of the calling thread
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tetris3d_env tetris3d_env;
+
+typedef struct tetris3d_env_config {
+    uint32_t env_count;
+    // Zero uses the game defaults
+    int32_t map_width;
+    int32_t map_depth;
+    int32_t map_height;
+    // Zero steps all envs on the calling thread
+    uint32_t thread_count;
+} tetris3d_env_config;
+
+// Byte offsets of observation fields, each an array over all envs:
+// occupancy u8 [env][cell_count], block cells i8 [env][max_block_cubes][3]
+// (x, y, z; -1 if unused), phase u8 [env]
+typedef struct tetris3d_env_layout {
+    uint64_t occupancy_offset;
+    uint64_t block_cells_offset;
+    uint64_t phase_offset;
+    // Size of the whole observation buffer
+    uint64_t size;
+    uint32_t env_count;
+    uint32_t cell_count;
+    uint32_t max_block_cubes;
+    int32_t map_width;
+    int32_t map_depth;
+    int32_t map_height;
+} tetris3d_env_layout;
+
+// Returns NULL on failure
+tetris3d_env* tetris3d_env_create(const tetris3d_env_config* config);
+void tetris3d_env_destroy(tetris3d_env* env);
+
+int tetris3d_env_get_layout(const tetris3d_env* env,
+                            tetris3d_env_layout* layout);
+
+// @observations optional (may be NULL)
+int tetris3d_env_reset(tetris3d_env* env, uint32_t seed,
+                       uint8_t* observations);
+
+// @actions GameCommand values, one per env
+// @rewards, @dones one per env
+// @observations optional (may be NULL)
+int tetris3d_env_step(tetris3d_env* env, const uint8_t* actions,
+                      float* rewards, uint8_t* dones, uint8_t* observations);
+
+int tetris3d_env_observe(const tetris3d_env* env, uint8_t* observations);
+
+const char* tetris3d_env_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TETRIS3D_RL_TETRIS3D_ENV_H_
@@ -0,0 +1,136 @@
+#include "rl/vec_env.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "game/game.h"
+
+namespace tetris3d {
+
+VecEnv::VecEnv(const Config& config, size_t env_count, unsigned thread_count)
+    : initial_state_(config) {
+    const auto& board = initial_state_.board;
+    // NOTE: Block cells are observed as signed bytes
+    constexpr int kMaxDimension = 127;
+    if (board.GetWidth() > kMaxDimension || board.GetDepth() > kMaxDimension ||
+        board.GetHeight() > kMaxDimension) {
+        throw Error("Environment board dimensions are too large");
+    }
+    if (env_count == 0) {
+        throw Error("Environment count must be positive");
+    }
+
+    cell_count_ = board.GetCells().size();
+    layout_.occupancy_offset = 0;
+    layout_.block_cells_offset = env_count * cell_count_;
+    layout_.phase_offset =
+        layout_.block_cells_offset + env_count * Block::kMaxCubes * 3;
+    layout_.size = layout_.phase_offset + env_count;
+
+    states_.reserve(env_count);
+    for (size_t i = 0; i < env_count; ++i) {
+        states_.push_back(initial_state_);
+    }
+    if (thread_count > 0) {
+        pool_ = std::make_unique<ThreadPool>(thread_count);
+    }
+}
+
+void VecEnv::Reset(uint32_t seed, uint8_t* observations) {
+    ForEachChunk([&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            states_[i].random.Seed(seed + i);
+            ResetEnv(states_[i]);
+            if (observations) {
+                ObserveEnv(i, observations);
+            }
+        }
+    });
+}
+
+void VecEnv::Step(const uint8_t* actions, float* rewards, uint8_t* dones,
+                  uint8_t* observations) {
+    ForEachChunk([&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            auto& state = states_[i];
+            auto action = actions[i];
+            if (action < static_cast<uint8_t>(GameCommand::Count) &&
+                action != static_cast<uint8_t>(GameCommand::TogglePause)) {
+                Game::ApplyCommand(state, static_cast<GameCommand>(action));
+            }
+
+            auto erased_layers = state.erased_layers;
+            Game::SingleStep(state);
+            rewards[i] =
+                static_cast<float>(state.erased_layers - erased_layers);
+            dones[i] = state.phase == GameState::Phase::Lost;
+            if (dones[i]) {
+                ResetEnv(state);
+            }
+
+            if (observations) {
+                ObserveEnv(i, observations);
+            }
+        }
+    });
+}
+
+void VecEnv::Observe(uint8_t* observations) const {
+    ForEachChunk([&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            ObserveEnv(i, observations);
+        }
+    });
+}
+
+void VecEnv::ForEachChunk(
+    const std::function<void(size_t, size_t)>& fn) const {
+    auto chunk_count = (states_.size() + kEnvsPerChunk - 1) / kEnvsPerChunk;
+    auto run_chunk = [&](size_t chunk, unsigned) {
+        auto begin = chunk * kEnvsPerChunk;
+        fn(begin, std::min(begin + kEnvsPerChunk, states_.size()));
+    };
+    if (pool_ && chunk_count > 1) {
+        pool_->ParallelFor(chunk_count, run_chunk);
+    } else {
+        for (size_t i = 0; i < chunk_count; ++i) {
+            run_chunk(i, 0);
+        }
+    }
+}
+
+void VecEnv::ResetEnv(GameState& state) const {
+    auto random = state.random;
+    state = initial_state_;
+    state.random = random;
+    // NOTE: Spawn the first block, so the very first observation has one
+    Game::SingleStep(state);
+}
+
+void VecEnv::ObserveEnv(size_t index, uint8_t* observations) const {
+    const auto& state = states_[index];
+
+    const auto& cells = state.board.GetCells();
+    auto* occupancy =
+        observations + layout_.occupancy_offset + index * cell_count_;
+    for (size_t i = 0; i < cell_count_; ++i) {
+        occupancy[i] = cells[i] != 0;
+    }
+
+    auto* block_cells = reinterpret_cast<int8_t*>(
+        observations + layout_.block_cells_offset +
+        index * Block::kMaxCubes * 3);
+    std::memset(block_cells, -1, Block::kMaxCubes * 3);
+    const auto& block = state.falling_block;
+    for (const auto& offset : block.GetCubeOffsets()) {
+        auto cell = block.GetPosition() + offset;
+        *block_cells++ = static_cast<int8_t>(cell.x);
+        *block_cells++ = static_cast<int8_t>(cell.y);
+        *block_cells++ = static_cast<int8_t>(cell.z);
+    }
+
+    observations[layout_.phase_offset + index] =
+        static_cast<uint8_t>(state.phase);
+}
+
+} // namespace tetris3d
@@ -0,0 +1,75 @@
+#ifndef TETRIS3D_RL_VEC_ENV_H_
+#define TETRIS3D_RL_VEC_ENV_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "config.h"
+#include "game/state.h"
+#include "thread_pool.h"
+
+namespace tetris3d {
+
+// Byte offsets of observation fields within a caller-provided buffer; every
+// field is an array over all envs, so it maps to a [env_count, ...] tensor
+struct ObservationLayout {
+    // u8 [env][cell]: 1 if taken, 0 if empty; in Board::GetCells order
+    size_t occupancy_offset = 0;
+    // i8 [env][Block::kMaxCubes][3]: x, y, z of falling block cubes; -1
+    // for unused entries
+    size_t block_cells_offset = 0;
+    // u8 [env]: GameState::Phase
+    size_t phase_offset = 0;
+    size_t size = 0;
+};
+
+// Batch of independent games stepped together (reinforcement learning)
+// NOTE: Each step applies one command and one logic tick
+// (Game::SingleStep), so time plays no role; game states live in a single
+// array and are processed in chunks, optionally spread over worker threads
+class VecEnv {
+public:
+    // @thread_count zero steps all envs on the calling thread
+    VecEnv(const Config& config, size_t env_count, unsigned thread_count);
+
+    size_t GetEnvCount() const { return states_.size(); }
+    size_t GetCellCount() const { return cell_count_; }
+    const ObservationLayout& GetObservationLayout() const { return layout_; }
+    const GameState& GetState(size_t index) const { return states_[index]; }
+
+    // Starts new episodes; env i is seeded with seed + i
+    // @observations optional buffer of ObservationLayout::size bytes
+    void Reset(uint32_t seed, uint8_t* observations);
+
+    // @actions one per env: GameCommand value; TogglePause and values out of
+    // range do nothing
+    // @rewards number of layers erased during the step
+    // @dones set if episode ended; such env starts a new episode right away
+    // (continuing its random sequence) and observes its first state
+    // @observations optional buffer of ObservationLayout::size bytes
+    void Step(const uint8_t* actions, float* rewards, uint8_t* dones,
+              uint8_t* observations);
+
+    void Observe(uint8_t* observations) const;
+
+private:
+    // Envs handled by a single thread pool task
+    static inline constexpr size_t kEnvsPerChunk = 64;
+
+    void ForEachChunk(const std::function<void(size_t, size_t)>& fn) const;
+    void ResetEnv(GameState& state) const;
+    void ObserveEnv(size_t index, uint8_t* observations) const;
+
+    // NOTE: Reset copies this state over the old one, reusing its memory
+    GameState initial_state_;
+    std::vector<GameState> states_;
+    size_t cell_count_ = 0;
+    ObservationLayout layout_;
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_RL_VEC_ENV_H_
@@ -0,0 +1,533 @@
+#include "server/game_server.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "game/game.h"
+#include "game/state_io.h"
+
+namespace {
+
+// Sessions stepped by a single thread pool task
+constexpr size_t kSessionsPerTask = 16;
+
+// Session falling further behind skips missed ticks instead of bursting
+constexpr int kMaxLagTicks = 5;
+
+// NOTE: Client not reading its messages must not grow memory unbounded
+constexpr size_t kMaxPendingOutput = 1 << 20;
+
+constexpr int kMaxEvents = 256;
+
+size_t BeginMessage(std::vector<uint8_t>& output,
+                    tetris3d::ServerMessage type) {
+    output.push_back(static_cast<uint8_t>(type));
+    output.resize(output.size() + sizeof(uint32_t));
+    return output.size();
+}
+
+void EndMessage(std::vector<uint8_t>& output, size_t begin) {
+    auto size = static_cast<uint32_t>(output.size() - begin);
+    std::memcpy(&output[begin - sizeof(size)], &size, sizeof(size));
+}
+
+// Throws Error on invalid options; called before any member is built, so
+// no pool thread is started for a server that cannot run
+const tetris3d::GameServerOptions&
+CheckOptions(const tetris3d::GameServerOptions& options) {
+    // NOTE: Tick duration must be representable by the clock
+    std::chrono::duration<double> tick_seconds(1.0 / options.tick_rate);
+    if (!(options.tick_rate > 0.f) || !std::isfinite(options.tick_rate) ||
+        tick_seconds >= std::chrono::steady_clock::duration::max()) {
+        throw tetris3d::Error("Server tick rate is out of range");
+    }
+    return options;
+}
+
+void SetNoDelay(int socket) {
+    int enable = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+} // namespace
+
+namespace tetris3d {
+
+GameServer::GameServer(const Config& config, const GameServerOptions& options)
+    : config_(config), options_(CheckOptions(options)),
+      tick_duration_(std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(1.0 / options_.tick_rate))),
+      pool_(options_.threads) {}
+
+GameServer::~GameServer() {
+    for (auto& session : sessions_) {
+        if (!session->closing) {
+            close(session->socket);
+        }
+    }
+    for (auto& spectator : spectators_) {
+        if (!spectator->closing) {
+            close(spectator->socket);
+        }
+    }
+    if (listener_ >= 0) {
+        close(listener_);
+    }
+    if (spectator_listener_ >= 0) {
+        close(spectator_listener_);
+    }
+    if (epoll_ >= 0) {
+        close(epoll_);
+    }
+}
+
+void GameServer::Run() {
+    Listen();
+    printf("Listening on %s:%u, %.0f ticks/sec, %u threads\n",
+           options_.address.c_str(), options_.port, options_.tick_rate,
+           pool_.GetThreadCount());
+    if (spectator_listener_ >= 0) {
+        printf("Spectators on %s:%u\n", options_.address.c_str(),
+               options_.spectator_port);
+    }
+
+    stats_time_ = Clock::now();
+    next_due_time_ = stats_time_ + tick_duration_;
+    epoll_event events[kMaxEvents];
+    while (!stopping_) {
+        auto now = Clock::now();
+        if (now >= next_due_time_) {
+            next_due_time_ = TickDueSessions(now);
+            now = Clock::now();
+        }
+        if (options_.stats_period_seconds > 0.f &&
+            now - stats_time_ >= std::chrono::duration<float>(
+                                     options_.stats_period_seconds)) {
+            PrintStats(now);
+        }
+
+        // NOTE: Round up, so the loop does not spin before the due tick
+        auto timeout = std::chrono::ceil<std::chrono::milliseconds>(
+            next_due_time_ - now);
+        auto count = epoll_wait(epoll_, events, kMaxEvents,
+                                std::max<int>(0, timeout.count()));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw Error("Server event loop failure");
+        }
+
+        for (int i = 0; i < count; ++i) {
+            auto socket = events[i].data.fd;
+            if (socket == listener_) {
+                Accept();
+                continue;
+            }
+            if (socket == spectator_listener_) {
+                AcceptSpectators();
+                continue;
+            }
+            Connection* connection = nullptr;
+            if (auto it = sessions_by_socket_.find(socket);
+                it != sessions_by_socket_.end()) {
+                connection = it->second;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    Receive(*it->second);
+                }
+            } else if (auto it = spectators_by_socket_.find(socket);
+                       it != spectators_by_socket_.end()) {
+                connection = it->second;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    Receive(*it->second);
+                }
+            }
+            if (connection && !connection->closing &&
+                (events[i].events & EPOLLOUT)) {
+                Flush(*connection);
+            }
+        }
+        RemoveClosedConnections();
+    }
+}
+
+void GameServer::Listen() {
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_ < 0) {
+        throw Error("Cannot create epoll instance");
+    }
+
+    listener_ = CreateListener(options_.port);
+    if (options_.spectator_port) {
+        spectator_listener_ = CreateListener(options_.spectator_port);
+    }
+}
+
+int GameServer::CreateListener(uint16_t port) {
+    int listener =
+        socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        throw Error("Cannot create server socket");
+    }
+    int enable = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, options_.address.c_str(), &address.sin_addr) != 1) {
+        close(listener);
+        throw Error("Invalid server address: " + options_.address);
+    }
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        close(listener);
+        throw Error("Cannot listen on " + options_.address + ":" +
+                    std::to_string(port));
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, listener, &event);
+    return listener;
+}
+
+void GameServer::Accept() {
+    while (true) {
+        int socket = accept4(listener_, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) {
+            // NOTE: EAGAIN ends the batch; other errors concern only the
+            // connection being accepted
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            continue;
+        }
+        if (sessions_by_socket_.size() >= options_.max_sessions) {
+            close(socket);
+            continue;
+        }
+        SetNoDelay(socket);
+
+        auto session = std::make_unique<Session>(config_);
+        session->id = next_session_id_++;
+        session->socket = socket;
+        session->state.random.Seed(config_.rand_seed + session->id);
+        session->next_tick_time = Clock::now() + tick_duration_;
+        next_due_time_ = std::min(next_due_time_, session->next_tick_time);
+
+        WriteWelcome(*session, *session);
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = socket;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, socket, &event);
+
+        sessions_by_socket_[socket] = session.get();
+        sessions_.push_back(std::move(session));
+        Flush(*sessions_.back());
+    }
+}
+
+void GameServer::AcceptSpectators() {
+    while (true) {
+        int socket = accept4(spectator_listener_, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            continue;
+        }
+        if (spectators_by_socket_.size() >= options_.max_spectators) {
+            close(socket);
+            continue;
+        }
+        SetNoDelay(socket);
+
+        auto spectator = std::make_unique<Spectator>();
+        spectator->socket = socket;
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = socket;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, socket, &event);
+
+        spectators_by_socket_[socket] = spectator.get();
+        spectators_.push_back(std::move(spectator));
+    }
+}
+
+void GameServer::Receive(Session& session) {
+    uint8_t buffer[256];
+    while (true) {
+        auto size = recv(session.socket, buffer, sizeof(buffer), 0);
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            Close(session);
+            return;
+        }
+
+        for (ssize_t i = 0; i < size; ++i) {
+            if (buffer[i] == kRestartCommand) {
+                session.restart_requested = true;
+            } else if (buffer[i] < static_cast<uint8_t>(GameCommand::Count)) {
+                // NOTE: Commands beyond batch capacity are dropped
+                session.commands.Push(static_cast<GameCommand>(buffer[i]));
+            }
+        }
+    }
+}
+
+void GameServer::Receive(Spectator& spectator) {
+    uint8_t buffer[256];
+    while (true) {
+        auto size = recv(spectator.socket, buffer, sizeof(buffer), 0);
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            Close(spectator);
+            return;
+        }
+
+        // NOTE: Anything after the session id is ignored
+        for (ssize_t i = 0; i < size && !spectator.session &&
+                            !spectator.closing;
+             ++i) {
+            spectator.request[spectator.request_size++] = buffer[i];
+            if (spectator.request_size == sizeof(spectator.request)) {
+                uint32_t session_id;
+                std::memcpy(&session_id, spectator.request,
+                            sizeof(session_id));
+                Watch(spectator, session_id);
+            }
+        }
+    }
+}
+
+void GameServer::Watch(Spectator& spectator, uint32_t session_id) {
+    auto it = std::find_if(sessions_.begin(), sessions_.end(),
+                           [&](const std::unique_ptr<Session>& session) {
+                               return session->id == session_id &&
+                                      !session->closing;
+                           });
+    if (it == sessions_.end()) {
+        Close(spectator);
+        return;
+    }
+
+    // NOTE: Keyframe of the last tick, following deltas of the session
+    // stream apply to it
+    auto& session = **it;
+    spectator.session = &session;
+    session.spectators.push_back(&spectator);
+    WriteWelcome(spectator, session);
+    keyframe_message_.clear();
+    keyframe_stream_.EncodeKeyframe(session.tick, session.state,
+                                    keyframe_message_);
+    WriteState(spectator, keyframe_message_);
+    Flush(spectator);
+}
+
+void GameServer::WriteWelcome(Connection& connection, const Session& session) {
+    auto begin = BeginMessage(connection.output, ServerMessage::Welcome);
+    ByteWriter writer(connection.output);
+    writer.Write<uint32_t>(session.id);
+    writer.Write<int32_t>(session.state.board.GetWidth());
+    writer.Write<int32_t>(session.state.board.GetDepth());
+    writer.Write<int32_t>(session.state.board.GetHeight());
+    writer.Write<float>(1.f / options_.tick_rate);
+    EndMessage(connection.output, begin);
+}
+
+void GameServer::WriteState(Connection& connection,
+                            const std::vector<uint8_t>& stream_message) {
+    auto begin = BeginMessage(connection.output, ServerMessage::State);
+    connection.output.insert(connection.output.end(), stream_message.begin(),
+                             stream_message.end());
+    EndMessage(connection.output, begin);
+}
+
+void GameServer::Flush(Connection& connection) {
+    auto& output = connection.output;
+    while (connection.output_offset < output.size()) {
+        auto size = send(connection.socket,
+                         output.data() + connection.output_offset,
+                         output.size() - connection.output_offset,
+                         MSG_NOSIGNAL);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (size < 0) {
+            Close(connection);
+            return;
+        }
+        connection.output_offset += size;
+        stats_sent_bytes_ += size;
+    }
+
+    auto pending = connection.output_offset < output.size();
+    if (pending &&
+        output.size() - connection.output_offset > kMaxPendingOutput) {
+        Close(connection);
+        return;
+    }
+    if (!pending) {
+        output.clear();
+        connection.output_offset = 0;
+    }
+    if (pending != connection.waiting_for_writable) {
+        epoll_event event = {};
+        event.events = EPOLLIN | (pending ? EPOLLOUT : 0);
+        event.data.fd = connection.socket;
+        epoll_ctl(epoll_, EPOLL_CTL_MOD, connection.socket, &event);
+        connection.waiting_for_writable = pending;
+    }
+}
+
+void GameServer::Close(Connection& connection) {
+    if (connection.closing) {
+        return;
+    }
+    epoll_ctl(epoll_, EPOLL_CTL_DEL, connection.socket, nullptr);
+    close(connection.socket);
+    sessions_by_socket_.erase(connection.socket);
+    spectators_by_socket_.erase(connection.socket);
+    connection.closing = true;
+}
+
+void GameServer::RemoveClosedConnections() {
+    for (auto& session : sessions_) {
+        if (session->closing) {
+            // NOTE: Spectators of an ended session have nothing to watch
+            for (auto* spectator : session->spectators) {
+                Close(*spectator);
+            }
+            session->spectators.clear();
+            continue;
+        }
+        auto& spectators = session->spectators;
+        spectators.erase(std::remove_if(spectators.begin(), spectators.end(),
+                                        [](const Spectator* spectator) {
+                                            return spectator->closing;
+                                        }),
+                         spectators.end());
+    }
+    sessions_.erase(std::remove_if(sessions_.begin(), sessions_.end(),
+                                   [](const std::unique_ptr<Session>& session) {
+                                       return session->closing;
+                                   }),
+                    sessions_.end());
+    spectators_.erase(
+        std::remove_if(spectators_.begin(), spectators_.end(),
+                       [](const std::unique_ptr<Spectator>& spectator) {
+                           return spectator->closing;
+                       }),
+        spectators_.end());
+}
+
+GameServer::Clock::time_point
+GameServer::TickDueSessions(Clock::time_point now) {
+    due_sessions_.clear();
+    for (auto& session : sessions_) {
+        if (!session->closing && session->next_tick_time <= now) {
+            due_sessions_.push_back(session.get());
+        }
+    }
+
+    auto task_count =
+        (due_sessions_.size() + kSessionsPerTask - 1) / kSessionsPerTask;
+    pool_.ParallelFor(task_count, [&](size_t task, unsigned) {
+        auto begin = task * kSessionsPerTask;
+        auto end = std::min(begin + kSessionsPerTask, due_sessions_.size());
+        for (auto i = begin; i < end; ++i) {
+            TickSession(*due_sessions_[i], now);
+        }
+    });
+    stats_ticks_ += due_sessions_.size();
+    stats_tick_time_ += Clock::now() - now;
+
+    for (auto* session : due_sessions_) {
+        Flush(*session);
+        for (auto* spectator : session->spectators) {
+            if (!spectator->closing) {
+                WriteState(*spectator, session->stream_message);
+                Flush(*spectator);
+            }
+        }
+    }
+
+    auto next_due_time = now + tick_duration_;
+    for (auto& session : sessions_) {
+        if (!session->closing) {
+            next_due_time = std::min(next_due_time, session->next_tick_time);
+        }
+    }
+    return next_due_time;
+}
+
+void GameServer::TickSession(Session& session, Clock::time_point now) {
+    auto& state = session.state;
+    if (session.restart_requested) {
+        auto random = state.random;
+        state = GameState(config_);
+        state.random = random;
+        session.restart_requested = false;
+    }
+
+    Game::Update(state, 1.f / options_.tick_rate, session.commands);
+    session.commands.Clear();
+    ++session.tick;
+
+    session.next_tick_time += tick_duration_;
+    if (now - session.next_tick_time > kMaxLagTicks * tick_duration_) {
+        session.next_tick_time = now + tick_duration_;
+    }
+
+    session.stream_message.clear();
+    session.stream.EncodeDelta(session.tick, state, session.stream_message);
+    WriteState(session, session.stream_message);
+}
+
+void GameServer::PrintStats(Clock::time_point now) {
+    auto seconds = std::chrono::duration<double>(now - stats_time_).count();
+    auto busy_seconds =
+        std::chrono::duration<double>(stats_tick_time_).count();
+    printf("%zu sessions, %zu spectators, %.0f session ticks/sec, "
+           "simulation busy %.1f%%, sent %.1f KB/sec\n",
+           sessions_by_socket_.size(), spectators_by_socket_.size(),
+           stats_ticks_ / seconds, 100. * busy_seconds / seconds,
+           stats_sent_bytes_ / 1024. / seconds);
+    fflush(stdout);
+    stats_time_ = now;
+    stats_ticks_ = 0;
+    stats_sent_bytes_ = 0;
+    stats_tick_time_ = Clock::duration(0);
+}
+
+} // namespace tetris3d
@@ -0,0 +1,149 @@
+#ifndef TETRIS3D_SERVER_GAME_SERVER_H_
+#define TETRIS3D_SERVER_GAME_SERVER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "config.h"
+#include "game/command.h"
+#include "game/spectator_stream.h"
+#include "game/state.h"
+#include "thread_pool.h"
+
+namespace tetris3d {
+
+// Protocol (TCP, little endian):
+// ----
+// client -> server: one byte per command, GameCommand value or
+//                   kRestartCommand; commands apply on the next tick
+// spectator -> server (spectator port): u32 id of the session to watch
+// server -> client, spectator: messages [u8 ServerMessage][u32 payload
+//                   size][payload]
+// ----
+// Welcome: u32 session id, i32 map width, depth, height, f32 tick seconds
+// State: SpectatorStreamEncoder message, one per tick; the first one after
+//        Welcome is a keyframe, so SpectatorStreamDecoder rebuilds the state
+enum class ServerMessage : uint8_t { Welcome, State };
+
+struct GameServerOptions {
+    std::string address = "127.0.0.1";
+    uint16_t port = 7777;
+    // Port for spectators watching sessions; zero disables spectating
+    uint16_t spectator_port = 7778;
+    float tick_rate = 60.f;
+    // Zero uses one thread per hardware thread
+    unsigned threads = 0;
+    unsigned max_sessions = 1024;
+    unsigned max_spectators = 4096;
+    // Seconds between statistics printouts; zero disables them
+    float stats_period_seconds = 10.f;
+};
+
+// Hosts many independent game sessions, one per connected client; any
+// number of spectators may watch a session
+// NOTE: A single thread owns all sockets (epoll event loop); sessions due
+// for a tick are stepped in batches on the thread pool meanwhile the event
+// loop waits for them, so sessions are never touched concurrently
+class GameServer {
+public:
+    static inline constexpr uint8_t kRestartCommand = 0xff;
+
+    GameServer(const Config& config, const GameServerOptions& options);
+    ~GameServer();
+
+    // Runs the event loop until Stop is called (e.g. from a signal handler)
+    void Run();
+    void Stop() { stopping_ = true; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection {
+        int socket = -1;
+        std::vector<uint8_t> output;
+        size_t output_offset = 0;
+        bool waiting_for_writable = false;
+        bool closing = false;
+    };
+
+    struct Spectator;
+
+    struct Session : Connection {
+        Session(const Config& config) : state(config) {}
+
+        uint32_t id = 0;
+        GameState state;
+        CommandBatch commands;
+        bool restart_requested = false;
+        uint64_t tick = 0;
+        Clock::time_point next_tick_time;
+        // NOTE: State message is encoded once per tick and shared by the
+        // player and all spectators
+        SpectatorStreamEncoder stream;
+        std::vector<uint8_t> stream_message;
+        std::vector<Spectator*> spectators;
+    };
+
+    struct Spectator : Connection {
+        Session* session = nullptr;
+        // Session id being received
+        uint8_t request[sizeof(uint32_t)];
+        size_t request_size = 0;
+    };
+
+    GameServer(const GameServer&) = delete;
+    GameServer& operator=(const GameServer&) = delete;
+
+    void Listen();
+    int CreateListener(uint16_t port);
+    void Accept();
+    void AcceptSpectators();
+    void Receive(Session& session);
+    void Receive(Spectator& spectator);
+    void Watch(Spectator& spectator, uint32_t session_id);
+    void WriteWelcome(Connection& connection, const Session& session);
+    void WriteState(Connection& connection,
+                    const std::vector<uint8_t>& stream_message);
+    void Flush(Connection& connection);
+    void Close(Connection& connection);
+    void RemoveClosedConnections();
+
+    // Steps all sessions due at now; returns time of the next due tick
+    Clock::time_point TickDueSessions(Clock::time_point now);
+    void TickSession(Session& session, Clock::time_point now);
+    void PrintStats(Clock::time_point now);
+
+    const Config& config_;
+    GameServerOptions options_;
+    Clock::duration tick_duration_;
+    ThreadPool pool_;
+
+    int epoll_ = -1;
+    int listener_ = -1;
+    int spectator_listener_ = -1;
+    std::atomic<bool> stopping_{false};
+
+    uint32_t next_session_id_ = 1;
+    std::vector<std::unique_ptr<Session>> sessions_;
+    std::unordered_map<int, Session*> sessions_by_socket_;
+    std::vector<Session*> due_sessions_;
+    std::vector<std::unique_ptr<Spectator>> spectators_;
+    std::unordered_map<int, Spectator*> spectators_by_socket_;
+    SpectatorStreamEncoder keyframe_stream_;
+    std::vector<uint8_t> keyframe_message_;
+    Clock::time_point next_due_time_;
+
+    Clock::time_point stats_time_;
+    uint64_t stats_ticks_ = 0;
+    uint64_t stats_sent_bytes_ = 0;
+    Clock::duration stats_tick_time_{0};
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_SERVER_GAME_SERVER_H_
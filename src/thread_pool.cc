@@ -0,0 +1,106 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace tetris3d {
+
+ThreadPool::ThreadPool(unsigned thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads_.reserve(thread_count);
+    for (unsigned i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    task_available_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+        ++pending_tasks_;
+    }
+    task_available_.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    tasks_done_.wait(lock, [this] { return pending_tasks_ == 0; });
+}
+
+void ThreadPool::ParallelFor(size_t count,
+                             const std::function<void(size_t, unsigned)>& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    // NOTE: Indices are handed out one by one from a shared counter, so
+    // uneven work per index is balanced automatically
+    std::atomic<size_t> next_index{0};
+    std::atomic<unsigned> next_worker{0};
+    std::atomic<unsigned> running{0};
+    std::mutex done_mutex;
+    std::condition_variable done;
+
+    auto work = [&](unsigned worker) {
+        for (auto i = next_index++; i < count; i = next_index++) {
+            fn(i, worker);
+        }
+    };
+
+    auto helpers = std::min<size_t>(GetThreadCount(), count - 1);
+    running = helpers;
+    for (size_t i = 0; i < helpers; ++i) {
+        Submit([&] {
+            work(next_worker++);
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--running == 0) {
+                done.notify_one();
+            }
+        });
+    }
+
+    work(GetThreadCount());
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&] { return running == 0; });
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            task_available_.wait(
+                lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (stopping_ && tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_tasks_ == 0) {
+                tasks_done_.notify_all();
+            }
+        }
+    }
+}
+
+} // namespace tetris3d
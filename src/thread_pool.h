@@ -0,0 +1,53 @@
+#ifndef TETRIS3D_THREAD_POOL_H_
+#define TETRIS3D_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tetris3d {
+
+// Fixed set of worker threads consuming a shared task queue
+class ThreadPool {
+public:
+    // Zero thread count means one thread per hardware thread
+    explicit ThreadPool(unsigned thread_count = 0);
+    ~ThreadPool();
+
+    unsigned GetThreadCount() const { return threads_.size(); }
+
+    // Runs task asynchronously on one of the workers
+    void Submit(std::function<void()> task);
+
+    // Waits until all submitted tasks are finished
+    void Wait();
+
+    // Calls fn(index, worker) for every index in [0, count) and blocks until
+    // all calls are done; the calling thread participates as well
+    // @worker index in range [0, GetThreadCount()], so callers can keep
+    // per-worker scratch data without synchronization
+    // NOTE: Must not be called from pool tasks, nor from two threads at once
+    void ParallelFor(size_t count,
+                     const std::function<void(size_t, unsigned)>& fn);
+
+private:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void WorkerLoop();
+
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable task_available_;
+    std::condition_variable tasks_done_;
+    size_t pending_tasks_ = 0;
+    bool stopping_ = false;
+};
+
+} // namespace tetris3d
+
+#endif // TETRIS3D_THREAD_POOL_H_
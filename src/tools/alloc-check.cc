@@ -0,0 +1,188 @@
+// tetris3d-alloc-check: a bot plays games offscreen, and the check fails
+// if the steady state (Game::Update and Render after warm-up) allocates
+// from the heap; prints the call sites of the allocations found
+//
+// NOTE: The bot issues player-like commands (moves, rotations, drops) at a
+// human pace; its own search is not checked, it runs out of the scope
+// NOTE: Linked with the counting operator new (allocation_hook.cc), unlike
+// other tools; run from the repository root, renderers load data/
+// relatively
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "allocation_stats.h"
+#include "config.h"
+#include "error.h"
+#include "game/bot.h"
+#include "game/game.h"
+#include "game/renderer.h"
+#include "offscreen_context.h"
+
+namespace tetris3d {
+namespace {
+
+constexpr float kStepSeconds = 1.f / 60.f;
+constexpr const char* kSteadyScope = "steady state";
+
+struct CheckOptions {
+    // basic, advanced or all
+    std::string renderer = "all";
+    int width = 320;
+    int height = 240;
+    // Frames before the check starts (buffers and caches reach their size)
+    unsigned warmup_frames = 600;
+    unsigned frames = 3000;
+    // Call sites printed on failure
+    unsigned top_call_sites = 10;
+};
+
+void PrintUsage() {
+    printf("Usage: tetris3d-alloc-check [options]\n"
+           "  --renderer NAME    basic, advanced or all (all)\n"
+           "  --size WxH         framebuffer size (320x240)\n"
+           "  --warmup N         frames not checked (600)\n"
+           "  --frames N         checked frames (3000)\n"
+           "  --top N            call sites printed on failure (10)\n");
+}
+
+// Returns false if only usage was requested
+bool ParseOptions(int argc, char** argv, CheckOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view name = argv[i];
+        if (name == "-h" || name == "--help") {
+            PrintUsage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            throw Error("Missing value of " + std::string(name));
+        }
+        std::string value = argv[++i];
+        if (name == "--renderer") {
+            if (value != "basic" && value != "advanced" && value != "all") {
+                throw Error("Unknown renderer: " + value);
+            }
+            options.renderer = value;
+        } else if (name == "--size") {
+            if (sscanf(value.c_str(), "%dx%d", &options.width,
+                       &options.height) != 2 ||
+                options.width <= 0 || options.height <= 0) {
+                throw Error("Invalid value of --size: " + value);
+            }
+        } else if (name == "--warmup") {
+            options.warmup_frames = std::stoul(value);
+        } else if (name == "--frames") {
+            options.frames = std::stoul(value);
+        } else if (name == "--top") {
+            options.top_call_sites = std::stoul(value);
+        } else {
+            throw Error("Unknown option: " + std::string(name));
+        }
+    }
+    return true;
+}
+
+void CenterCamera(const Board& board, float aspect_ratio,
+                  PerspectiveCamera& camera) {
+    camera.SetPosition(glm::vec3(2.5f * board.GetWidth(),
+                                 board.GetHeight() / 2.f,
+                                 2.5f * board.GetDepth()));
+    camera.SetTarget(glm::vec3(board.GetWidth() / 2.f,
+                               board.GetHeight() / 2.f,
+                               board.GetDepth() / 2.f));
+    camera.SetUp(glm::vec3(0.f, 1.f, 0.f));
+    camera.SetAspectRatio(aspect_ratio);
+}
+
+// Returns true if the steady state did not allocate
+bool RunRenderer(const CheckOptions& options, Config::RendererType type,
+                 const std::string& renderer_name) {
+    OffscreenContext context(type, options.width, options.height);
+    printf("%s renderer on %s, %u warm-up and %u checked frames\n",
+           renderer_name.c_str(), context.GetRendererName(),
+           options.warmup_frames, options.frames);
+
+    Config config;
+    GameState state(config);
+    std::unique_ptr<IRenderer> renderer;
+    if (type == Config::RendererType::Basic) {
+        renderer = std::make_unique<BasicRenderer>(config);
+        renderer->StartUp(state);
+    } else {
+        auto advanced = std::make_unique<AdvancedRenderer>(config);
+        advanced->StartUp(state);
+        advanced->FinishLoading();
+        renderer = std::move(advanced);
+    }
+    renderer->SetFramebufferWidth(options.width);
+    renderer->SetFramebufferHeight(options.height);
+    auto aspect_ratio = static_cast<float>(options.width) / options.height;
+    CenterCamera(state.board, aspect_ratio, state.camera);
+
+    auto& tracker = AllocationTracker::Get();
+    tracker.Reset();
+    tracker.SetEnabled(true);
+    HeuristicBot bot(BotWeights::FromConfig(config), nullptr);
+    CommandBatch commands;
+    unsigned games = 1;
+    unsigned erased_layers = 0;
+    for (unsigned frame = 0; frame < options.warmup_frames + options.frames;
+         ++frame) {
+        // NOTE: New game is not a steady state; it starts out of the scope
+        if (state.phase == GameState::Phase::Lost) {
+            erased_layers += state.erased_layers;
+            state = GameState(config);
+            CenterCamera(state.board, aspect_ratio, state.camera);
+            ++games;
+        }
+        commands.Clear();
+        bot.Update(state, kStepSeconds, config.autoplay_commands_per_second,
+                   commands);
+        auto steady = frame >= options.warmup_frames;
+        AllocationScope scope(steady ? kSteadyScope : "warm-up");
+        Game::Update(state, kStepSeconds, commands);
+        renderer->Render(state, state.camera);
+    }
+    tracker.SetEnabled(false);
+
+    auto stats = tracker.GetScopeStats(kSteadyScope);
+    printf("%u games, %u erased layers; steady state: %llu allocations, "
+           "%llu bytes\n",
+           games, erased_layers + state.erased_layers,
+           static_cast<unsigned long long>(stats.count),
+           static_cast<unsigned long long>(stats.bytes));
+    if (stats.count) {
+        tracker.PrintReport(options.top_call_sites, kSteadyScope);
+    }
+    return stats.count == 0;
+}
+
+} // namespace
+} // namespace tetris3d
+
+int main(int argc, char** argv) {
+    try {
+        tetris3d::CheckOptions options;
+        if (!tetris3d::ParseOptions(argc, argv, options)) {
+            return 0;
+        }
+        auto passed = true;
+        if (options.renderer != "advanced") {
+            passed &= tetris3d::RunRenderer(
+                options, tetris3d::Config::RendererType::Basic, "basic");
+        }
+        if (options.renderer != "basic") {
+            passed &= tetris3d::RunRenderer(
+                options, tetris3d::Config::RendererType::Advanced,
+                "advanced");
+        }
+        printf("%s\n", passed ? "PASSED" : "FAILED");
+        return passed ? 0 : 1;
+    } catch (const tetris3d::Error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+}
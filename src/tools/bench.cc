@@ -0,0 +1,651 @@
+// tetris3d-bench: micro-benchmarks of the core game kernels (layer erase
+// and checks, block validation, rotations with fix, falling checks, block
+// creation) over a range of board sizes
+//
+// Every benchmark is calibrated to a minimum sample time, warmed up and
+// then sampled repeatedly; median and median absolute deviation (MAD) of
+// the time per call are reported, as they are robust to outliers (other
+// processes, frequency changes). Results are written as JSON, so runs
+// before and after an optimization can be compared.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+#include "error.h"
+#include "game/block.h"
+#include "game/board.h"
+#include "game/game.h"
+#include "game/random.h"
+
+namespace tetris3d {
+namespace {
+
+// Inputs (blocks, block pairs) every call of a kernel cycles through, so
+// branches do not just learn a single case
+constexpr unsigned kInputCount = 256;
+// Full layers of the erase patterns, as many as a single merge can fill
+constexpr int kFilledLayers = 4;
+
+struct BenchOptions {
+    // Boards as WxDxH, comma separated
+    std::string sizes = "7x7x18,16x16x32,64x64x128,256x256x512";
+    // Only benchmarks whose name contains this run, if not empty
+    std::string filter;
+    // Samples not counted, after calibration
+    unsigned warmup = 3;
+    unsigned repetitions = 15;
+    // Calls per sample grow until a sample takes at least this long
+    float min_sample_ms = 5.f;
+    unsigned seed = 1;
+    // Results are written here if not empty
+    std::string json_path = "bench.json";
+};
+
+struct BoardSize {
+    int width = 0;
+    int depth = 0;
+    int height = 0;
+};
+
+// One measured piece of code
+struct Kernel {
+    std::string name;
+    // Input variant: fill pattern, rotation
+    std::string variant;
+    // Calls the measured code given times; returns a value depending on
+    // the results, so the calls cannot be optimized away
+    std::function<uint64_t(unsigned calls)> run;
+    // Restores what run changed, out of the timed region; kernels having
+    // it are timed call by call
+    std::function<void()> reset;
+};
+
+struct Result {
+    std::string name;
+    std::string variant;
+    std::string board;
+    unsigned calls_per_sample = 0;
+    unsigned samples = 0;
+    // Time per call
+    double median_ns = 0.0;
+    double mad_ns = 0.0;
+    double min_ns = 0.0;
+    double max_ns = 0.0;
+};
+
+void PrintUsage() {
+    printf("Usage: tetris3d-bench [options]\n"
+           "  --sizes LIST       boards WxDxH, comma separated\n"
+           "                     (7x7x18,16x16x32,64x64x128,256x256x512)\n"
+           "  --filter TEXT      benchmarks whose name contains TEXT\n"
+           "  --warmup N         samples not counted (3)\n"
+           "  --repetitions N    counted samples (15)\n"
+           "  --min-sample-ms X  shortest sample, calls per sample grow\n"
+           "                     until reached (5)\n"
+           "  --seed N           seed of board fills and blocks (1)\n"
+           "  --json PATH        results as JSON, none if empty\n"
+           "                     (bench.json)\n");
+}
+
+unsigned ParseUnsigned(std::string_view name, const std::string& value) {
+    try {
+        size_t length = 0;
+        auto result = std::stoul(value, &length);
+        if (length == value.size()) {
+            return static_cast<unsigned>(result);
+        }
+    } catch (const std::exception&) {
+    }
+    throw Error("Invalid value of " + std::string(name) + ": " + value);
+}
+
+float ParseFloat(std::string_view name, const std::string& value) {
+    try {
+        size_t length = 0;
+        auto result = std::stof(value, &length);
+        if (length == value.size()) {
+            return result;
+        }
+    } catch (const std::exception&) {
+    }
+    throw Error("Invalid value of " + std::string(name) + ": " + value);
+}
+
+// Returns false if only usage was requested
+bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view name = argv[i];
+        if (name == "-h" || name == "--help") {
+            PrintUsage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            throw Error("Missing value of " + std::string(name));
+        }
+        std::string value = argv[++i];
+        if (name == "--sizes") {
+            options.sizes = value;
+        } else if (name == "--filter") {
+            options.filter = value;
+        } else if (name == "--warmup") {
+            options.warmup = ParseUnsigned(name, value);
+        } else if (name == "--repetitions") {
+            options.repetitions = ParseUnsigned(name, value);
+        } else if (name == "--min-sample-ms") {
+            options.min_sample_ms = ParseFloat(name, value);
+        } else if (name == "--seed") {
+            options.seed = ParseUnsigned(name, value);
+        } else if (name == "--json") {
+            options.json_path = value;
+        } else {
+            throw Error("Unknown option: " + std::string(name));
+        }
+    }
+    if (options.repetitions == 0) {
+        throw Error("At least one repetition is needed");
+    }
+    return true;
+}
+
+std::vector<BoardSize> ParseSizes(const std::string& value) {
+    std::vector<BoardSize> sizes;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        auto end = std::min(value.find(',', begin), value.size());
+        auto item = value.substr(begin, end - begin);
+        BoardSize size;
+        char rest = 0;
+        if (sscanf(item.c_str(), "%dx%dx%d%c", &size.width, &size.depth,
+                   &size.height, &rest) != 3 ||
+            size.width < 4 || size.depth < 4 || size.height < 8) {
+            throw Error("Invalid board size (at least 4x4x8): " + item);
+        }
+        // NOTE: Board cell indexing (x * width + z) assumes square boards
+        if (size.width != size.depth) {
+            throw Error("Board width and depth must be equal: " + item);
+        }
+        sizes.push_back(size);
+        begin = end + 1;
+    }
+    return sizes;
+}
+
+std::string ToString(const BoardSize& size) {
+    return std::to_string(size.width) + "x" + std::to_string(size.depth) +
+           "x" + std::to_string(size.height);
+}
+
+// NOTE: Same as Board::PositionToIndex, without float conversions
+size_t CellIndex(const Board& board, int x, int y, int z) {
+    return (static_cast<size_t>(x) * board.GetWidth() + z) +
+           (static_cast<size_t>(y) * board.GetWidth() * board.GetDepth());
+}
+
+unsigned RandomColor(Random& random) {
+    return 0x404040u | random.NextBelow(0xffffff);
+}
+
+// Fills layers [0, stack_height) at given density, leaving at least one
+// hole in every layer; cells above stay empty
+void FillStack(Board& board, int stack_height, unsigned density_percent,
+               Random& random) {
+    auto& cells = board.GetCells();
+    std::fill(cells.begin(), cells.end(), 0u);
+    for (int y = 0; y < stack_height; ++y) {
+        for (int x = 0; x < board.GetWidth(); ++x) {
+            for (int z = 0; z < board.GetDepth(); ++z) {
+                if (random.NextBelow(100) < density_percent) {
+                    cells[CellIndex(board, x, y, z)] = RandomColor(random);
+                }
+            }
+        }
+        auto hole_x = static_cast<int>(random.NextBelow(board.GetWidth()));
+        auto hole_z = static_cast<int>(random.NextBelow(board.GetDepth()));
+        cells[CellIndex(board, hole_x, y, hole_z)] = 0;
+    }
+    board.MarkAllLayersDirty();
+}
+
+void FillLayer(Board& board, int y, Random& random) {
+    auto& cells = board.GetCells();
+    for (int x = 0; x < board.GetWidth(); ++x) {
+        for (int z = 0; z < board.GetDepth(); ++z) {
+            cells[CellIndex(board, x, y, z)] = RandomColor(random);
+        }
+    }
+    board.MarkLayerDirty(y);
+}
+
+int GetStackHeight(const BoardSize& size) { return size.height / 2; }
+
+// Erase patterns: a half high stack with full layers at the bottom (the
+// whole stack moves down), at its top (little moves) or spread through
+// it, or with none (only the checks run)
+Board MakeErasePattern(const BoardSize& size, const std::string& pattern,
+                       Random& random) {
+    Board board(size.width, size.depth, size.height);
+    auto stack_height = GetStackHeight(size);
+    FillStack(board, stack_height, 90, random);
+    for (int i = 0; i < kFilledLayers; ++i) {
+        if (pattern == "bottom") {
+            FillLayer(board, i, random);
+        } else if (pattern == "top") {
+            FillLayer(board, stack_height - kFilledLayers + i, random);
+        } else if (pattern == "spread") {
+            FillLayer(board, (2 * i + 1) * stack_height / (2 * kFilledLayers),
+                      random);
+        }
+    }
+    return board;
+}
+
+// Valid blocks of random types and orientations around the top of the
+// stack, where the falling block moves and rotates during play
+std::vector<Block> MakeBlocks(const Board& board, int stack_height,
+                              Random& random) {
+    std::vector<Block> blocks;
+    for (unsigned attempt = 0;
+         blocks.size() < kInputCount && attempt < 1000 * kInputCount;
+         ++attempt) {
+        auto block = Block::CreateRandom(board, random);
+        for (auto turns = random.NextBelow(4); turns > 0; --turns) {
+            block.RotateYClockwise();
+        }
+        if (random.NextBelow(2)) {
+            block.RotateXClockwise();
+        }
+        glm::ivec3 position(random.NextBelow(board.GetWidth()),
+                            stack_height - 2 + random.NextBelow(6),
+                            random.NextBelow(board.GetDepth()));
+        block.Translate(position - block.GetPosition());
+        if (block.IsValid(board)) {
+            blocks.push_back(block);
+        }
+    }
+    if (blocks.empty()) {
+        throw Error("No valid block position found");
+    }
+    return blocks;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double GetNanosecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start)
+        .count();
+}
+
+// Time of the calls, resets excluded
+double MeasureSample(const Kernel& kernel, unsigned calls, uint64_t& sink) {
+    if (!kernel.reset) {
+        auto start = Clock::now();
+        sink += kernel.run(calls);
+        return GetNanosecondsSince(start);
+    }
+    double total_ns = 0.0;
+    for (unsigned call = 0; call < calls; ++call) {
+        kernel.reset();
+        auto start = Clock::now();
+        sink += kernel.run(1);
+        total_ns += GetNanosecondsSince(start);
+    }
+    return total_ns;
+}
+
+double GetMedian(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    auto middle = values.size() / 2;
+    return values.size() % 2 ? values[middle]
+                             : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+Result Measure(const BenchOptions& options, const Kernel& kernel,
+               const std::string& board, uint64_t& sink) {
+    // Calls double until a sample is long enough for the clock
+    // NOTE: Resets count here, so slow resets (large boards) keep samples
+    // short; such calls are timed one by one anyway
+    auto min_sample_ns = options.min_sample_ms * 1e6;
+    unsigned calls = 1;
+    while (calls < (1u << 30)) {
+        auto start = Clock::now();
+        MeasureSample(kernel, calls, sink);
+        if (GetNanosecondsSince(start) >= min_sample_ns) {
+            break;
+        }
+        calls *= 2;
+    }
+    for (unsigned i = 0; i < options.warmup; ++i) {
+        MeasureSample(kernel, calls, sink);
+    }
+    std::vector<double> call_ns;
+    for (unsigned i = 0; i < options.repetitions; ++i) {
+        call_ns.push_back(MeasureSample(kernel, calls, sink) / calls);
+    }
+
+    Result result;
+    result.name = kernel.name;
+    result.variant = kernel.variant;
+    result.board = board;
+    result.calls_per_sample = calls;
+    result.samples = options.repetitions;
+    result.median_ns = GetMedian(call_ns);
+    std::vector<double> deviations;
+    for (auto value : call_ns) {
+        deviations.push_back(std::abs(value - result.median_ns));
+    }
+    result.mad_ns = GetMedian(deviations);
+    result.min_ns = *std::min_element(call_ns.begin(), call_ns.end());
+    result.max_ns = *std::max_element(call_ns.begin(), call_ns.end());
+    return result;
+}
+
+void PrintResult(const Result& result) {
+    auto name = result.name + " " + result.variant;
+    auto relative_mad =
+        result.median_ns > 0.0 ? 100.0 * result.mad_ns / result.median_ns : 0.0;
+    printf("  %-48s %12.1f ns  MAD %5.1f%%  (%u x %u calls)\n", name.c_str(),
+           result.median_ns, relative_mad, result.samples,
+           result.calls_per_sample);
+}
+
+void WriteJson(const std::string& path, const BenchOptions& options,
+               const std::vector<Result>& results) {
+    auto file = fopen(path.c_str(), "w");
+    if (!file) {
+        throw Error("Cannot create results file: " + path);
+    }
+    // NOTE: Names and variants are identifiers of this file, so they need
+    // no escaping
+    fprintf(file,
+            "{\n  \"warmup\": %u,\n  \"repetitions\": %u,\n"
+            "  \"min_sample_ms\": %.3f,\n  \"seed\": %u,\n"
+            "  \"benchmarks\": [\n",
+            options.warmup, options.repetitions, options.min_sample_ms,
+            options.seed);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        fprintf(file,
+                "    {\"name\": \"%s\", \"variant\": \"%s\", "
+                "\"board\": \"%s\", \"calls_per_sample\": %u, "
+                "\"samples\": %u, \"median_ns\": %.3f, \"mad_ns\": %.3f, "
+                "\"min_ns\": %.3f, \"max_ns\": %.3f}%s\n",
+                result.name.c_str(), result.variant.c_str(),
+                result.board.c_str(), result.calls_per_sample,
+                result.samples, result.median_ns, result.mad_ns,
+                result.min_ns, result.max_ns,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+// Runs kernels of the filter one by one; kernels are built lazily, as
+// large boards take memory and time to set up
+class Suite {
+public:
+    Suite(const BenchOptions& options, const std::string& board,
+          std::vector<Result>& results)
+        : options_(options), board_(board), results_(results) {}
+
+    bool IsSelected(const std::string& name) const {
+        return options_.filter.empty() ||
+               name.find(options_.filter) != std::string::npos;
+    }
+
+    void Run(const Kernel& kernel) {
+        results_.push_back(Measure(options_, kernel, board_, sink_));
+        PrintResult(results_.back());
+    }
+
+    uint64_t GetSink() const { return sink_; }
+
+private:
+    const BenchOptions& options_;
+    std::string board_;
+    std::vector<Result>& results_;
+    uint64_t sink_ = 0;
+};
+
+struct Rotation {
+    const char* name;
+    bool (Block::*try_rotate_with_fix)(const Board&);
+    void (Block::*rotate)();
+};
+
+const Rotation kRotations[] = {
+    {"Block::TryRotateXClockwiseWithFix", &Block::TryRotateXClockwiseWithFix,
+     &Block::RotateXClockwise},
+    {"Block::TryRotateXCounterClockwiseWithFix",
+     &Block::TryRotateXCounterClockwiseWithFix,
+     &Block::RotateXCounterClockwise},
+    {"Block::TryRotateYClockwiseWithFix", &Block::TryRotateYClockwiseWithFix,
+     &Block::RotateYClockwise},
+    {"Block::TryRotateYCounterClockwiseWithFix",
+     &Block::TryRotateYCounterClockwiseWithFix,
+     &Block::RotateYCounterClockwise},
+    {"Block::TryRotateZClockwiseWithFix", &Block::TryRotateZClockwiseWithFix,
+     &Block::RotateZClockwise},
+    {"Block::TryRotateZCounterClockwiseWithFix",
+     &Block::TryRotateZCounterClockwiseWithFix,
+     &Block::RotateZCounterClockwise},
+};
+
+void RunBoardKernels(Suite& suite, const BoardSize& size, Random& random) {
+    if (suite.IsSelected("Board::EraseFilledLayers")) {
+        for (const char* pattern : {"none", "top", "spread", "bottom"}) {
+            auto source = MakeErasePattern(size, pattern, random);
+            auto board = source;
+            Kernel kernel;
+            kernel.name = "Board::EraseFilledLayers";
+            kernel.variant = pattern;
+            kernel.run = [&board](unsigned calls) {
+                uint64_t erased = 0;
+                for (unsigned i = 0; i < calls; ++i) {
+                    erased += board.EraseFilledLayers();
+                }
+                return erased;
+            };
+            // NOTE: Without full layers the board does not change
+            if (std::string_view(pattern) != "none") {
+                kernel.reset = [&board, &source] {
+                    board.GetCells() = source.GetCells();
+                };
+            }
+            suite.Run(kernel);
+        }
+    }
+
+    if (suite.IsSelected("Board::IsLayerFilled")) {
+        // Filled layer scans all cells; a stack layer usually stops early
+        auto board = MakeErasePattern(size, "bottom", random);
+        auto stack_height = GetStackHeight(size);
+        for (auto [variant, layer] : {std::pair<const char*, int>{"filled", 0},
+                                      {"stack", stack_height / 2}}) {
+            Kernel kernel;
+            kernel.name = "Board::IsLayerFilled";
+            kernel.variant = variant;
+            kernel.run = [&board, layer](unsigned calls) {
+                uint64_t filled = 0;
+                for (unsigned i = 0; i < calls; ++i) {
+                    filled += board.IsLayerFilled(layer);
+                }
+                return filled;
+            };
+            suite.Run(kernel);
+        }
+    }
+}
+
+void RunBlockKernels(Suite& suite, const BoardSize& size, Random& random) {
+    auto selected = suite.IsSelected("Block::IsValid") ||
+                    suite.IsSelected("Block::TryFix") ||
+                    suite.IsSelected("Game::CanFallingBlockFall") ||
+                    suite.IsSelected("Block::CreateRandom");
+    for (const auto& rotation : kRotations) {
+        selected = selected || suite.IsSelected(rotation.name);
+    }
+    if (!selected) {
+        return;
+    }
+    Board board(size.width, size.depth, size.height);
+    auto stack_height = GetStackHeight(size);
+    FillStack(board, stack_height, 70, random);
+    auto blocks = MakeBlocks(board, stack_height, random);
+
+    if (suite.IsSelected("Block::IsValid")) {
+        // Rotated copies are invalid now and then, like rotation attempts
+        auto candidates = blocks;
+        for (size_t i = 0; i < candidates.size(); i += 2) {
+            candidates[i].RotateZClockwise();
+        }
+        Kernel kernel;
+        kernel.name = "Block::IsValid";
+        kernel.variant = "stack";
+        kernel.run = [&board, &candidates](unsigned calls) {
+            uint64_t valid = 0;
+            for (unsigned i = 0; i < calls; ++i) {
+                valid += candidates[i % candidates.size()].IsValid(board);
+            }
+            return valid;
+        };
+        suite.Run(kernel);
+    }
+
+    // NOTE: Rotations change the block, so each call works on a copy of
+    // an input block; copying is part of the time
+    for (const auto& rotation : kRotations) {
+        if (!suite.IsSelected(rotation.name)) {
+            continue;
+        }
+        Kernel kernel;
+        kernel.name = rotation.name;
+        kernel.variant = "stack";
+        kernel.run = [&board, &blocks, &rotation](unsigned calls) {
+            uint64_t rotated = 0;
+            for (unsigned i = 0; i < calls; ++i) {
+                auto block = blocks[i % blocks.size()];
+                rotated += (block.*rotation.try_rotate_with_fix)(board);
+            }
+            return rotated;
+        };
+        suite.Run(kernel);
+    }
+
+    if (suite.IsSelected("Block::TryFix")) {
+        // Rotations invalidating a block, the case TryFix handles
+        std::vector<std::pair<Block, Block>> invalidated;
+        for (const auto& block : blocks) {
+            for (const auto& rotation : kRotations) {
+                auto rotated = block;
+                (rotated.*rotation.rotate)();
+                if (!rotated.IsValid(board)) {
+                    invalidated.emplace_back(rotated, block);
+                    break;
+                }
+            }
+        }
+        if (!invalidated.empty()) {
+            Kernel kernel;
+            kernel.name = "Block::TryFix";
+            kernel.variant = "rotated";
+            kernel.run = [&board, &invalidated](unsigned calls) {
+                uint64_t fixed = 0;
+                for (unsigned i = 0; i < calls; ++i) {
+                    const auto& [rotated, previous] =
+                        invalidated[i % invalidated.size()];
+                    auto block = rotated;
+                    fixed += block.TryFix(board, previous);
+                }
+                return fixed;
+            };
+            suite.Run(kernel);
+        }
+    }
+
+    if (suite.IsSelected("Game::CanFallingBlockFall")) {
+        Config config;
+        config.map_width = size.width;
+        config.map_depth = size.depth;
+        config.map_height = size.height;
+        GameState state(config);
+        state.board = board;
+        Kernel kernel;
+        kernel.name = "Game::CanFallingBlockFall";
+        kernel.variant = "stack";
+        // NOTE: Assigning the falling block is part of the time
+        kernel.run = [&state, &blocks](unsigned calls) {
+            uint64_t can_fall = 0;
+            for (unsigned i = 0; i < calls; ++i) {
+                state.falling_block = blocks[i % blocks.size()];
+                can_fall += Game::CanFallingBlockFall(state);
+            }
+            return can_fall;
+        };
+        suite.Run(kernel);
+    }
+
+    if (suite.IsSelected("Block::CreateRandom")) {
+        Kernel kernel;
+        kernel.name = "Block::CreateRandom";
+        kernel.variant = "stack";
+        kernel.run = [&board, &random](unsigned calls) {
+            uint64_t cubes = 0;
+            for (unsigned i = 0; i < calls; ++i) {
+                cubes += Block::CreateRandom(board, random)
+                             .GetCubeOffsets()
+                             .size();
+            }
+            return cubes;
+        };
+        suite.Run(kernel);
+    }
+}
+
+void Bench(const BenchOptions& options) {
+    auto sizes = ParseSizes(options.sizes);
+    std::vector<Result> results;
+    uint64_t sink = 0;
+    for (const auto& size : sizes) {
+        auto name = ToString(size);
+        printf("Board %s\n", name.c_str());
+        Random random(options.seed);
+        Suite suite(options, name, results);
+        RunBoardKernels(suite, size, random);
+        RunBlockKernels(suite, size, random);
+        sink += suite.GetSink();
+    }
+    // NOTE: Printed, so results of all calls are used
+    printf("%zu benchmarks (checksum %llu)\n", results.size(),
+           static_cast<unsigned long long>(sink));
+    if (!options.json_path.empty()) {
+        WriteJson(options.json_path, options, results);
+        printf("Results written to %s\n", options.json_path.c_str());
+    }
+}
+
+} // namespace
+} // namespace tetris3d
+
+int main(int argc, char** argv) {
+    try {
+        tetris3d::BenchOptions options;
+        if (!tetris3d::ParseOptions(argc, argv, options)) {
+            return 0;
+        }
+        tetris3d::Bench(options);
+    } catch (const tetris3d::Error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
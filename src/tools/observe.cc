@@ -0,0 +1,75 @@
+// tetris3d-observe: prints frames published by a running game into its
+// shared memory observation ring (Config::observation_shm_name)
+//
+// Usage: tetris3d-observe [name] [interval seconds]
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "error.h"
+#include "game/observation_ring.h"
+
+namespace tetris3d {
+namespace {
+
+int GetStackHeight(const ObservationRingHeader& header,
+                   const ObservationFrame& frame) {
+    for (int y = header.map_height - 1; y >= 0; --y) {
+        for (auto word : frame.occupancy[y]) {
+            if (word) {
+                return y + 1;
+            }
+        }
+    }
+    return 0;
+}
+
+void Observe(const std::string& name, float interval_seconds) {
+    ObservationRingReader reader;
+    reader.Open(name);
+    const auto& header = reader.GetHeader();
+    printf("Observing %s: board %dx%dx%d, %u slots\n", name.c_str(),
+           header.map_width, header.map_depth, header.map_height,
+           header.slot_count);
+
+    ObservationFrame frame;
+    uint64_t last_tick = UINT64_MAX;
+    while (true) {
+        if (reader.ReadLatest(frame) && frame.tick != last_tick) {
+            last_tick = frame.tick;
+            printf("tick %llu: phase %u%s, layers %u, stack %d, colors %u, "
+                   "block %u at (%d, %d, %d), ghost %+d, time %.1fs\n",
+                   static_cast<unsigned long long>(frame.tick), frame.phase,
+                   frame.paused ? " (paused)" : "", frame.erased_layers,
+                   GetStackHeight(header, frame), frame.palette_size - 1u,
+                   frame.block_type, frame.block_cells[0][0],
+                   frame.block_cells[0][1], frame.block_cells[0][2],
+                   frame.ghost_offset_y, frame.total_time);
+            fflush(stdout);
+        }
+        std::this_thread::sleep_for(
+            std::chrono::duration<float>(interval_seconds));
+    }
+}
+
+} // namespace
+} // namespace tetris3d
+
+int main(int argc, char** argv) {
+    try {
+        std::string name = argc > 1 ? argv[1] : "/tetris3d";
+        float interval_seconds = argc > 2 ? std::stof(argv[2]) : 0.5f;
+        tetris3d::Observe(name, interval_seconds);
+    } catch (const tetris3d::Error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    } catch (const std::exception& error) {
+        std::cerr << "Invalid arguments: " << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
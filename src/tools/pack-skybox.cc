@@ -0,0 +1,101 @@
+// tetris3d-pack-skybox: converts skybox face images into a cubemap bundle
+// (mipmapped, optionally BC1 compressed), which the game memory maps and
+// uploads without decoding; run at build time (make assets)
+//
+// Usage: tetris3d-pack-skybox [options]
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "error.h"
+#include "game/cubemap_bundle.h"
+#include "png.h"
+
+namespace tetris3d {
+namespace {
+
+struct PackOptions {
+    std::string input_dir = "data/skybox";
+    std::string output = "data/skybox/skybox.bundle";
+    CubemapBundleFormat format = CubemapBundleFormat::Rgb8;
+};
+
+void PrintUsage() {
+    printf("Usage: tetris3d-pack-skybox [options]\n"
+           "  --input-dir DIR    directory with face JPEGs (data/skybox)\n"
+           "  --output FILE      bundle to write "
+           "(data/skybox/skybox.bundle)\n"
+           "  --compress         store faces BC1 (S3TC) compressed\n");
+}
+
+// Returns false if only usage was requested
+bool ParseOptions(int argc, char** argv, PackOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view name = argv[i];
+        if (name == "-h" || name == "--help") {
+            PrintUsage();
+            return false;
+        }
+        if (name == "--compress") {
+            options.format = CubemapBundleFormat::Bc1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw Error("Missing value of " + std::string(name));
+        }
+        std::string value = argv[++i];
+        if (name == "--input-dir") {
+            options.input_dir = value;
+        } else if (name == "--output") {
+            options.output = value;
+        } else {
+            throw Error("Unknown option: " + std::string(name));
+        }
+    }
+    return true;
+}
+
+void Pack(const PackOptions& options) {
+    // NOTE: Cubemap order, same files as SkyBox loads
+    const char* face_names[] = {"right", "left", "top", "bottom", "front",
+                                "back"};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<RgbImage> faces;
+    for (auto face_name : face_names) {
+        faces.push_back(
+            ReadPng(options.input_dir + "/" + face_name + ".jpg"));
+    }
+    WriteCubemapBundle(options.output, faces, options.format);
+
+    CubemapBundleReader reader;
+    reader.Open(options.output);
+    const auto& header = reader.GetHeader();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    printf("%s: %ux%u faces, %u levels, %s, packed in %.1f s\n",
+           options.output.c_str(), header.face_size, header.face_size,
+           header.level_count,
+           header.format == CubemapBundleFormat::Bc1 ? "BC1" : "RGB8",
+           std::chrono::duration<double>(elapsed).count());
+}
+
+} // namespace
+} // namespace tetris3d
+
+int main(int argc, char** argv) {
+    try {
+        tetris3d::PackOptions options;
+        if (!tetris3d::ParseOptions(argc, argv, options)) {
+            return 0;
+        }
+        tetris3d::Pack(options);
+    } catch (const tetris3d::Error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,401 @@
+// tetris3d-render-bench: renders fixed board corpora offscreen (no window,
+// works on Mesa llvmpipe without GPU) from several camera angles, reports
+// frame times and compares frames against golden PNG images; the software
+// renderer needs no GL context at all
+//
+// NOTE: Run from the repository root, renderers load data/ relatively
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config.h"
+#include "error.h"
+#include "game/bot.h"
+#include "game/game.h"
+#include "game/random.h"
+#include "game/renderer.h"
+#include "game/software_renderer.h"
+#include "glm/gtc/constants.hpp"
+#include "offscreen_context.h"
+#include "png.h"
+#include "thread_pool.h"
+
+namespace tetris3d {
+namespace {
+
+constexpr float kStepSeconds = 1.f / 60.f;
+constexpr int kWarmUpFrames = 3;
+
+struct BenchOptions {
+    // basic, advanced, software or all
+    std::string renderer = "all";
+    int width = 640;
+    int height = 480;
+    unsigned angles = 8;
+    // Timed frames per view
+    unsigned frames = 30;
+    // Frames are written here if not empty
+    std::string output_dir;
+    // Frames are compared with golden images here if not empty
+    std::string golden_dir;
+    // Writes golden images instead of comparing with them
+    bool update_golden = false;
+    // Largest difference of a channel still considered equal
+    int tolerance = 8;
+    // Fraction of differing pixels a frame may have
+    float max_mismatch = 0.001f;
+};
+
+struct Corpus {
+    std::string name;
+    GameState state;
+};
+
+void PrintUsage() {
+    printf("Usage: tetris3d-render-bench [options]\n"
+           "  --renderer NAME    basic, advanced, software or all (all)\n"
+           "  --size WxH         framebuffer size (640x480)\n"
+           "  --angles N         camera angles around the board (8)\n"
+           "  --frames N         timed frames per view (30)\n"
+           "  --output-dir DIR   write frames as PNG images\n"
+           "  --golden-dir DIR   compare frames with golden PNG images\n"
+           "  --update-golden    write golden images instead of comparing\n"
+           "  --tolerance N      channel difference treated as equal (8)\n"
+           "  --max-mismatch X   fraction of differing pixels allowed "
+           "(0.001)\n");
+}
+
+float ParseNumber(std::string_view name, const std::string& value) {
+    try {
+        size_t length = 0;
+        auto result = std::stof(value, &length);
+        if (length == value.size() && result >= 0.f) {
+            return result;
+        }
+    } catch (const std::exception&) {
+    }
+    throw Error("Invalid value of " + std::string(name) + ": " + value);
+}
+
+// Returns false if only usage was requested
+bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view name = argv[i];
+        if (name == "-h" || name == "--help") {
+            PrintUsage();
+            return false;
+        }
+        if (name == "--update-golden") {
+            options.update_golden = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw Error("Missing value of " + std::string(name));
+        }
+        std::string value = argv[++i];
+        if (name == "--renderer") {
+            if (value != "basic" && value != "advanced" &&
+                value != "software" && value != "all") {
+                throw Error("Unknown renderer: " + value);
+            }
+            options.renderer = value;
+        } else if (name == "--size") {
+            auto separator = value.find('x');
+            if (separator == std::string::npos) {
+                throw Error("Invalid value of --size: " + value);
+            }
+            options.width = ParseNumber(name, value.substr(0, separator));
+            options.height = ParseNumber(name, value.substr(separator + 1));
+        } else if (name == "--angles") {
+            options.angles = ParseNumber(name, value);
+        } else if (name == "--frames") {
+            options.frames = ParseNumber(name, value);
+        } else if (name == "--output-dir") {
+            options.output_dir = value;
+        } else if (name == "--golden-dir") {
+            options.golden_dir = value;
+        } else if (name == "--tolerance") {
+            options.tolerance = ParseNumber(name, value);
+        } else if (name == "--max-mismatch") {
+            options.max_mismatch = ParseNumber(name, value);
+        } else {
+            throw Error("Unknown option: " + std::string(name));
+        }
+    }
+    if (options.width <= 0 || options.height <= 0 || !options.angles ||
+        !options.frames) {
+        throw Error("Size, angles and frames must be positive");
+    }
+    if (options.update_golden && options.golden_dir.empty()) {
+        throw Error("--update-golden needs --golden-dir");
+    }
+    return true;
+}
+
+GameState PlayBot(const Config& config, unsigned frames) {
+    GameState state(config);
+    HeuristicBot bot(BotWeights::FromConfig(config), nullptr);
+    CommandBatch commands;
+    for (unsigned frame = 0; frame < frames; ++frame) {
+        commands.Clear();
+        bot.Update(state, kStepSeconds, 0.f, commands);
+        Game::Update(state, kStepSeconds, commands);
+    }
+    return state;
+}
+
+// Lower two thirds of the board filled with random colors, most cells taken
+GameState MakeDenseState(const Config& config) {
+    GameState state(config);
+    Game::Update(state, kStepSeconds, CommandBatch{});
+    const unsigned palette[] = {0xd04040, 0x40d040, 0x4040d0, 0xd0d040,
+                                0xd040d0, 0x40d0d0, 0xe09030, 0x9060e0};
+    Random random(7);
+    auto& board = state.board;
+    for (int y = 0; y < board.GetHeight() * 2 / 3; ++y) {
+        for (int x = 0; x < board.GetWidth(); ++x) {
+            for (int z = 0; z < board.GetDepth(); ++z) {
+                if (random.NextBelow(100) < 85) {
+                    board.Fill(glm::ivec3(x, y, z),
+                               palette[random.NextBelow(8)]);
+                }
+            }
+        }
+    }
+    return state;
+}
+
+// NOTE: Corpora are deterministic (seeded games, fixed bot), so frames are
+// comparable across runs
+std::vector<Corpus> MakeCorpora() {
+    std::vector<Corpus> corpora;
+    auto make_config = [](unsigned seed) {
+        Config config;
+        config.rand_seed = seed;
+        return config;
+    };
+    {
+        auto config = make_config(1);
+        GameState state(config);
+        Game::Update(state, kStepSeconds, CommandBatch{});
+        corpora.push_back({"empty", state});
+    }
+    corpora.push_back({"early", PlayBot(make_config(1), 900)});
+    corpora.push_back({"mid", PlayBot(make_config(3), 4000)});
+    corpora.push_back({"dense", MakeDenseState(make_config(5))});
+    return corpora;
+}
+
+// Orbits the board center, slightly above it, so top faces are visible
+PerspectiveCamera MakeCamera(const Board& board, float angle,
+                             float aspect_ratio) {
+    glm::vec3 center(board.GetWidth() / 2.f, board.GetHeight() / 2.f,
+                     board.GetDepth() / 2.f);
+    auto radius = 2.f * std::hypot(static_cast<float>(board.GetWidth()),
+                                   static_cast<float>(board.GetDepth()));
+    PerspectiveCamera camera;
+    camera.SetPosition(center + glm::vec3(radius * std::cos(angle),
+                                          board.GetHeight() / 2.f,
+                                          radius * std::sin(angle)));
+    camera.SetTarget(center);
+    camera.SetUp(glm::vec3(0.f, 1.f, 0.f));
+    camera.SetAspectRatio(aspect_ratio);
+    return camera;
+}
+
+// Returns fraction of pixels differing by more than tolerance
+float CompareImages(const RgbImage& image, const RgbImage& golden,
+                    int tolerance) {
+    if (image.width != golden.width || image.height != golden.height) {
+        return 1.f;
+    }
+    size_t mismatches = 0;
+    for (size_t i = 0; i < image.pixels.size(); i += 3) {
+        for (int channel = 0; channel < 3; ++channel) {
+            if (std::abs(image.pixels[i + channel] -
+                         golden.pixels[i + channel]) > tolerance) {
+                ++mismatches;
+                break;
+            }
+        }
+    }
+    return static_cast<float>(mismatches) / (image.width * image.height);
+}
+
+// Renders and times every view, then compares it with its golden image
+// @finish waits until the frame is rendered
+// @read_pixels copies the frame as RGB rows from the top one
+// Returns number of views failing golden comparison
+unsigned RunViews(const BenchOptions& options, IRenderer& renderer,
+                  const std::string& renderer_name,
+                  const std::vector<Corpus>& corpora,
+                  const std::function<void()>& finish,
+                  const std::function<void(std::vector<uint8_t>&)>&
+                      read_pixels) {
+    renderer.SetFramebufferWidth(options.width);
+    renderer.SetFramebufferHeight(options.height);
+
+    using Clock = std::chrono::steady_clock;
+    unsigned failures = 0;
+    std::vector<float> frame_ms;
+    std::vector<float> all_frame_ms;
+    RgbImage image{options.width, options.height, {}};
+    for (const auto& corpus : corpora) {
+        for (unsigned angle = 0; angle < options.angles; ++angle) {
+            auto camera = MakeCamera(
+                corpus.state.board,
+                2.f * glm::pi<float>() * angle / options.angles +
+                    glm::pi<float>() / 4.f,
+                static_cast<float>(options.width) / options.height);
+            for (int frame = 0; frame < kWarmUpFrames; ++frame) {
+                renderer.Render(corpus.state, camera);
+            }
+            finish();
+
+            // NOTE: Each frame is finished before the next one, so times
+            // include GPU work, not just command submission
+            frame_ms.clear();
+            for (unsigned frame = 0; frame < options.frames; ++frame) {
+                auto start = Clock::now();
+                renderer.Render(corpus.state, camera);
+                finish();
+                frame_ms.push_back(
+                    std::chrono::duration<float, std::milli>(Clock::now() -
+                                                             start)
+                        .count());
+            }
+            all_frame_ms.insert(all_frame_ms.end(), frame_ms.begin(),
+                                frame_ms.end());
+            std::sort(frame_ms.begin(), frame_ms.end());
+            auto mean = std::accumulate(frame_ms.begin(), frame_ms.end(), 0.f) /
+                        frame_ms.size();
+            printf("  %-6s angle %2u: mean %7.3f ms, median %7.3f ms, "
+                   "p95 %7.3f ms",
+                   corpus.name.c_str(), angle, mean,
+                   frame_ms[frame_ms.size() / 2],
+                   frame_ms[frame_ms.size() * 95 / 100]);
+
+            read_pixels(image.pixels);
+            auto file_name = renderer_name + "_" + corpus.name + "_" +
+                             std::to_string(angle) + ".png";
+            if (!options.output_dir.empty()) {
+                WritePng(options.output_dir + "/" + file_name, image);
+            }
+            if (options.update_golden) {
+                WritePng(options.golden_dir + "/" + file_name, image);
+            } else if (!options.golden_dir.empty()) {
+                auto golden_path = options.golden_dir + "/" + file_name;
+                try {
+                    auto mismatch = CompareImages(
+                        image, ReadPng(golden_path), options.tolerance);
+                    if (mismatch > options.max_mismatch) {
+                        printf(", golden MISMATCH %.3f%%", mismatch * 100.f);
+                        ++failures;
+                    } else {
+                        printf(", golden ok");
+                    }
+                } catch (const Error& error) {
+                    printf(", golden MISSING (%s)", error.what());
+                    ++failures;
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    std::sort(all_frame_ms.begin(), all_frame_ms.end());
+    auto mean = std::accumulate(all_frame_ms.begin(), all_frame_ms.end(), 0.f) /
+                all_frame_ms.size();
+    printf("%s total: mean %.3f ms, median %.3f ms, p95 %.3f ms\n",
+           renderer_name.c_str(), mean, all_frame_ms[all_frame_ms.size() / 2],
+           all_frame_ms[all_frame_ms.size() * 95 / 100]);
+    return failures;
+}
+
+// Returns number of views failing golden comparison
+unsigned RunRenderer(const BenchOptions& options, Config::RendererType type,
+                     const std::string& renderer_name,
+                     const std::vector<Corpus>& corpora) {
+    OffscreenContext context(type, options.width, options.height);
+    printf("%s renderer on %s, %dx%d\n", renderer_name.c_str(),
+           context.GetRendererName(), options.width, options.height);
+
+    Config config;
+    std::unique_ptr<IRenderer> renderer;
+    if (type == Config::RendererType::Basic) {
+        renderer = std::make_unique<BasicRenderer>(config);
+        renderer->StartUp(corpora.front().state);
+    } else {
+        auto advanced = std::make_unique<AdvancedRenderer>(config);
+        advanced->StartUp(corpora.front().state);
+        // NOTE: Frames must not show the placeholder skybox
+        advanced->FinishLoading();
+        renderer = std::move(advanced);
+    }
+    return RunViews(
+        options, *renderer, renderer_name, corpora, [] { glFinish(); },
+        [&context](std::vector<uint8_t>& rgb) { context.ReadPixels(rgb); });
+}
+
+// Returns number of views failing golden comparison
+unsigned RunSoftwareRenderer(const BenchOptions& options,
+                             const std::vector<Corpus>& corpora) {
+    ThreadPool pool;
+    printf("software renderer on %u threads, %dx%d\n",
+           pool.GetThreadCount(), options.width, options.height);
+
+    Config config;
+    SoftwareRenderer renderer(config, &pool);
+    // NOTE: Render returns once all tiles are rasterized
+    return RunViews(
+        options, renderer, "software", corpora, [] {},
+        [&renderer](std::vector<uint8_t>& rgb) { renderer.ReadPixels(rgb); });
+}
+
+} // namespace
+} // namespace tetris3d
+
+int main(int argc, char** argv) {
+    try {
+        tetris3d::BenchOptions options;
+        if (!tetris3d::ParseOptions(argc, argv, options)) {
+            return 0;
+        }
+        auto corpora = tetris3d::MakeCorpora();
+        unsigned failures = 0;
+        auto selected = [&options](const char* name) {
+            return options.renderer == "all" || options.renderer == name;
+        };
+        if (selected("basic")) {
+            failures += tetris3d::RunRenderer(
+                options, tetris3d::Config::RendererType::Basic, "basic",
+                corpora);
+        }
+        if (selected("advanced")) {
+            failures += tetris3d::RunRenderer(
+                options, tetris3d::Config::RendererType::Advanced,
+                "advanced", corpora);
+        }
+        if (selected("software")) {
+            failures += tetris3d::RunSoftwareRenderer(options, corpora);
+        }
+        if (failures) {
+            printf("%u views differ from golden images\n", failures);
+            return 1;
+        }
+    } catch (const tetris3d::Error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
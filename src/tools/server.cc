@@ -0,0 +1,118 @@
+// tetris3d-server: hosts many headless game sessions in a single process;
+// see GameServer for the protocol
+
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "config.h"
+#include "error.h"
+#include "server/game_server.h"
+
+namespace tetris3d {
+namespace {
+
+GameServer* running_server = nullptr;
+
+void OnSignal(int) {
+    if (running_server) {
+        running_server->Stop();
+    }
+}
+
+void PrintUsage() {
+    printf("Usage: tetris3d-server [options]\n"
+           "  --address IP       address to listen on (127.0.0.1)\n"
+           "  --port N           port to listen on (7777)\n"
+           "  --spectator-port N port for spectators, 0 = off (7778)\n"
+           "  --tick-rate X      session ticks per second (60)\n"
+           "  --threads N        worker threads, 0 = all hardware (0)\n"
+           "  --max-sessions N   concurrent sessions limit (1024)\n"
+           "  --max-spectators N concurrent spectators limit (4096)\n"
+           "  --stats X          seconds between statistics, 0 = off (10)\n");
+}
+
+float ParseNumber(std::string_view name, const std::string& value) {
+    try {
+        size_t length = 0;
+        auto result = std::stof(value, &length);
+        if (length == value.size() && result >= 0.f) {
+            return result;
+        }
+    } catch (const std::exception&) {
+    }
+    throw Error("Invalid value of " + std::string(name) + ": " + value);
+}
+
+// Whole number up to max; converting others to integers would be undefined
+unsigned ParseInteger(std::string_view name, const std::string& value,
+                      unsigned max) {
+    auto result = ParseNumber(name, value);
+    if (result != std::floor(result) || static_cast<double>(result) > max) {
+        throw Error("Invalid value of " + std::string(name) + ": " + value);
+    }
+    return static_cast<unsigned>(result);
+}
+
+// Returns false if only usage was requested
+bool ParseOptions(int argc, char** argv, GameServerOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view name = argv[i];
+        if (name == "-h" || name == "--help") {
+            PrintUsage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            throw Error("Missing value of " + std::string(name));
+        }
+        std::string value = argv[++i];
+        if (name == "--address") {
+            options.address = value;
+        } else if (name == "--port") {
+            options.port = ParseInteger(name, value, UINT16_MAX);
+        } else if (name == "--spectator-port") {
+            options.spectator_port = ParseInteger(name, value, UINT16_MAX);
+        } else if (name == "--tick-rate") {
+            options.tick_rate = ParseNumber(name, value);
+        } else if (name == "--threads") {
+            options.threads = ParseInteger(name, value, UINT32_MAX);
+        } else if (name == "--max-sessions") {
+            options.max_sessions = ParseInteger(name, value, UINT32_MAX);
+        } else if (name == "--max-spectators") {
+            options.max_spectators = ParseInteger(name, value, UINT32_MAX);
+        } else if (name == "--stats") {
+            options.stats_period_seconds = ParseNumber(name, value);
+        } else {
+            throw Error("Unknown option: " + std::string(name));
+        }
+    }
+    return true;
+}
+
+} // namespace
+} // namespace tetris3d
+
+int main(int argc, char** argv) {
+    try {
+        tetris3d::GameServerOptions options;
+        if (!tetris3d::ParseOptions(argc, argv, options)) {
+            return 0;
+        }
+        tetris3d::Config config;
+        tetris3d::GameServer server(config, options);
+        tetris3d::running_server = &server;
+        std::signal(SIGINT, tetris3d::OnSignal);
+        std::signal(SIGTERM, tetris3d::OnSignal);
+        server.Run();
+        tetris3d::running_server = nullptr;
+    } catch (const tetris3d::Error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,473 @@
+// tetris3d-tune: optimizes heuristic bot weights with a genetic algorithm
+//
+// Every candidate plays the same set of seeded headless games, all games of
+// a generation run in parallel on a thread pool. Population is checkpointed
+// after every generation (an interrupted run resumes from the checkpoint) and
+// the best weights are written to a file usable as Config::bot_weights_path.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config.h"
+#include "error.h"
+#include "game/bot.h"
+#include "game/game.h"
+#include "game/random.h"
+#include "thread_pool.h"
+
+namespace tetris3d {
+namespace {
+
+constexpr float kStepSeconds = 1.f / 60.f;
+constexpr int kCheckpointVersion = 2;
+
+float BotWeights::*const kWeightFields[] = {
+    &BotWeights::aggregate_height,
+    &BotWeights::holes,
+    &BotWeights::bumpiness,
+    &BotWeights::cleared_layers,
+};
+
+struct TuneOptions {
+    unsigned population = 32;
+    // Games played by every candidate; fitness is mean of placed blocks
+    unsigned games = 8;
+    unsigned generations = 50;
+    // Caps game length, as good weights survive practically forever
+    unsigned max_blocks = 1000;
+    // Zero uses one thread per hardware thread
+    unsigned threads = 0;
+    unsigned seed = 1;
+    float mutation_sigma = 0.2f;
+    std::string checkpoint_path = "tune_checkpoint.txt";
+    std::string output_path = "bot_weights.txt";
+};
+
+struct Candidate {
+    BotWeights weights;
+    float fitness = 0.f;
+};
+
+struct Population {
+    unsigned generation = 0;
+    Random random;
+    std::vector<Candidate> candidates;
+};
+
+void PrintUsage() {
+    printf("Usage: tetris3d-tune [options]\n"
+           "  --population N     candidates per generation (32)\n"
+           "  --games N          games per candidate (8)\n"
+           "  --generations N    generations to run (50)\n"
+           "  --max-blocks N     game length cap in blocks (1000)\n"
+           "  --threads N        worker threads, 0 = all hardware (0)\n"
+           "  --seed N           seed of games and of the algorithm (1)\n"
+           "  --sigma X          mutation standard deviation (0.2)\n"
+           "  --checkpoint PATH  population checkpoint, resumed if exists\n"
+           "                     (tune_checkpoint.txt)\n"
+           "  --output PATH      best weights, for Config::bot_weights_path\n"
+           "                     (bot_weights.txt)\n");
+}
+
+unsigned ParseUnsigned(std::string_view name, const std::string& value) {
+    try {
+        size_t length = 0;
+        auto result = std::stoul(value, &length);
+        if (length == value.size()) {
+            return static_cast<unsigned>(result);
+        }
+    } catch (const std::exception&) {
+    }
+    throw Error("Invalid value of " + std::string(name) + ": " + value);
+}
+
+float ParseFloat(std::string_view name, const std::string& value) {
+    try {
+        size_t length = 0;
+        auto result = std::stof(value, &length);
+        if (length == value.size()) {
+            return result;
+        }
+    } catch (const std::exception&) {
+    }
+    throw Error("Invalid value of " + std::string(name) + ": " + value);
+}
+
+// Returns false if only usage was requested
+bool ParseOptions(int argc, char** argv, TuneOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view name = argv[i];
+        if (name == "-h" || name == "--help") {
+            PrintUsage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            throw Error("Missing value of " + std::string(name));
+        }
+        std::string value = argv[++i];
+        if (name == "--population") {
+            options.population = ParseUnsigned(name, value);
+        } else if (name == "--games") {
+            options.games = ParseUnsigned(name, value);
+        } else if (name == "--generations") {
+            options.generations = ParseUnsigned(name, value);
+        } else if (name == "--max-blocks") {
+            options.max_blocks = ParseUnsigned(name, value);
+        } else if (name == "--threads") {
+            options.threads = ParseUnsigned(name, value);
+        } else if (name == "--seed") {
+            options.seed = ParseUnsigned(name, value);
+        } else if (name == "--sigma") {
+            options.mutation_sigma = ParseFloat(name, value);
+        } else if (name == "--checkpoint") {
+            options.checkpoint_path = value;
+        } else if (name == "--output") {
+            options.output_path = value;
+        } else {
+            throw Error("Unknown option: " + std::string(name));
+        }
+    }
+
+    if (options.population < 2) {
+        throw Error("Population must have at least 2 candidates");
+    }
+    if (options.games == 0 || options.max_blocks == 0) {
+        throw Error("Games and max blocks must be positive");
+    }
+    return true;
+}
+
+// Returns value in range [0, 1)
+float NextUniform(Random& random) {
+    return static_cast<float>(random.Next() >> 8) / (1u << 24);
+}
+
+float NextGaussian(Random& random) {
+    // NOTE: Box-Muller transform; first uniform is shifted to (0, 1]
+    auto u1 = 1.f - NextUniform(random);
+    auto u2 = NextUniform(random);
+    return std::sqrt(-2.f * std::log(u1)) *
+           std::cos(2.f * glm::pi<float>() * u2);
+}
+
+// NOTE: Bot picks the placement with the highest linear score, so scaling
+// weights does not change its play; keeping them at unit length makes the
+// search space bounded
+void Normalize(BotWeights& weights) {
+    auto length = 0.f;
+    for (auto field : kWeightFields) {
+        length += weights.*field * weights.*field;
+    }
+    length = std::sqrt(length);
+    if (length == 0.f) {
+        return;
+    }
+    for (auto field : kWeightFields) {
+        weights.*field /= length;
+    }
+}
+
+Candidate CreateRandomCandidate(Random& random) {
+    Candidate candidate;
+    for (auto field : kWeightFields) {
+        candidate.weights.*field = NextUniform(random) * 2.f - 1.f;
+    }
+    Normalize(candidate.weights);
+    return candidate;
+}
+
+// Child of two tournament winners: fitness weighted average of parents,
+// with some of the weights mutated
+Candidate CreateChild(const std::vector<Candidate>& candidates,
+                      const TuneOptions& options, Random& random) {
+    auto tournament_size =
+        std::max<size_t>(2, candidates.size() / 10);
+    const Candidate* first = nullptr;
+    const Candidate* second = nullptr;
+    for (size_t i = 0; i < tournament_size; ++i) {
+        const auto* candidate =
+            &candidates[random.NextBelow(candidates.size())];
+        if (!first || candidate->fitness > first->fitness) {
+            second = first;
+            first = candidate;
+        } else if (!second || candidate->fitness > second->fitness) {
+            second = candidate;
+        }
+    }
+
+    auto total_fitness = first->fitness + second->fitness;
+    auto first_share = total_fitness > 0.f
+                           ? first->fitness / total_fitness
+                           : 0.5f;
+    Candidate child;
+    for (auto field : kWeightFields) {
+        child.weights.*field = first->weights.*field * first_share +
+                               second->weights.*field * (1.f - first_share);
+        if (random.NextBelow(std::size(kWeightFields)) == 0) {
+            child.weights.*field +=
+                NextGaussian(random) * options.mutation_sigma;
+        }
+    }
+    Normalize(child.weights);
+    return child;
+}
+
+// Plays a headless game; returns number of placed blocks
+unsigned PlayGame(const BotWeights& weights, unsigned seed,
+                  unsigned max_blocks) {
+    Config config;
+    config.rand_seed = seed;
+    GameState state(config);
+    HeuristicBot bot(weights, nullptr);
+    CommandBatch commands;
+
+    unsigned blocks = 0;
+    while (state.phase != GameState::Phase::Lost && blocks < max_blocks) {
+        commands.Clear();
+        bot.Update(state, kStepSeconds, 0.f, commands);
+        auto phase = state.phase;
+        Game::Update(state, kStepSeconds, commands);
+        if (phase != GameState::Phase::NewBlockCreation &&
+            state.phase == GameState::Phase::NewBlockCreation) {
+            ++blocks;
+        }
+    }
+    return blocks;
+}
+
+// Plays all games of given candidates in parallel and sets their fitness;
+// returns number of played games
+size_t Evaluate(std::vector<Candidate>& candidates, size_t first,
+                const TuneOptions& options, ThreadPool& pool) {
+    auto count = (candidates.size() - first) * options.games;
+    std::vector<unsigned> results(count);
+    pool.ParallelFor(count, [&](size_t index, unsigned) {
+        const auto& candidate = candidates[first + index / options.games];
+        results[index] = PlayGame(candidate.weights,
+                                  options.seed + index % options.games,
+                                  options.max_blocks);
+    });
+
+    for (size_t i = first; i < candidates.size(); ++i) {
+        auto begin = results.begin() + (i - first) * options.games;
+        auto total = std::accumulate(begin, begin + options.games, 0.);
+        candidates[i].fitness = static_cast<float>(total / options.games);
+    }
+    return count;
+}
+
+void SortByFitness(std::vector<Candidate>& candidates) {
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate& a, const Candidate& b) {
+                         return a.fitness > b.fitness;
+                     });
+}
+
+// Options a checkpoint is bound to: fitness depends on games, seed and max
+// blocks, and candidates are the population; resuming with other values
+// would rank old fitness against incomparable new one
+struct CheckpointOption {
+    const char* name;
+    unsigned TuneOptions::*field;
+};
+
+const CheckpointOption kCheckpointOptions[] = {
+    {"population", &TuneOptions::population},
+    {"games", &TuneOptions::games},
+    {"seed", &TuneOptions::seed},
+    {"max-blocks", &TuneOptions::max_blocks},
+};
+
+// NOTE: Checkpoint is written to a temporary file first and then renamed,
+// so an interrupted write never destroys the previous checkpoint
+void SaveCheckpoint(const std::string& path, const TuneOptions& options,
+                    const Population& population) {
+    auto temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path);
+        if (!file) {
+            throw Error("Cannot open checkpoint for writing: " + path);
+        }
+        file << "tetris3d-tune " << kCheckpointVersion << "\n";
+        for (const auto& option : kCheckpointOptions) {
+            file << option.name << " " << options.*option.field << "\n";
+        }
+        file << "generation " << population.generation << "\n"
+             << "random " << population.random.GetState() << "\n"
+             << "candidates " << population.candidates.size() << "\n";
+        file.precision(9);
+        for (const auto& candidate : population.candidates) {
+            for (auto field : kWeightFields) {
+                file << candidate.weights.*field << " ";
+            }
+            file << candidate.fitness << "\n";
+        }
+        if (!file.flush()) {
+            throw Error("Cannot write checkpoint: " + path);
+        }
+    }
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        throw Error("Cannot replace checkpoint: " + path);
+    }
+}
+
+// Returns false if there is no checkpoint; throws Error if it was made with
+// other options (see kCheckpointOptions)
+bool LoadCheckpoint(const std::string& path, const TuneOptions& options,
+                    Population& population) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    std::string magic;
+    int version = 0;
+    file >> magic >> version;
+    if (!file || magic != "tetris3d-tune" ||
+        version != kCheckpointVersion) {
+        throw Error("Checkpoint is malformed or unsupported: " + path);
+    }
+    for (const auto& option : kCheckpointOptions) {
+        std::string name;
+        unsigned value = 0;
+        file >> name >> value;
+        if (!file || name != option.name) {
+            throw Error("Checkpoint is malformed or unsupported: " + path);
+        }
+        if (value != options.*option.field) {
+            throw Error("Checkpoint was made with --" + name + " " +
+                        std::to_string(value) + ", not " +
+                        std::to_string(options.*option.field) + ": " + path);
+        }
+    }
+
+    std::string generation, random, candidates;
+    uint32_t random_state = 0;
+    size_t count = 0;
+    file >> generation >> population.generation >> random >> random_state >>
+        candidates >> count;
+    // NOTE: Count is checked before it sizes anything, so a corrupted
+    // checkpoint cannot make the tool allocate arbitrary memory
+    if (!file || count != options.population) {
+        throw Error("Checkpoint is malformed or unsupported: " + path);
+    }
+    population.random.SetState(random_state);
+    population.candidates.resize(count);
+    for (auto& candidate : population.candidates) {
+        for (auto field : kWeightFields) {
+            file >> candidate.weights.*field;
+        }
+        file >> candidate.fitness;
+    }
+    if (!file) {
+        throw Error("Checkpoint is truncated: " + path);
+    }
+    return true;
+}
+
+void PrintCandidate(const char* label, const Candidate& candidate) {
+    printf("%s %.1f blocks: aggregate_height %.4f holes %.4f bumpiness %.4f "
+           "cleared_layers %.4f\n",
+           label, candidate.fitness, candidate.weights.aggregate_height,
+           candidate.weights.holes, candidate.weights.bumpiness,
+           candidate.weights.cleared_layers);
+}
+
+void Tune(const TuneOptions& options) {
+    using Clock = std::chrono::steady_clock;
+
+    ThreadPool pool(options.threads);
+    printf("Tuning on %u threads (+ main thread)\n", pool.GetThreadCount());
+
+    Population population;
+    size_t total_games = 0;
+    auto start_time = Clock::now();
+    if (LoadCheckpoint(options.checkpoint_path, options, population)) {
+        printf("Resuming generation %u from %s\n", population.generation,
+               options.checkpoint_path.c_str());
+    } else {
+        // NOTE: Initial population includes the current default weights
+        population.random.Seed(options.seed);
+        population.candidates.push_back({BotWeights{}, 0.f});
+        Normalize(population.candidates.back().weights);
+        while (population.candidates.size() < options.population) {
+            population.candidates.push_back(
+                CreateRandomCandidate(population.random));
+        }
+        total_games += Evaluate(population.candidates, 0, options, pool);
+        SortByFitness(population.candidates);
+        SaveCheckpoint(options.checkpoint_path, options, population);
+    }
+
+    auto& candidates = population.candidates;
+    auto offspring_count = std::max<size_t>(1, candidates.size() * 3 / 10);
+    while (population.generation < options.generations) {
+        auto generation_start_time = Clock::now();
+
+        std::vector<Candidate> offspring;
+        for (size_t i = 0; i < offspring_count; ++i) {
+            offspring.push_back(
+                CreateChild(candidates, options, population.random));
+        }
+        auto games = Evaluate(offspring, 0, options, pool);
+        total_games += games;
+
+        // NOTE: Offspring replaces the weakest candidates
+        std::copy(offspring.begin(), offspring.end(),
+                  candidates.end() - offspring_count);
+        SortByFitness(candidates);
+        ++population.generation;
+        SaveCheckpoint(options.checkpoint_path, options, population);
+        candidates.front().weights.Save(options.output_path);
+
+        auto seconds = std::chrono::duration<double>(Clock::now() -
+                                                     generation_start_time)
+                           .count();
+        auto mean_fitness =
+            std::accumulate(candidates.begin(), candidates.end(), 0.,
+                            [](double sum, const Candidate& candidate) {
+                                return sum + candidate.fitness;
+                            }) /
+            candidates.size();
+        printf("Generation %u: mean %.1f blocks, %zu games in %.2fs "
+               "(%.1f games/sec)\n",
+               population.generation, mean_fitness, games, seconds,
+               games / seconds);
+        PrintCandidate("  best", candidates.front());
+    }
+
+    candidates.front().weights.Save(options.output_path);
+    auto seconds =
+        std::chrono::duration<double>(Clock::now() - start_time).count();
+    printf("Played %zu games in %.2fs (%.1f games/sec)\n", total_games,
+           seconds, seconds > 0. ? total_games / seconds : 0.);
+    PrintCandidate("Best", candidates.front());
+    printf("Weights written to %s (use as Config::bot_weights_path)\n",
+           options.output_path.c_str());
+}
+
+} // namespace
+} // namespace tetris3d
+
+int main(int argc, char** argv) {
+    try {
+        tetris3d::TuneOptions options;
+        if (!tetris3d::ParseOptions(argc, argv, options)) {
+            return 0;
+        }
+        tetris3d::Tune(options);
+    } catch (const tetris3d::Error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,244 @@
+// tetris3d-versus: headless bot versus bot match over UDP with rollback
+// netcode (RollbackSession); both peers run in this process unless
+// --player is given, so a loopback test needs no second terminal
+//
+// NOTE: Use --latency-ms, --jitter-ms and --loss to exercise rollbacks;
+// matching final checksums of both peers mean the simulations agree
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "error.h"
+#include "game/bot.h"
+#include "game/rollback_session.h"
+#include "net/latency_shim.h"
+#include "net/udp_transport.h"
+
+namespace tetris3d {
+namespace {
+
+struct Options {
+    // Negative runs both players
+    int player = -1;
+    std::string address = "127.0.0.1";
+    std::string peer_address = "127.0.0.1";
+    // Player 0 binds port, player 1 port + 1
+    unsigned port = 7800;
+    unsigned ticks = 1800;
+    float tick_rate = 60.f;
+    unsigned rollback_ticks = 10;
+    LatencyShimSettings network;
+};
+
+// Frames both peers keep exchanging packets after the last tick, so the
+// final acknowledgements get through
+constexpr unsigned kLingerFrames = 30;
+
+struct Peer {
+    Peer(const Config& config, const Options& options, unsigned player)
+        : udp(options.address, options.port + player, options.peer_address,
+              options.port + 1 - player),
+          shim(udp, LatencyShimSettings{options.network.latency_ms,
+                                        options.network.jitter_ms,
+                                        options.network.loss,
+                                        options.network.seed + player}),
+          session(config, player, options.rollback_ticks,
+                  1.f / options.tick_rate),
+          bot(BotWeights::FromConfig(config), nullptr) {}
+
+    UdpTransport udp;
+    LatencyShim shim;
+    RollbackSession session;
+    HeuristicBot bot;
+    std::vector<uint8_t> packet;
+    uint64_t invalid_packets = 0;
+};
+
+void PrintUsage() {
+    printf("Usage: tetris3d-versus [options]\n"
+           "  --player N         run only player N (0 or 1) of the match\n"
+           "  --address IP       local address (127.0.0.1)\n"
+           "  --peer-address IP  address of the other player (127.0.0.1)\n"
+           "  --port N           UDP port of player 0, player 1 uses N + 1 "
+           "(7800)\n"
+           "  --ticks N          match length (1800)\n"
+           "  --tick-rate X      ticks per second (60)\n"
+           "  --rollback N       rollback window in ticks (10)\n"
+           "  --latency-ms X     added one way latency (0)\n"
+           "  --jitter-ms X      added random latency up to X (0)\n"
+           "  --loss X           packet loss probability (0)\n"
+           "  --seed N           match seed (42)\n");
+}
+
+float ParseNumber(std::string_view name, const std::string& value) {
+    try {
+        size_t length = 0;
+        auto result = std::stof(value, &length);
+        if (length == value.size() && result >= 0.f) {
+            return result;
+        }
+    } catch (const std::exception&) {
+    }
+    throw Error("Invalid value of " + std::string(name) + ": " + value);
+}
+
+// Returns false if only usage was requested
+bool ParseOptions(int argc, char** argv, Options& options, Config& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view name = argv[i];
+        if (name == "-h" || name == "--help") {
+            PrintUsage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            throw Error("Missing value of " + std::string(name));
+        }
+        std::string value = argv[++i];
+        if (name == "--player") {
+            options.player = ParseNumber(name, value);
+            if (options.player > 1) {
+                throw Error("Player must be 0 or 1");
+            }
+        } else if (name == "--address") {
+            options.address = value;
+        } else if (name == "--peer-address") {
+            options.peer_address = value;
+        } else if (name == "--port") {
+            options.port = ParseNumber(name, value);
+        } else if (name == "--ticks") {
+            options.ticks = ParseNumber(name, value);
+        } else if (name == "--tick-rate") {
+            options.tick_rate = ParseNumber(name, value);
+        } else if (name == "--rollback") {
+            options.rollback_ticks = ParseNumber(name, value);
+        } else if (name == "--latency-ms") {
+            options.network.latency_ms = ParseNumber(name, value);
+        } else if (name == "--jitter-ms") {
+            options.network.jitter_ms = ParseNumber(name, value);
+        } else if (name == "--loss") {
+            options.network.loss = ParseNumber(name, value);
+        } else if (name == "--seed") {
+            config.rand_seed = ParseNumber(name, value);
+        } else {
+            throw Error("Unknown option: " + std::string(name));
+        }
+    }
+    if (options.tick_rate <= 0.f) {
+        throw Error("Tick rate must be positive");
+    }
+    return true;
+}
+
+// Returns true once the peer has simulated and exchanged all ticks
+bool UpdatePeer(Peer& peer, const Options& options) {
+    auto& session = peer.session;
+    while (peer.shim.Receive(peer.packet)) {
+        try {
+            session.ReadPacket(peer.packet.data(), peer.packet.size());
+        } catch (const Error&) {
+            ++peer.invalid_packets;
+        }
+    }
+
+    if (session.GetTick() < options.ticks) {
+        CommandBatch commands;
+        if (!session.IsStalled()) {
+            const auto& state = session.GetState(session.GetLocalPlayer());
+            peer.bot.Update(state, 1.f / options.tick_rate, 0.f, commands);
+        }
+        session.AdvanceTick(commands);
+    } else {
+        session.Synchronize();
+    }
+
+    peer.packet.clear();
+    session.WritePacket(peer.packet);
+    peer.shim.Send(peer.packet.data(), peer.packet.size());
+
+    return session.GetConfirmedTick() >= options.ticks &&
+           session.GetAckedTick() >= options.ticks;
+}
+
+void PrintPeer(const Peer& peer) {
+    const auto& session = peer.session;
+    const auto& stats = session.GetStats();
+    auto rollbacks = std::max<uint64_t>(stats.rollbacks, 1);
+    printf("Player %u: %llu ticks, %llu stalled, %llu rollbacks "
+           "(%.1f ticks avg, %u max), rollback time %.1f us avg, "
+           "%.1f us max, %llu invalid packets\n",
+           session.GetLocalPlayer(),
+           static_cast<unsigned long long>(session.GetTick()),
+           static_cast<unsigned long long>(stats.stalled_ticks),
+           static_cast<unsigned long long>(stats.rollbacks),
+           static_cast<double>(stats.resimulated_ticks) / rollbacks,
+           stats.max_rollback_ticks,
+           stats.rollback_time.count() / 1000. / rollbacks,
+           stats.max_rollback_time.count() / 1000.,
+           static_cast<unsigned long long>(peer.invalid_packets));
+    printf("Player %u: layers %u vs %u, checksum %08x\n",
+           session.GetLocalPlayer(), session.GetState(0).erased_layers,
+           session.GetState(1).erased_layers, session.GetChecksum());
+}
+
+void RunMatch(const Config& config, const Options& options) {
+    std::vector<std::unique_ptr<Peer>> peers;
+    for (unsigned player = 0; player < RollbackSession::kPlayerCount;
+         ++player) {
+        if (options.player < 0 ||
+            static_cast<unsigned>(options.player) == player) {
+            peers.push_back(std::make_unique<Peer>(config, options, player));
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto tick_duration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<float>(1.f / options.tick_rate));
+    auto next_tick_time = Clock::now();
+    unsigned linger_frames = 0;
+    while (linger_frames < kLingerFrames) {
+        auto finished = true;
+        for (auto& peer : peers) {
+            finished &= UpdatePeer(*peer, options);
+        }
+        if (finished) {
+            ++linger_frames;
+        }
+        next_tick_time += tick_duration;
+        std::this_thread::sleep_until(next_tick_time);
+    }
+
+    for (auto& peer : peers) {
+        PrintPeer(*peer);
+    }
+    if (peers.size() == RollbackSession::kPlayerCount) {
+        auto synced = peers[0]->session.GetChecksum() ==
+                      peers[1]->session.GetChecksum();
+        printf("%s\n", synced ? "Peers in sync" : "Peers DESYNCED");
+    }
+}
+
+} // namespace
+} // namespace tetris3d
+
+int main(int argc, char** argv) {
+    try {
+        tetris3d::Options options;
+        tetris3d::Config config;
+        if (!tetris3d::ParseOptions(argc, argv, options, config)) {
+            return 0;
+        }
+        tetris3d::RunMatch(config, options);
+    } catch (const tetris3d::Error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}